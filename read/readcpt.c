@@ -3,7 +3,7 @@
  *descreption:
  *  read cpt format file
  *init date: May/10/2022
- *last modify: Jul/27/2022
+ *last modify: Oct/17/2026
  *
  */
 
@@ -14,175 +14,3388 @@ const static size_t _cpt_2byte = sizeof(int16_t);
 const static size_t _cpt_4byte = sizeof(int32_t);
 const static size_t _cpt_8byte = sizeof(int64_t);
 
-#ifdef CPT_DEBUG
+/*  Fast path of cpt_bufread, field fits in current window  */
+static inline int bufget(struct cpt_buf *buf, void *dst, size_t n)
+{
+	if (n <= buf->len - buf->pos) {
+		memcpy(dst, buf->data+buf->pos, n);
+		buf->pos += n;
+		return 0;
+	}
+	return cpt_bufread(buf, dst, n);
+}
+
+/*  nt of Pt from the ntlen bytes just before p  */
+static inline uint16_t rawnt(const uint8_t *p, uint8_t ntlen)
+{
+	uint16_t nt = 0;
+	
+	memcpy(&nt, p-ntlen, ntlen);
+	return nt;
+}
+
+/*  Bytes of obs and ang of a Channel, raw integers if scaled  */
+static inline size_t channelsize(uint8_t scaled, uint8_t nlayer, int16_t centrewv)
+{
+	return (scaled ? _cpt_2byte : _cpt_8byte)*nlayer*((centrewv < 0) ? 7 : 5);
+}
+
+/*
+ *  Byte planes of n 8-byte items, byte k of every item goes together,
+ *  16 items at a time are transposed by 4 rounds of unpacking
+ */
+static void shuffle8(const uint8_t *src, size_t n, uint8_t *dst)
+{
+	size_t i = 0;
+	
+#ifdef __SSE2__
+	__m128i v[8], w[8];
+	
+	for (; i+16 <= n; i += 16) {
+		for (int k = 0; k < 8; ++k)
+			v[k] = _mm_loadu_si128((const __m128i *) (src+8*i+16*k));
+		for (int round = 0; round < 4; ++round) {
+			for (int k = 0; k < 4; ++k) {
+				w[2*k]   = _mm_unpacklo_epi8(v[k], v[k+4]);
+				w[2*k+1] = _mm_unpackhi_epi8(v[k], v[k+4]);
+			}
+			memcpy(v, w, sizeof(v));
+		}
+		for (int k = 0; k < 8; ++k)
+			_mm_storeu_si128((__m128i *) (dst+k*n+i), v[k]);
+	}
+#endif
+	for (; i < n; ++i) {
+		for (int k = 0; k < 8; ++k)
+			dst[k*n+i] = src[8*i+k];
+	}
+}
+
+/*  Items back from byte planes, pairs of planes are interleaved up to 8 bytes  */
+static void unshuffle8(const uint8_t *src, size_t n, uint8_t *dst)
+{
+	size_t i = 0;
+	
+#ifdef __SSE2__
+	__m128i b[8], h[8], q[8];
+	
+	for (; i+16 <= n; i += 16) {
+		for (int k = 0; k < 8; ++k)
+			b[k] = _mm_loadu_si128((const __m128i *) (src+k*n+i));
+		for (int k = 0; k < 4; ++k) {
+			h[k]   = _mm_unpacklo_epi8(b[2*k], b[2*k+1]);  /*  items 0-7, bytes 2k, 2k+1   */
+			h[k+4] = _mm_unpackhi_epi8(b[2*k], b[2*k+1]);  /*  items 8-15                  */
+		}
+		for (int k = 0; k < 2; ++k) {
+			q[k]   = _mm_unpacklo_epi16(h[2*k], h[2*k+1]);      /*  items 0-3, bytes 4k-4k+3  */
+			q[k+2] = _mm_unpackhi_epi16(h[2*k], h[2*k+1]);      /*  items 4-7                 */
+			q[k+4] = _mm_unpacklo_epi16(h[2*k+4], h[2*k+5]);    /*  items 8-11                */
+			q[k+6] = _mm_unpackhi_epi16(h[2*k+4], h[2*k+5]);    /*  items 12-15               */
+		}
+		for (int k = 0; k < 4; ++k) {
+			_mm_storeu_si128((__m128i *) (dst+8*i+32*k),    _mm_unpacklo_epi32(q[2*k], q[2*k+1]));
+			_mm_storeu_si128((__m128i *) (dst+8*i+32*k+16), _mm_unpackhi_epi32(q[2*k], q[2*k+1]));
+		}
+	}
+#endif
+	for (; i < n; ++i) {
+		for (int k = 0; k < 8; ++k)
+			dst[8*i+k] = src[k*n+i];
+	}
+}
+
+/*
+ *  Streams of a shuffled chunk walked along the Ptx they make up,
+ *  merge moves them into raw, split does the reverse
+ */
+struct cpt_chunkio {
+	uint8_t *raw, *rawend;
+	uint8_t *skel, *skelend;
+	uint8_t *dbl, *dblend;
+	uint8_t *tim, *timend;
+	uint8_t  nparam;
+	uint8_t  ntlen;
+	uint8_t  scaled;
+	uint8_t  siteid;
+	uint8_t  merge;
+};
+
+static inline int iomove(struct cpt_chunkio *io, uint8_t **s, const uint8_t *send, size_t n)
+{
+	if (((size_t) (io->rawend-io->raw) < n) || ((size_t) (send-*s) < n))
+		return CPT_EFORMAT;
+	if (io->merge)
+		memcpy(io->raw, *s, n);
+	else
+		memcpy(*s, io->raw, n);
+	io->raw += n;
+	*s += n;
+	
+	return 0;
+}
+
+#define CPT_IOSKEL(io, n) iomove(io, &(io)->skel, (io)->skelend, n)
+#define CPT_IODBL(io, n)  iomove(io, &(io)->dbl, (io)->dblend, sizeof(double[n]))
+#define CPT_IOTIM(io)     iomove(io, &(io)->tim, (io)->timend, _cpt_8byte)
+
+static int walkpixel(struct cpt_chunkio *io)
+{
+	int16_t wv;
+	uint8_t nlayer, nchannel;
+	
+	/*  lon lat alt mask nchannel nlayer  */
+	if (CPT_IOSKEL(io, 13))
+		return CPT_EFORMAT;
+	nchannel = io->raw[-2];
+	nlayer   = io->raw[-1];
+	if (io->scaled && CPT_IODBL(io, CPT_SCALELEN/_cpt_8byte))
+		return CPT_EFORMAT;
+	for (uint8_t ichannel = 0; ichannel < nchannel; ++ichannel) {
+		if (CPT_IOSKEL(io, _cpt_2byte))
+			return CPT_EFORMAT;
+		memcpy(&wv, io->raw-_cpt_2byte, _cpt_2byte);
+		if (io->scaled ? CPT_IOSKEL(io, channelsize(1, nlayer, wv))
+		               : CPT_IODBL(io, nlayer*((wv < 0) ? 7 : 5)))
+			return CPT_EFORMAT;
+	}
+	if (CPT_IOSKEL(io, _cpt_1byte) || CPT_IODBL(io, io->raw[-1]))
+		return CPT_EFORMAT;
+	
+	return 0;
+}
+
+static int walkptx(struct cpt_chunkio *io)
+{
+	uint8_t  nvicinity;
+	uint16_t nt;
+	const uint8_t *name = io->merge ? io->skel : io->raw;
+	const uint8_t *end  = io->merge ? io->skelend : io->rawend;
+	const uint8_t *pend = name+_cpt_4byte-1;
+	
+	/*  Pt, name is a site ID with dictionary  */
+	if ((!io->siteid && !(pend = memchr(name, '\0', end-name))) || CPT_IOSKEL(io, pend+1-name)
+	    || CPT_IOSKEL(io, _cpt_4byte+_cpt_4byte+_cpt_2byte+io->ntlen))
+		return CPT_EFORMAT;
+	nt = rawnt(io->raw, io->ntlen);
+	for (uint16_t ipoint = 0; ipoint < nt; ++ipoint) {
+		if (CPT_IOTIM(io) || CPT_IODBL(io, io->nparam))
+			return CPT_EFORMAT;
+	}
+	
+	/*  Px  */
+	if (CPT_IOTIM(io) || walkpixel(io) || CPT_IOSKEL(io, _cpt_1byte))
+		return CPT_EFORMAT;
+	nvicinity = io->raw[-1];
+	for (uint8_t ivicinity = 0; ivicinity < nvicinity; ++ivicinity) {
+		if (walkpixel(io))
+			return CPT_EFORMAT;
+	}
+	
+	return 0;
+}
+
+/*
+ *  Shuffle len bytes of whole Ptx in raw into out,
+ *  which takes CPT_SHUFHDRLEN+len bytes, before deflate
+ */
+int cpt_chunkshuffle(const uint8_t *raw, size_t len, uint8_t ver, uint8_t nparam, uint8_t flags,
+                     uint8_t *out)
+{
+	uint8_t *tmp;
+	uint32_t n[3];  /*  skeleton bytes, doubles, seconds  */
+	uint64_t t, prev = 0;
+	struct cpt_chunkio io;
+	
+	if ((len > UINT32_MAX) || !(tmp = malloc(2*len+1)))
+		return CPT_EMEM;
+	io.raw  = (uint8_t *) raw;  /*  only read from when splitting  */
+	io.rawend  = io.raw+len;
+	io.skel = out+CPT_SHUFHDRLEN;
+	io.skelend = io.skel+len;
+	io.dbl  = tmp;
+	io.dblend  = tmp+len;
+	io.tim  = tmp+len;
+	io.timend  = tmp+2*len;
+	io.nparam  = nparam;
+	io.ntlen   = CPT_NTLENOF(ver);
+	io.scaled  = !!(flags & CPT_FSCALED);
+	io.siteid  = !!(flags & CPT_FSITEID);
+	io.merge   = 0;
+	while (io.raw < io.rawend) {
+		if (walkptx(&io)) {
+			free(tmp);
+			return CPT_EFORMAT;
+		}
+	}
+	
+	n[0] = io.skel-(out+CPT_SHUFHDRLEN);
+	n[1] = (io.dbl-tmp)/_cpt_8byte;
+	n[2] = (io.tim-(tmp+len))/_cpt_8byte;
+	memcpy(out, n, CPT_SHUFHDRLEN);
+	
+	/*  Seconds as deltas, mostly a few hundreds  */
+	for (uint32_t i = 0; i < n[2]; ++i) {
+		memcpy(&t, tmp+len+sizeof(uint64_t[i]), _cpt_8byte);
+		t -= prev;
+		prev += t;
+		memcpy(tmp+len+sizeof(uint64_t[i]), &t, _cpt_8byte);
+	}
+	shuffle8(tmp, n[1], io.skel);
+	shuffle8(tmp+len, n[2], io.skel+sizeof(double[n[1]]));
+	free(tmp);
+	
+	return 0;
+}
+
+/*  Inverse of cpt_chunkshuffle from buf->sdata into the window  */
+static int chunkmerge(struct cpt_buf *buf, size_t slen, size_t *len)
+{
+	void    *p;
+	uint8_t *planes;
+	uint32_t n[3];
+	uint64_t t, prev = 0;
+	struct cpt_chunkio io;
+	
+	if (slen < CPT_SHUFHDRLEN)
+		return CPT_EFORMAT;
+	memcpy(n, buf->sdata, CPT_SHUFHDRLEN);
+	*len = (size_t) n[0]+sizeof(uint64_t[(size_t) n[1]+n[2]]);
+	if (CPT_SHUFHDRLEN+*len != slen)
+		return CPT_EFORMAT;
+	
+	/*  Planes back to items behind the inflated chunk  */
+	if (slen+*len-n[0] > buf->scap) {
+		if (!(p = realloc(buf->sdata, slen+*len-n[0])))
+			return CPT_EMEM;
+		buf->sdata = p;
+		buf->scap  = slen+*len-n[0];
+	}
+	if (*len > buf->cap) {
+		if (!(p = realloc(buf->data, *len)))
+			return CPT_EMEM;
+		buf->data = p;
+		buf->cap  = *len;
+	}
+	planes = buf->sdata+CPT_SHUFHDRLEN+n[0];
+	unshuffle8(planes, n[1], buf->sdata+slen);
+	unshuffle8(planes+sizeof(double[n[1]]), n[2], buf->sdata+slen+sizeof(double[n[1]]));
+	for (uint32_t i = 0; i < n[2]; ++i) {
+		memcpy(&t, buf->sdata+slen+sizeof(uint64_t[n[1]+i]), _cpt_8byte);
+		prev += t;
+		memcpy(buf->sdata+slen+sizeof(uint64_t[n[1]+i]), &prev, _cpt_8byte);
+	}
+	
+	io.raw  = buf->data;
+	io.rawend  = io.raw+*len;
+	io.skel = buf->sdata+CPT_SHUFHDRLEN;
+	io.skelend = io.skel+n[0];
+	io.dbl  = buf->sdata+slen;
+	io.dblend  = io.dbl+sizeof(double[n[1]]);
+	io.tim  = io.dblend;
+	io.timend  = io.tim+sizeof(uint64_t[n[2]]);
+	io.nparam  = buf->nparam;
+	io.ntlen   = buf->ntlen;
+	io.scaled  = buf->scaled;
+	io.siteid  = buf->siteid;
+	io.merge   = 1;
+	while (io.skel < io.skelend) {
+		if (walkptx(&io))
+			return CPT_EFORMAT;
+	}
+	
+	return ((io.raw == io.rawend) && (io.dbl == io.dblend) && (io.tim == io.timend)) ? 0 : CPT_EFORMAT;
+}
+
+/*
+ *  Columnar chunk walked along the Ptx it makes up, split counts items
+ *  with cnt set at first then moves them, merge moves them back into raw
+ */
+struct cpt_colio {
+	uint8_t *raw, *rawend;
+	uint8_t *skel, *skelend;
+	size_t   nskel;
+	uint8_t *col[CPT_COLMAX];
+	uint32_t n[CPT_COLMAX];  /*  items counted, or left to move  */
+	int16_t  wv[CPT_COLMAXWV];
+	uint8_t  nwv;
+	uint8_t  nparam;
+	uint8_t  ntlen;
+	uint8_t  scaled;
+	uint8_t  siteid;
+	uint8_t  merge;
+	uint8_t  cnt;
+};
+
+#define CPT_COLALIGN(off) (((off)+7) & ~(size_t) 7)
+
+static inline uint8_t colid(uint32_t icol)
+{
+	return (icol < CPT_COLFIXED) ? icol : CPT_COLI+(icol-CPT_COLFIXED)%CPT_COLPERWV;
+}
+
+static inline uint8_t colsize(uint32_t icol, uint8_t scaled)
+{
+	static const uint8_t fixed[CPT_COLFIXED] = {4, 4, 8, 4, 4, 1, CPT_SCALELEN};
+	
+	return (icol < CPT_COLFIXED) ? fixed[icol] : (scaled ? _cpt_2byte : _cpt_8byte);
+}
+
+static int colskel(struct cpt_colio *io, size_t len)
+{
+	if ((size_t) (io->rawend-io->raw) < len)
+		return CPT_EFORMAT;
+	if (io->cnt) {
+		io->nskel += len;
+	} else if ((size_t) (io->skelend-io->skel) < len) {
+		return CPT_EFORMAT;
+	} else {
+		if (io->merge)
+			memcpy(io->raw, io->skel, len);
+		else
+			memcpy(io->skel, io->raw, len);
+		io->skel += len;
+	}
+	io->raw += len;
+	
+	return 0;
+}
+
+static int colmove(struct cpt_colio *io, uint32_t icol, uint32_t k)
+{
+	size_t len = (size_t) colsize(icol, io->scaled)*k;
+	
+	if ((size_t) (io->rawend-io->raw) < len)
+		return CPT_EFORMAT;
+	if (io->cnt) {
+		io->n[icol] += k;
+	} else if (io->n[icol] < k) {
+		return CPT_EFORMAT;
+	} else {
+		if (io->merge)
+			memcpy(io->raw, io->col[icol], len);
+		else
+			memcpy(io->col[icol], io->raw, len);
+		io->col[icol] += len;
+		io->n[icol]   -= k;
+	}
+	io->raw += len;
+	
+	return 0;
+}
+
+/*  First column of centre wavelength wv, new ones are only taken when counting  */
+static int colwv(struct cpt_colio *io, int16_t wv, uint32_t *icol)
+{
+	uint8_t iwv;
+	
+	for (iwv = 0; (iwv < io->nwv) && (io->wv[iwv] != wv); ++iwv) ;
+	if (iwv == io->nwv) {
+		if (!io->cnt || (CPT_COLMAXWV == io->nwv))
+			return CPT_EFORMAT;
+		io->wv[io->nwv++] = wv;
+	}
+	*icol = CPT_COLFIXED+CPT_COLPERWV*iwv;
+	
+	return 0;
+}
+
+/*  Bytes of the Pixel at p by its own dimensions, vicinity is kept whole  */
+static int pixelsize(const uint8_t *p, const uint8_t *end, uint8_t scaled, size_t *size)
+{
+	int16_t wv;
+	size_t  len = end-p, off = 13+(scaled ? CPT_SCALELEN : 0);
+	
+	if (len < 13)
+		return CPT_EFORMAT;
+	for (uint8_t ichannel = 0; ichannel < p[11]; ++ichannel) {
+		if (off+_cpt_2byte > len)
+			return CPT_EFORMAT;
+		memcpy(&wv, p+off, _cpt_2byte);
+		off += _cpt_2byte+channelsize(scaled, p[12], wv);
+	}
+	if (off >= len)
+		return CPT_EFORMAT;
+	*size = off+_cpt_1byte+sizeof(double[p[off]]);
+	
+	return 0;
+}
+
+static int colptx(struct cpt_colio *io)
+{
+	int16_t  wv;
+	uint8_t  nchannel, nlayer, nvicinity;
+	uint16_t nt;
+	uint32_t icol;
+	size_t   size;
+	const uint8_t *name = io->merge ? io->skel : io->raw;
+	const uint8_t *end  = io->merge ? io->skelend : io->rawend;
+	const uint8_t *pend = name+_cpt_4byte-1;
+	
+	/*  Pt, name is a site ID with dictionary  */
+	if ((!io->siteid && !(pend = memchr(name, '\0', end-name))) || colskel(io, pend+1-name)
+	    || colmove(io, CPT_COLPTLON, 1) || colmove(io, CPT_COLPTLAT, 1)
+	    || colskel(io, _cpt_2byte+io->ntlen))
+		return CPT_EFORMAT;
+	nt = rawnt(io->raw, io->ntlen);
+	if (colskel(io, nt*(_cpt_8byte+sizeof(double[io->nparam]))))
+		return CPT_EFORMAT;
+	
+	/*  Px and its centre Pixel  */
+	if (colmove(io, CPT_COLSECONDS, 1)
+	    || colmove(io, CPT_COLLON, 1) || colmove(io, CPT_COLLAT, 1)
+	    || colskel(io, _cpt_2byte) || colmove(io, CPT_COLMASK, 1)
+	    || colskel(io, _cpt_1byte+_cpt_1byte))
+		return CPT_EFORMAT;
+	nchannel = io->raw[-2];
+	nlayer   = io->raw[-1];
+	if (io->scaled && colmove(io, CPT_COLSCALE, 1))
+		return CPT_EFORMAT;
+	for (uint8_t ichannel = 0; ichannel < nchannel; ++ichannel) {
+		if (colskel(io, _cpt_2byte))
+			return CPT_EFORMAT;
+		memcpy(&wv, io->raw-_cpt_2byte, _cpt_2byte);
+		if (colwv(io, wv, &icol))
+			return CPT_EFORMAT;
+		for (uint8_t iq = 0; iq < CPT_COLPERWV; ++iq) {
+			if ((wv >= 0) && ((CPT_COLQ-CPT_COLI == iq) || (CPT_COLU-CPT_COLI == iq)))
+				continue;
+			if (colmove(io, icol+iq, nlayer))
+				return CPT_EFORMAT;
+		}
+	}
+	if (colskel(io, _cpt_1byte) || colskel(io, sizeof(double[io->raw[-1]])))
+		return CPT_EFORMAT;
+	
+	/*  Vicinity  */
+	if (colskel(io, _cpt_1byte))
+		return CPT_EFORMAT;
+	nvicinity = io->raw[-1];
+	for (uint8_t ivicinity = 0; ivicinity < nvicinity; ++ivicinity) {
+		if (pixelsize(io->merge ? io->skel : io->raw, end, io->scaled, &size)
+		    || colskel(io, size))
+			return CPT_EFORMAT;
+	}
+	
+	return 0;
+}
+
+/*
+ *  Split len bytes of whole Ptx in raw into columns in out,
+ *  which takes CPT_COLBOUND(len) bytes, before deflate
+ */
+int cpt_chunkcolumn(const uint8_t *raw, size_t len, uint8_t ver, uint8_t nparam, uint8_t flags,
+                    uint8_t *out, size_t *outlen)
+{
+	size_t off;
+	struct cpt_colhdr hdr = {0};
+	struct cpt_coldir dir;
+	struct cpt_colio  io;
+	
+	memset(&io, 0, sizeof(io));
+	io.raw    = (uint8_t *) raw;  /*  only read from when splitting  */
+	io.rawend = io.raw+len;
+	io.nparam = nparam;
+	io.ntlen  = CPT_NTLENOF(ver);
+	io.scaled = !!(flags & CPT_FSCALED);
+	io.siteid = !!(flags & CPT_FSITEID);
+	io.cnt    = 1;
+	for (; io.raw < io.rawend; ++hdr.nptx) {
+		if (colptx(&io))
+			return CPT_EFORMAT;
+	}
+	
+	/*  Directory, and where skeleton and each column go  */
+	hdr.ncol  = CPT_COLFIXED+CPT_COLPERWV*io.nwv;
+	hdr.nskel = io.nskel;
+	memset(out, 0, CPT_COLBOUND(len));
+	memcpy(out, &hdr, sizeof(hdr));
+	off = CPT_COLALIGN(sizeof(hdr)+sizeof(struct cpt_coldir[hdr.ncol]));
+	io.skel    = out+off;
+	io.skelend = io.skel+io.nskel;
+	off = CPT_COLALIGN(off+io.nskel);
+	for (uint32_t icol = 0; icol < hdr.ncol; ++icol) {
+		dir.id   = colid(icol);
+		dir.size = colsize(icol, io.scaled);
+		dir.wv   = (icol < CPT_COLFIXED) ? 0 : io.wv[(icol-CPT_COLFIXED)/CPT_COLPERWV];
+		dir.n    = io.n[icol];
+		dir.off  = off;
+		memcpy(out+sizeof(hdr)+sizeof(dir)*icol, &dir, sizeof(dir));
+		io.col[icol] = out+off;
+		off = CPT_COLALIGN(off+(size_t) dir.size*dir.n);
+	}
+	*outlen = off;
+	
+	/*  Then items are moved for real  */
+	io.raw = (uint8_t *) raw;
+	io.cnt = 0;
+	while (io.raw < io.rawend) {
+		if (colptx(&io))
+			return CPT_EFORMAT;
+	}
+	
+	return 0;
+}
+
+/*
+ *  Check header and directory of an inflated columnar chunk,
+ *  rawlen is then the length of Ptx it makes up
+ */
+static int colcheck(const uint8_t *s, size_t slen, uint8_t scaled,
+                    struct cpt_colhdr *hdr, size_t *rawlen)
+{
+	size_t skel;
+	struct cpt_coldir dir;
+	
+	if (slen < sizeof(struct cpt_colhdr))
+		return CPT_EFORMAT;
+	memcpy(hdr, s, sizeof(struct cpt_colhdr));
+	if ((hdr->ncol < CPT_COLFIXED) || (hdr->ncol > CPT_COLMAX)
+	    || ((hdr->ncol-CPT_COLFIXED)%CPT_COLPERWV))
+		return CPT_EFORMAT;
+	skel = CPT_COLALIGN(sizeof(struct cpt_colhdr)+sizeof(struct cpt_coldir[hdr->ncol]));
+	if (skel+hdr->nskel > slen)
+		return CPT_EFORMAT;
+	
+	*rawlen = hdr->nskel;
+	for (uint32_t icol = 0; icol < hdr->ncol; ++icol) {
+		memcpy(&dir, s+sizeof(struct cpt_colhdr)+sizeof(dir)*icol, sizeof(dir));
+		if ((dir.id != colid(icol)) || (dir.size != colsize(icol, scaled)) || (dir.off%8)
+		    || (dir.off < skel+hdr->nskel) || (dir.off+(uint64_t) dir.size*dir.n > slen))
+			return CPT_EFORMAT;
+		*rawlen += (size_t) dir.size*dir.n;
+	}
+	
+	return 0;
+}
+
+/*  Inverse of cpt_chunkcolumn from buf->sdata into the window  */
+static int colmerge(struct cpt_buf *buf, size_t slen, size_t *len)
+{
+	void    *p;
+	uint32_t nptx = 0;
+	struct cpt_colhdr hdr;
+	struct cpt_coldir dir;
+	struct cpt_colio  io;
+	
+	if (colcheck(buf->sdata, slen, buf->scaled, &hdr, len))
+		return CPT_EFORMAT;
+	if (*len > buf->cap) {
+		if (!(p = realloc(buf->data, *len)))
+			return CPT_EMEM;
+		buf->data = p;
+		buf->cap  = *len;
+	}
+	
+	memset(&io, 0, sizeof(io));
+	io.nwv = (hdr.ncol-CPT_COLFIXED)/CPT_COLPERWV;
+	for (uint32_t icol = 0; icol < hdr.ncol; ++icol) {
+		memcpy(&dir, buf->sdata+sizeof(hdr)+sizeof(dir)*icol, sizeof(dir));
+		if (icol >= CPT_COLFIXED)
+			io.wv[(icol-CPT_COLFIXED)/CPT_COLPERWV] = dir.wv;
+		io.col[icol] = buf->sdata+dir.off;
+		io.n[icol]   = dir.n;
+	}
+	io.raw     = buf->data;
+	io.rawend  = io.raw+*len;
+	io.skel    = buf->sdata+CPT_COLALIGN(sizeof(hdr)+sizeof(struct cpt_coldir[hdr.ncol]));
+	io.skelend = io.skel+hdr.nskel;
+	io.nparam  = buf->nparam;
+	io.ntlen   = buf->ntlen;
+	io.scaled  = buf->scaled;
+	io.siteid  = buf->siteid;
+	io.merge   = 1;
+	for (; io.skel < io.skelend; ++nptx) {
+		if (colptx(&io))
+			return CPT_EFORMAT;
+	}
+	if ((io.raw != io.rawend) || (nptx != hdr.nptx))
+		return CPT_EFORMAT;
+	for (uint32_t icol = 0; icol < hdr.ncol; ++icol) {
+		if (io.n[icol])
+			return CPT_EFORMAT;
+	}
+	
+	return 0;
+}
+
+/*
+ *  Ptx walked from one layout to the other, padding of aligned layout
+ *  in src is dropped if from is set, and added into dst if to is set
+ */
+struct cpt_padio {
+	const uint8_t *src, *srcbase, *srcend;
+	uint8_t *dst, *dstbase, *dstend;
+	uint8_t  from;
+	uint8_t  to;
+	uint8_t  scaled;
+};
+
+static int padcopy(struct cpt_padio *io, size_t n)
+{
+	if (((size_t) (io->srcend-io->src) < n) || ((size_t) (io->dstend-io->dst) < n))
+		return CPT_EFORMAT;
+	memcpy(io->dst, io->src, n);
+	io->src += n;
+	io->dst += n;
+	
+	return 0;
+}
+
+static int padalign(struct cpt_padio *io)
+{
+	size_t n;
+	
+	if (io->from) {
+		if ((size_t) (io->srcend-io->src) < (n = CPT_PADLEN(io->src-io->srcbase)))
+			return CPT_EFORMAT;
+		io->src += n;
+	}
+	if (io->to) {
+		if ((size_t) (io->dstend-io->dst) < (n = CPT_PADLEN(io->dst-io->dstbase)))
+			return CPT_EFORMAT;
+		memset(io->dst, 0, n);
+		io->dst += n;
+	}
+	
+	return 0;
+}
+
+static int padpixel(struct cpt_padio *io)
+{
+	int16_t wv;
+	uint8_t nchannel, nlayer, nextra;
+	
+	/*  lon lat alt mask nchannel nlayer  */
+	if (padcopy(io, 13))
+		return CPT_EFORMAT;
+	nchannel = io->dst[-2];
+	nlayer   = io->dst[-1];
+	if (io->scaled && (padalign(io) || padcopy(io, CPT_SCALELEN)))
+		return CPT_EFORMAT;
+	for (uint8_t ichannel = 0; ichannel < nchannel; ++ichannel) {
+		if (padcopy(io, _cpt_2byte))
+			return CPT_EFORMAT;
+		memcpy(&wv, io->dst-_cpt_2byte, _cpt_2byte);
+		if (padalign(io) || padcopy(io, channelsize(io->scaled, nlayer, wv)))
+			return CPT_EFORMAT;
+	}
+	if (padcopy(io, _cpt_1byte))
+		return CPT_EFORMAT;
+	nextra = io->dst[-1];
+	if (padalign(io) || padcopy(io, sizeof(double[nextra])))
+		return CPT_EFORMAT;
+	
+	return 0;
+}
+
+/*
+ *  Copy one Ptx of len bytes in raw into out, which takes CPT_PADBOUND(len)
+ *  bytes, padded as layout flags to say while raw is padded as from say,
+ *  both are taken to start at a multiple of CPT_ALIGN
+ */
+int cpt_ptxalign(const uint8_t *raw, size_t len, uint8_t ver, uint8_t nparam,
+                 uint8_t from, uint8_t to, uint8_t *out, size_t *outlen)
+{
+	uint8_t  nvicinity, ntlen = CPT_NTLENOF(ver);
+	uint16_t nt;
+	const uint8_t *pend = raw+_cpt_4byte-1;
+	struct cpt_padio io;
+	
+	if ((from ^ to) & (CPT_FSCALED|CPT_FSITEID))
+		return CPT_EFORMAT;
+	io.src    = io.srcbase = raw;
+	io.srcend = raw+len;
+	io.dst    = io.dstbase = out;
+	io.dstend = out+CPT_PADBOUND(len);
+	io.from   = !!(from & CPT_FALIGNED);
+	io.to     = !!(to & CPT_FALIGNED);
+	io.scaled = !!(from & CPT_FSCALED);
+	
+	/*  Pt, name is a site ID with dictionary  */
+	if ((!(from & CPT_FSITEID) && !(pend = memchr(raw, '\0', len))) || padcopy(&io, pend+1-raw)
+	    || padcopy(&io, _cpt_4byte+_cpt_4byte+_cpt_2byte+ntlen))
+		return CPT_EFORMAT;
+	nt = rawnt(io.dst, ntlen);
+	if (padalign(&io) || padcopy(&io, nt*(_cpt_8byte+sizeof(double[nparam]))))
+		return CPT_EFORMAT;
+	
+	/*  Px  */
+	if (padcopy(&io, _cpt_8byte) || padpixel(&io) || padcopy(&io, _cpt_1byte))
+		return CPT_EFORMAT;
+	nvicinity = io.dst[-1];
+	for (uint8_t ivicinity = 0; ivicinity < nvicinity; ++ivicinity) {
+		if (padpixel(&io))
+			return CPT_EFORMAT;
+	}
+	if (padalign(&io) || (io.src != io.srcend))
+		return CPT_EFORMAT;
+	*outlen = io.dst-out;
+	
+	return 0;
+}
+
+/*
+ *  Read chunk at buf->foff and inflate it into dst, a chunk stored
+ *  as is is swapped in instead. Return CPT_ETRUNC at the closing chunk
+ *  or if it is not all there, then nothing is touched but zdata.
+ */
+static int chunkload(struct cpt_buf *buf, uint8_t **dst, size_t *cap, size_t *len)
+{
+	void    *p;
+	size_t   zcap;
+	uint32_t hdr[2];  /*  inflated and deflated length  */
+	uLongf   zlen;
+	
+	++buf->nsyscall;
+	if ((pread(buf->fd, hdr, CPT_CHUNKHDRLEN, buf->foff) != CPT_CHUNKHDRLEN) || !hdr[0])
+		return CPT_ETRUNC;
+	if (hdr[1] > buf->zcap) {
+		if (!(p = realloc(buf->zdata, hdr[1])))
+			return CPT_EMEM;
+		buf->zdata = p;
+		buf->zcap  = hdr[1];
+	}
+	++buf->nsyscall;
+	if (pread(buf->fd, buf->zdata, hdr[1], buf->foff+CPT_CHUNKHDRLEN) != (ssize_t) hdr[1])
+		return CPT_ETRUNC;
+	
+	if (hdr[0] == hdr[1]) {
+		p = *dst;
+		*dst = buf->zdata;
+		buf->zdata = p;
+		zcap = *cap;
+		*cap = buf->zcap;
+		buf->zcap = zcap;
+	} else {
+		if (hdr[0] > *cap) {
+			if (!(p = realloc(*dst, hdr[0])))
+				return CPT_EMEM;
+			*dst = p;
+			*cap = hdr[0];
+		}
+		zlen = hdr[0];
+		if ((Z_OK != uncompress(*dst, &zlen, buf->zdata, hdr[1])) || (zlen != hdr[0]))
+			return CPT_EFORMAT;
+	}
+	*len = hdr[0];
+	buf->foff += CPT_CHUNKHDRLEN+hdr[1];
+	++buf->ichunk;
+	
+	return 0;
+}
+
+/*
+ *  Inflate chunk at buf->foff as the new window,
+ *  current window is left as is if the chunk is not all there.
+ *  Return CPT_ETRUNC at the closing chunk.
+ */
+static int chunkrefill(struct cpt_buf *buf)
+{
+	int      ret;
+	uint8_t  split = buf->shuffle || buf->column;
+	size_t   slen, rawlen;
+	
+	if ((ret = chunkload(buf, split ? &buf->sdata : &buf->data,
+	                     split ? &buf->scap : &buf->cap, &slen)))
+		return ret;
+	rawlen = slen;
+	if (buf->shuffle && (ret = chunkmerge(buf, slen, &rawlen)))
+		return ret;
+	if (buf->column && (ret = colmerge(buf, slen, &rawlen)))
+		return ret;
+	buf->off += buf->len;
+	buf->len  = rawlen;
+	buf->pos  = 0;
+	
+	return 0;
+}
+
+/*  Start a new window once current one is exhausted  */
+static int bufrefill(struct cpt_buf *buf)
+{
+	ssize_t ret;
+	
+	if (buf->chunked)
+		return chunkrefill(buf);
+	buf->off += buf->len;
+	buf->len = buf->pos = 0;
+	++buf->nsyscall;
+	if ((ret = read(buf->fd, buf->data, buf->cap)) <= 0)
+		return CPT_ETRUNC;
+	buf->len = ret;
+	
+	return 0;
+}
+
+/*  Take Data from file offset start on as chunks, the offset is the same inflated  */
+static void bufchunk(struct cpt_buf *buf, off_t start, uint8_t flags, uint8_t nparam)
+{
+	buf->chunked = 1;
+	buf->shuffle = !!(flags & CPT_FSHUFFLE);
+	buf->column  = !!(flags & CPT_FCOLUMN);
+	buf->nparam  = nparam;
+	buf->ichunk  = 0;
+	buf->start   = buf->foff = buf->off = start;
+	buf->len     = buf->pos = 0;
+}
+
+/*  Decoding context, where decoded tree is allocated  */
+struct cpt_dec {
+	struct cpt_buf   *buf;
+	struct cpt_arena *arena;  /*  NULL to use malloc  */
+	size_t sparams;
+	uint8_t skip;             /*  projection          */
+	const char *const *names; /*  site names outliving the tree to point at, NULL to copy  */
+};
+
+static inline void *decmalloc(struct cpt_dec *dec, size_t size)
+{
+	return dec->arena ? cpt_arenaalloc(dec->arena, size) : malloc(size);
+}
+
+/*  Zeroed, so that a partially decoded tree can still be freed  */
+static inline void *deccalloc(struct cpt_dec *dec, size_t n, size_t size)
+{
+	void *ptr;
+	
+	if (!dec->arena)
+		return calloc(n, size);
+	if ((ptr = cpt_arenaalloc(dec->arena, n*size)))
+		memset(ptr, 0, n*size);
+	return ptr;
+}
+
+/*  NUL-terminated name, NULL when it is empty  */
+static int readname(struct cpt_dec *dec, char **name)
+{
+	char    *prev;
+	uint8_t *pend;
+	size_t   seg, namelen = 0;
+	struct cpt_buf *buf = dec->buf;
+	
+	*name = NULL;
+	for (;;) {
+		if ((buf->pos == buf->len) && bufrefill(buf))
+			return CPT_ETRUNC;
+		pend = memchr(buf->data+buf->pos, '\0', buf->len-buf->pos);
+		seg  = pend ? (size_t) (pend-buf->data)-buf->pos : buf->len-buf->pos;
+		if (seg) {
+			/*  Name across windows is rare, grow it by copying  */
+			prev  = *name;
+			if (!(*name = decmalloc(dec, namelen+seg+1))) {
+				if (!dec->arena)
+					free(prev);
+				return CPT_EMEM;
+			}
+			if (prev) {
+				memcpy(*name, prev, namelen);
+				if (!dec->arena)
+					free(prev);
+			}
+			memcpy(*name+namelen, buf->data+buf->pos, seg);
+			namelen += seg;
+			(*name)[namelen] = '\0';
+		}
+		buf->pos += seg;
+		if (pend) {
+			++buf->pos;
+			return 0;
+		}
+	}
+}
+
+/*
+ *  Name of Pt and its site ID, which is looked up in dictionary if there is one,
+ *  then the name is shared rather than copied when dec->names is set
+ */
+static int readsite(struct cpt_dec *dec, char **name, uint32_t *site)
+{
+	size_t len;
+	const char *src;
+	struct cpt_buf *buf = dec->buf;
+	
+	*site = CPT_NOSITE;
+	if (!buf->siteid)
+		return readname(dec, name);
+	
+	*name = NULL;
+	if (bufget(buf, site, _cpt_4byte) || (*site >= buf->nsite))
+		return CPT_ETRUNC;
+	src = dec->names ? dec->names[*site] : buf->sites[*site];
+	if (!*src)
+		return 0;
+	if (dec->names) {
+		*name = (char *) src;
+		return 0;
+	}
+	len = strlen(src)+1;
+	if (!(*name = decmalloc(dec, len)))
+		return CPT_EMEM;
+	memcpy(*name, src, len);
+	
+	return 0;
+}
+
+/*  Skip n bytes, a skip beyond the window seeks instead of reading through  */
+static int bufskip(struct cpt_buf *buf, size_t n)
+{
+	ssize_t ret;
+	size_t  avail = buf->len - buf->pos;
+	
+	if (n <= avail) {
+		buf->pos += n;
+		return 0;
+	}
+	if (buf->chunked) {
+		for (n -= avail; ; n -= buf->len) {
+			buf->pos = buf->len;
+			if (bufrefill(buf))
+				return CPT_ETRUNC;
+			if (n <= buf->len) {
+				buf->pos = n;
+				return 0;
+			}
+		}
+	}
+	n -= avail;
+	buf->off += buf->len;
+	buf->len = buf->pos = 0;
+	
+	if (n >= buf->cap) {
+		buf->off += n;
+		return (lseek(buf->fd, n, SEEK_CUR) < 0) ? CPT_ETRUNC : 0;
+	}
+	while (buf->len < n) {
+		++buf->nsyscall;
+		if ((ret = read(buf->fd, buf->data+buf->len, buf->cap-buf->len)) <= 0)
+			return CPT_ETRUNC;
+		buf->len += ret;
+	}
+	buf->pos = n;
+	
+	return 0;
+}
+
+static inline off_t buftell(const struct cpt_buf *buf)
+{
+	return buf->off + buf->pos;
+}
+
+/*  Step over padding of aligned layout, if any  */
+static inline int bufpad(struct cpt_buf *buf)
+{
+	return buf->aligned ? bufskip(buf, CPT_PADLEN(buftell(buf))) : 0;
+}
+
+/*
+ *  Trailer is only trusted if it points at a table ending right before it,
+ *  or before the chunk table in chunked layout, whose count is then returned,
+ *  zone and CRC tables come in between if any.
+ */
+static int trailerok(const struct cpt_trailer *trailer, uint64_t nptx, uint8_t flags,
+                     off_t data, size_t fsize, uint32_t *nchunk)
+{
+	uint64_t tail, unit;
+	
+	if (memcmp(trailer->magic, CPT_TRAILERMAGIC, sizeof(trailer->magic))
+	    || (trailer->ntable != nptx) || (trailer->table < (uint64_t) data)
+	    || (trailer->table+sizeof(uint64_t[nptx])+CPT_TRAILERLEN+CPT_ENDINGLEN > fsize))
+		return 0;
+	tail = fsize-CPT_TRAILERLEN-CPT_ENDINGLEN-trailer->table-sizeof(uint64_t[nptx]);
+	if (!(flags & CPT_FCHUNK))
+		return tail == CPT_CRCTABLEN(flags, nptx);
+	
+	/*  A pair in chunk table, a zone map and a CRC for each chunk, one more of each  */
+	unit = sizeof(uint64_t[2])+CPT_ZONETABLEN(flags, 0)+CPT_CRCTABLEN(flags, 0);
+	if (!tail || (tail%unit))
+		return 0;
+	*nchunk = tail/unit-1;
+	
+	return 1;
+}
+
+/*
+ *  Chunked layout ends with a closing chunk of no length, the footer
+ *  then has one more pair in chunk table for it.
+ */
+static int chunkending(struct cpt_file *file)
+{
+	off_t    table = file->buf.foff+CPT_CHUNKHDRLEN;
+	uint32_t hdr[2];
+	uint8_t  tail[CPT_TRAILERLEN+CPT_ENDINGLEN];
+	struct cpt_trailer trailer;
+	
+	if (file->buf.pos != file->buf.len)
+		return CPT_EFORMAT;
+	if (pread(file->buf.fd, hdr, CPT_CHUNKHDRLEN, file->buf.foff) != CPT_CHUNKHDRLEN)
+		return CPT_ETRUNC;
+	if (hdr[0] || hdr[1])
+		return CPT_EFORMAT;
+	if (pread(file->buf.fd, tail, sizeof(tail),
+	          table+sizeof(uint64_t[file->nptx])+sizeof(uint64_t[file->buf.ichunk+1][2])
+	          +CPT_ZONETABLEN(file->flags, file->buf.ichunk)
+	          +CPT_CRCTABLEN(file->flags, file->buf.ichunk))
+	    != sizeof(tail))
+		return CPT_ETRUNC;
+	memcpy(&trailer, tail, CPT_TRAILERLEN);
+	if (memcmp(trailer.magic, CPT_TRAILERMAGIC, sizeof(trailer.magic))
+	    || (trailer.table != (uint64_t) table) || (trailer.ntable != file->nptx)
+	    || memcmp(tail+CPT_TRAILERLEN, CPT_ENDING, CPT_ENDINGLEN))
+		return CPT_EFORMAT;
+	
+	return 0;
+}
+
+/*
+ *  Footer since 0.2 and 16 bytes of zeros following the last Ptx,
+ *  CPT_ETRUNC if they are not all there, CPT_EFORMAT if they are wrong
+ */
+static int tryending(struct cpt_file *file)
+{
+	off_t   table = buftell(&file->buf);
+	uint8_t ending[CPT_ENDINGLEN];
+	struct cpt_trailer trailer;
+	
+	if (file->flags & CPT_FCHUNK)
+		return chunkending(file);
+	if (CPT_VERSION01 != file->ver) {
+		if (bufskip(&file->buf, sizeof(uint64_t[file->nptx])+CPT_CRCTABLEN(file->flags, file->nptx))
+		    || bufget(&file->buf, &trailer, CPT_TRAILERLEN))
+			return CPT_ETRUNC;
+		if (memcmp(trailer.magic, CPT_TRAILERMAGIC, sizeof(trailer.magic))
+		    || (trailer.table != (uint64_t) table) || (trailer.ntable != file->nptx))
+			return CPT_EFORMAT;
+	}
+	if (bufget(&file->buf, ending, CPT_ENDINGLEN))
+		return CPT_ETRUNC;
+	
+	return memcmp(ending, CPT_ENDING, CPT_ENDINGLEN) ? CPT_EFORMAT : 0;
+}
+
+static int readending(struct cpt_file *file)
+{
+	file->ended = 1;
+	if (tryending(file)) {
+		CPT_ERRECHOWITHTIME("%s has NO ending, the results may be incorrect", file->fname);
+		return CPT_EFORMAT;
+	}
+	
+	return 0;
+}
+
+static int skipname(struct cpt_buf *buf)
+{
+	uint8_t *pend;
+	
+	if (buf->siteid)
+		return bufskip(buf, _cpt_4byte);
+	for (;;) {
+		if ((buf->pos == buf->len) && bufrefill(buf))
+			return CPT_ETRUNC;
+		if ((pend = memchr(buf->data+buf->pos, '\0', buf->len-buf->pos))) {
+			buf->pos = pend-buf->data+1;
+			return 0;
+		}
+		buf->pos = buf->len;
+	}
+}
+
+/*  Size of a pixel follows from nchannel, nlayer, sign of centrewv and nextra  */
+static int skippixel(struct cpt_buf *buf)
+{
+	int16_t centrewv;
+	uint8_t nchannel, nlayer, nextra;
+	
+	if (bufskip(buf, _cpt_4byte+_cpt_4byte+_cpt_2byte+_cpt_1byte)
+	    || bufget(buf, &nchannel, _cpt_1byte)
+	    || bufget(buf, &nlayer, _cpt_1byte)
+	    || (buf->scaled && (bufpad(buf) || bufskip(buf, CPT_SCALELEN))))
+		return CPT_ETRUNC;
+	for (uint8_t ichannel = 0; ichannel < nchannel; ++ichannel) {
+		if (bufget(buf, &centrewv, _cpt_2byte) || bufpad(buf)
+		    || bufskip(buf, channelsize(buf->scaled, nlayer, centrewv)))
+			return CPT_ETRUNC;
+	}
+	if (bufget(buf, &nextra, _cpt_1byte) || bufpad(buf)
+	    || bufskip(buf, sizeof(double[nextra])))
+		return CPT_ETRUNC;
+	
+	return 0;
+}
+
+/*
+ *  n obs (sign) or ang values into dst as doubles, in scaled layout raw
+ *  integers are read into the tail of dst then expanded from the front,
+ *  which never catches up with raw ones not yet expanded
+ */
+static int bufvalues(struct cpt_buf *buf, double *dst, size_t n, int sign, const double *scale)
+{
+	uint8_t *raw = (uint8_t *) dst+sizeof(double[n])-sizeof(int16_t[n]);
+	int16_t  sraw;
+	uint16_t uraw;
+	
+	if (!buf->scaled)
+		return bufget(buf, dst, sizeof(double[n]));
+	if (bufget(buf, raw, sizeof(int16_t[n])))
+		return CPT_ETRUNC;
+	for (size_t i = 0; i < n; ++i) {
+		if (sign) {
+			memcpy(&sraw, raw+sizeof(int16_t[i]), _cpt_2byte);
+			dst[i] = scale[1]+scale[0]*sraw;
+		} else {
+			memcpy(&uraw, raw+sizeof(int16_t[i]), _cpt_2byte);
+			dst[i] = scale[3]+scale[2]*uraw;
+		}
+	}
+	
+	return 0;
+}
+
+static int decpixel(struct cpt_dec *dec, struct cpt_pixel *pixel)
+{
+	struct cpt_buf *buf = dec->buf;
+	double scale[CPT_SCALELEN/sizeof(double)];
+	
+	/*  Geolocation  */
+	if (bufget(buf, &pixel->lon, _cpt_4byte)
+	    || bufget(buf, &pixel->lat, _cpt_4byte)
+	    || bufget(buf, &pixel->alt, _cpt_2byte)
+	    || bufget(buf, &pixel->mask, _cpt_1byte))
+		return CPT_ETRUNC;
+	
+	/*  Dimensions  */
+	if (bufget(buf, &pixel->nchannel, _cpt_1byte)
+	    || bufget(buf, &pixel->nlayer, _cpt_1byte)
+	    || (buf->scaled && (bufpad(buf) || bufget(buf, scale, CPT_SCALELEN))))
+		return CPT_ETRUNC;
+	
+	if (pixel->nchannel) {
+		size_t nang  = 4*(size_t) pixel->nlayer;
+		size_t rawsz = buf->scaled ? _cpt_2byte : _cpt_8byte;
+		
+		/*  Channel  */
+		size_t nobs;
+		struct cpt_channel *pchannel;
+		if (!(pixel->channels = deccalloc(dec, pixel->nchannel, sizeof(struct cpt_channel))))
+			return CPT_EMEM;
+		for (uint8_t ichannel = 0; ichannel < pixel->nchannel; ++ichannel) {
+			pchannel = pixel->channels+ichannel;
+			if (bufget(buf, &pchannel->centrewv, _cpt_2byte) || bufpad(buf))
+				return CPT_ETRUNC;
+			
+			nobs = pixel->nlayer*((pchannel->centrewv < 0) ? 3 : 1);
+			if ((dec->skip & CPT_SKIPQU) && (pchannel->centrewv < 0)) {
+				if (!(pchannel->obs = decmalloc(dec, sizeof(double[pixel->nlayer]))) && pixel->nlayer)
+					return CPT_EMEM;
+				if (bufvalues(buf, pchannel->obs, pixel->nlayer, 1, scale)
+				    || bufskip(buf, rawsz*(nobs-pixel->nlayer)))
+					return CPT_ETRUNC;
+			} else {
+				if (!(pchannel->obs = decmalloc(dec, sizeof(double[nobs]))) && nobs)
+					return CPT_EMEM;
+				if (bufvalues(buf, pchannel->obs, nobs, 1, scale))
+					return CPT_ETRUNC;
+			}
+			if (dec->skip & CPT_SKIPANG) {
+				if (bufskip(buf, rawsz*nang))
+					return CPT_ETRUNC;
+			} else {
+				if (!(pchannel->ang = decmalloc(dec, sizeof(double[nang]))) && nang)
+					return CPT_EMEM;
+				if (bufvalues(buf, pchannel->ang, nang, 0, scale))
+					return CPT_ETRUNC;
+			}
+		}
+		pchannel = NULL;
+	} else {
+		pixel->nlayer = 0;
+		pixel->channels = NULL;
+	}
+	
+	if (bufget(buf, &pixel->nextra, _cpt_1byte) || bufpad(buf))
+		return CPT_ETRUNC;
+	if (dec->skip & CPT_SKIPEXTRA) {
+		if (bufskip(buf, sizeof(double[pixel->nextra])))
+			return CPT_ETRUNC;
+		pixel->nextra = 0;
+	}
+	if (pixel->nextra) {
+		if (!(pixel->extra = decmalloc(dec, sizeof(double[pixel->nextra]))))
+			return CPT_EMEM;
+		if (bufget(buf, pixel->extra, sizeof(double[pixel->nextra])))
+			return CPT_ETRUNC;
+	} else {
+		pixel->extra = NULL;
+	}
+	
+	return 0;
+}
+
+/*  Decode one Ptx, pt and px are expected zeroed  */
+static int decptx(struct cpt_dec *dec, struct cpt_pt *ppt, struct cpt_px *ppx)
+{
+	int      ret;
+	uint8_t  ivicinity;
+	uint16_t ipoint;
+	struct cpt_buf *buf = dec->buf;
+	struct cpt_point *ppoint;
+	
+	/*  Pt  */
+	if ((ret = readsite(dec, &ppt->name, &ppt->site)))
+		return ret;
+	if (bufget(buf, &ppt->lon, _cpt_4byte)
+	    || bufget(buf, &ppt->lat, _cpt_4byte)
+	    || bufget(buf, &ppt->alt, _cpt_2byte)
+	    || bufget(buf, &ppt->nt , buf->ntlen)
+	    || bufpad(buf))
+		return CPT_ETRUNC;
+	if (!(ppt->points = deccalloc(dec, ppt->nt, sizeof(struct cpt_point))) && ppt->nt)
+		return CPT_EMEM;
+	for (ipoint = 0; ipoint < ppt->nt; ++ipoint) {
+		ppoint = ppt->points+ipoint;
+		if (!(ppoint->params = decmalloc(dec, dec->sparams)) && dec->sparams)
+			return CPT_EMEM;
+		if (bufget(buf, &ppoint->seconds, _cpt_8byte)
+		    || bufget(buf, ppoint->params, dec->sparams))
+			return CPT_ETRUNC;
+	}
+	
+	/*  Px  */
+	if (bufget(buf, &ppx->seconds, _cpt_8byte))
+		return CPT_ETRUNC;
+	if (!(ppx->centrepixel = deccalloc(dec, 1, sizeof(struct cpt_pixel))))
+		return CPT_EMEM;
+	if ((ret = decpixel(dec, ppx->centrepixel)))
+		return ret;
+	if (bufget(buf, &ppx->nvicinity, _cpt_1byte))
+		return CPT_ETRUNC;
+	if (dec->skip & CPT_SKIPVICI) {
+		for (ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity) {
+			if (skippixel(buf))
+				return CPT_ETRUNC;
+		}
+		ppx->nvicinity = 0;
+		ppx->vicinity  = NULL;
+		return bufpad(buf);
+	}
+	if (!(ppx->vicinity = deccalloc(dec, ppx->nvicinity, sizeof(struct cpt_pixel))) && ppx->nvicinity)
+		return CPT_EMEM;
+	for (ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity) {
+		if ((ret = decpixel(dec, ppx->vicinity+ivicinity)))
+			return ret;
+	}
+	
+	return bufpad(buf);
+}
+
+/*
+ *  Walk over one Ptx without decoding it,
+ *  fields an index entry needs are kept when ent is given.
+ */
+static int scanptx(struct cpt_dec *dec, struct cpt_idxent *ent, char **name)
+{
+	int      ret;
+	float    lon, lat;
+	uint32_t site;
+	uint64_t seconds;
+	uint8_t  nvicinity;
+	uint16_t nt = 0;
+	struct cpt_buf *buf = dec->buf;
+	
+	if ((ret = name ? readsite(dec, name, &site) : skipname(buf)))
+		return ret;
+	if (bufget(buf, &lon, _cpt_4byte)
+	    || bufget(buf, &lat, _cpt_4byte)
+	    || bufskip(buf, _cpt_2byte)
+	    || bufget(buf, &nt, buf->ntlen)
+	    || bufpad(buf)
+	    || bufskip(buf, nt*(_cpt_8byte+dec->sparams))
+	    || bufget(buf, &seconds, _cpt_8byte)
+	    || skippixel(buf)
+	    || bufget(buf, &nvicinity, _cpt_1byte))
+		return CPT_ETRUNC;
+	for (uint8_t ivicinity = 0; ivicinity < nvicinity; ++ivicinity) {
+		if (skippixel(buf))
+			return CPT_ETRUNC;
+	}
+	if (bufpad(buf))
+		return CPT_ETRUNC;
+	
+	if (ent) {
+		ent->seconds = seconds;
+		ent->lon = lon;
+		ent->lat = lat;
+	}
+	
+	return 0;
+}
+
+/*  Compare name in place against site, across windows if needed  */
+static int matchname(struct cpt_buf *buf, const char *site, int *hit)
+{
+	uint8_t *pend;
+	uint32_t id;
+	size_t   seg, namelen = 0, sitelen = strlen(site);
+	
+	if (buf->siteid) {
+		if (bufget(buf, &id, _cpt_4byte))
+			return CPT_ETRUNC;
+		*hit = (id < buf->nsite) && !strcmp(buf->sites[id], site);
+		return 0;
+	}
+	
+	*hit = 1;
+	for (;;) {
+		if ((buf->pos == buf->len) && bufrefill(buf))
+			return CPT_ETRUNC;
+		pend = memchr(buf->data+buf->pos, '\0', buf->len-buf->pos);
+		seg  = pend ? (size_t) (pend-buf->data)-buf->pos : buf->len-buf->pos;
+		if (*hit && ((namelen+seg > sitelen) || memcmp(site+namelen, buf->data+buf->pos, seg)))
+			*hit = 0;
+		namelen  += seg;
+		buf->pos += seg;
+		if (pend) {
+			++buf->pos;
+			if (namelen != sitelen)
+				*hit = 0;
+			return 0;
+		}
+	}
+}
+
+/*  Predicates in the order their fields appear, stop at first failure  */
+static int testptx(struct cpt_dec *dec, const struct cpt_filter *filter, int *hit)
+{
+	float    lon, lat;
+	uint8_t  mask;
+	uint16_t nt = 0;
+	uint64_t seconds;
+	struct cpt_buf *buf = dec->buf;
+	
+	*hit = 1;
+	if ((filter->flags & CPT_FSITE) ? matchname(buf, filter->site, hit) : skipname(buf))
+		return CPT_ETRUNC;
+	if (!*hit)
+		return 0;
+	
+	if (bufget(buf, &lon, _cpt_4byte) || bufget(buf, &lat, _cpt_4byte))
+		return CPT_ETRUNC;
+	if (filter->flags & CPT_FBBOX) {
+		*hit = (lat >= filter->latmin) && (lat <= filter->latmax)
+		       && ((filter->lonmin <= filter->lonmax) ?
+		           ((lon >= filter->lonmin) && (lon <= filter->lonmax)) :
+		           ((lon >= filter->lonmin) || (lon <= filter->lonmax)));
+		if (!*hit)
+			return 0;
+	}
+	if (!(filter->flags & (CPT_FTIME|CPT_FMASK)))
+		return 0;
+	
+	if (bufskip(buf, _cpt_2byte)
+	    || bufget(buf, &nt, buf->ntlen)
+	    || bufpad(buf)
+	    || bufskip(buf, nt*(_cpt_8byte+dec->sparams))
+	    || bufget(buf, &seconds, _cpt_8byte))
+		return CPT_ETRUNC;
+	if (filter->flags & CPT_FTIME) {
+		*hit = (seconds >= filter->tmin) && (seconds <= filter->tmax);
+		if (!*hit)
+			return 0;
+	}
+	
+	if (filter->flags & CPT_FMASK) {
+		if (bufskip(buf, _cpt_4byte+_cpt_4byte+_cpt_2byte)
+		    || bufget(buf, &mask, _cpt_1byte))
+			return CPT_ETRUNC;
+		*hit = (mask == filter->mask);
+	}
+	
+	return 0;
+}
+
+/*
+ *  Test a Ptx and return to its start if it passes,
+ *  otherwise skip it as a whole, nothing is allocated either way.
+ */
+static int filterptx(struct cpt_dec *dec, const struct cpt_filter *filter, int *hit)
+{
+	off_t start = buftell(dec->buf);
+	
+	if (testptx(dec, filter, hit) || cpt_bufseek(dec->buf, start))
+		return CPT_ETRUNC;
+	if (!*hit)
+		return scanptx(dec, NULL, NULL);
+	
+	return 0;
+}
+
+/*  Whole n bytes from or to a descriptor  */
+static int fdread(int fd, void *dst, size_t n)
+{
+	ssize_t ret;
+	
+	for (uint8_t *p = dst; n > 0; p += ret, n -= ret) {
+		if ((ret = read(fd, p, n)) <= 0)
+			return CPT_ETRUNC;
+	}
+	
+	return 0;
+}
+
+static int fdwrite(int fd, const void *src, size_t n)
+{
+	ssize_t ret;
+	
+	for (const uint8_t *p = src; n > 0; p += ret, n -= ret) {
+		if ((ret = write(fd, p, n)) <= 0)
+			return CPT_EOPEN;
+	}
+	
+	return 0;
+}
+
+/*  Site names share one copy in pool, slots is an open addressing hash  */
+static uint32_t idxname(struct cpt_idx *idx, size_t *cap,
+                        uint32_t *slots, uint32_t nslot, const char *name)
+{
+	char    *pool;
+	size_t   len;
+	uint32_t hash = 2166136261u;
+	
+	if (!name)
+		return 0;
+	for (const char *p = name; *p; ++p)
+		hash = (hash ^ (uint8_t) *p) * 16777619u;
+	for (hash &= nslot-1; slots[hash]; hash = (hash+1) & (nslot-1)) {
+		if (!strcmp(idx->pool+slots[hash], name))
+			return slots[hash];
+	}
+	
+	len = strlen(name)+1;
+	if (idx->hdr.npool+len >= UINT32_MAX)
+		return UINT32_MAX;
+	if (idx->hdr.npool+len > *cap) {
+		*cap = 2*(idx->hdr.npool+len);
+		if (!(pool = realloc(idx->pool, *cap)))
+			return UINT32_MAX;
+		idx->pool = pool;
+	}
+	memcpy(idx->pool+idx->hdr.npool, name, len);
+	slots[hash] = idx->hdr.npool;
+	idx->hdr.npool += len;
+	
+	return slots[hash];
+}
+
+/*  Offsets of n Ptx strictly rising within [lo, hi)  */
+static int offsok(const uint64_t *offs, uint64_t n, uint64_t lo, uint64_t hi)
+{
+	for (uint64_t i = 0; i < n; ++i) {
+		if ((offs[i] < lo) || (offs[i] >= hi))
+			return 0;
+		lo = offs[i]+1;
+	}
+	
+	return 1;
+}
+
+/*
+ *  Chunk table of nchunk+1 pairs, file offsets strictly rising within
+ *  [data, table) and inflated ones never falling, Ptx offsets within them
+ */
+static int chunksok(const uint64_t *chunks, uint32_t nchunk, const uint64_t *offs, uint64_t nptx,
+                    uint64_t data, uint64_t table)
+{
+	for (uint32_t ichunk = 0; ichunk <= nchunk; ++ichunk) {
+		if ((chunks[2*ichunk] < data) || (chunks[2*ichunk] >= table)
+		    || (ichunk && (chunks[2*ichunk+1] < chunks[2*ichunk-1])))
+			return 0;
+		data = chunks[2*ichunk]+1;
+	}
+	
+	return offsok(offs, nptx, chunks[1], chunks[2*nchunk+1]);
+}
+
+/*
+ *  Offsets of every Ptx and the end of Data into file->offs,
+ *  from footer since 0.2, otherwise from sidecar index if it matches
+ *  the file, else file->offs stays NULL and seek goes by scan.
+ *  Offsets out of order or out of Data are not taken from either.
+ */
+static void fileoffs(struct cpt_file *file)
+{
+	uint32_t nchunk = 0;
+	struct cpt_idx     idx;
+	struct cpt_trailer trailer;
+	off_t at = file->fsize-CPT_ENDINGLEN-CPT_TRAILERLEN;
+	
+	file->noidx = 1;
+	if (!(file->offs = malloc(sizeof(uint64_t[file->nptx+1]))))
+		return;
+	
+	if ((CPT_VERSION01 != file->ver) && (at > 0)
+	    && (pread(file->buf.fd, &trailer, CPT_TRAILERLEN, at) == CPT_TRAILERLEN)
+	    && trailerok(&trailer, file->nptx, file->flags, file->data, file->fsize, &nchunk)
+	    && (pread(file->buf.fd, file->offs, sizeof(uint64_t[file->nptx]), trailer.table)
+	        == (ssize_t) sizeof(uint64_t[file->nptx]))) {
+		file->offs[file->nptx] = trailer.table;
+		if (!(file->flags & CPT_FCHUNK) && offsok(file->offs, file->nptx, file->data, trailer.table)) {
+			file->noidx = 0;
+			return;
+		}
+		
+		/*  Inflated offsets, chunk table is what maps them to the file  */
+		if ((file->flags & CPT_FCHUNK)
+		    && (file->chunks = malloc(sizeof(uint64_t[nchunk+1][2])))
+		    && (pread(file->buf.fd, file->chunks, sizeof(uint64_t[nchunk+1][2]),
+		              trailer.table+sizeof(uint64_t[file->nptx]))
+		        == (ssize_t) sizeof(uint64_t[nchunk+1][2]))
+		    && chunksok(file->chunks, nchunk, file->offs, file->nptx, file->data, trailer.table)) {
+			file->offs[file->nptx] = file->chunks[2*nchunk+1];
+			file->buf.chunks = file->chunks;
+			file->buf.nchunk = nchunk;
+			file->noidx = 0;
+			
+			/*  Zone maps only spare work, reading goes on without them  */
+			if ((file->flags & CPT_FZONE)
+			    && (file->zones = malloc(sizeof(struct cpt_zone[nchunk+1])))
+			    && (pread(file->buf.fd, file->zones, sizeof(struct cpt_zone[nchunk+1]),
+			              trailer.table+sizeof(uint64_t[file->nptx])+sizeof(uint64_t[nchunk+1][2]))
+			        != (ssize_t) sizeof(struct cpt_zone[nchunk+1])))
+				CPT_FREE(file->zones);
+			return;
+		}
+		CPT_FREE(file->chunks);
+		CPT_ERRECHOWITHTIME("%s has broken footer, it is NOT used", file->fname);
+	}
+	
+	/*  Sidecar has inflated offsets as well, chunks are then found by scan  */
+	if (!cpt_idxload(file->fname, &idx)) {
+		if (idx.hdr.nptx == file->nptx) {
+			for (uint64_t iptx = 0; iptx < file->nptx; ++iptx)
+				file->offs[iptx] = idx.ents[iptx].off;
+			file->offs[file->nptx] = idx.hdr.end;
+			file->noidx = !offsok(file->offs, file->nptx, file->buf.chunked ? 0 : file->data,
+			                      idx.hdr.end);
+		}
+		cpt_idxfree(&idx);
+	}
+	if (file->noidx)
+		CPT_FREE(file->offs);
+}
+
+/*  ID of site filter looks for, CPT_NOSITE if dictionary has no such name  */
+static uint32_t zonesite(const struct cpt_file *file, const struct cpt_filter *filter)
+{
+	if (!(filter->flags & CPT_FSITE))
+		return CPT_NOSITE;
+	for (uint32_t isite = 0; isite < file->nsite; ++isite) {
+		if (!strcmp(file->sites[isite], filter->site))
+			return isite;
+	}
+	
+	return CPT_NOSITE;
+}
+
+/*  Nothing in zone can pass filter, site being the ID from zonesite  */
+static int zonemiss(const struct cpt_zone *zone, const struct cpt_filter *filter, uint32_t site)
+{
+	if ((filter->flags & CPT_FBBOX)
+	    && ((zone->latmax < filter->latmin) || (zone->latmin > filter->latmax)
+	        || ((filter->lonmin <= filter->lonmax) ?
+	            ((zone->lonmax < filter->lonmin) || (zone->lonmin > filter->lonmax)) :
+	            ((zone->lonmax < filter->lonmin) && (zone->lonmin > filter->lonmax)))))
+		return 1;
+	if ((filter->flags & CPT_FTIME)
+	    && ((zone->tmax < filter->tmin) || (zone->tmin > filter->tmax)))
+		return 1;
+	
+	return (filter->flags & CPT_FSITE) && (zone->sitemin <= zone->sitemax)
+	       && ((site < zone->sitemin) || (site > zone->sitemax));
+}
+
+/*
+ *  Before a chunk is inflated, step over it and those following
+ *  that zone maps rule filter out, file is left before first Ptx
+ *  of the next chunk, or the Ending if there is none.
+ */
+static int zoneskip(struct cpt_file *file, const struct cpt_filter *filter)
+{
+	uint32_t ichunk, site;
+	uint64_t lo, hi, mid;
+	
+	if (!(file->flags & CPT_FZONE) || (file->buf.pos != file->buf.len))
+		return 0;
+	if (!file->offs && !file->noidx)
+		fileoffs(file);
+	if (!file->zones)
+		return 0;
+	
+	site = zonesite(file, filter);
+	for (ichunk = file->buf.ichunk;
+	     (ichunk < file->buf.nchunk) && zonemiss(file->zones+ichunk, filter, site); ++ichunk) ;
+	if (ichunk == file->buf.ichunk)
+		return 0;
+	
+	/*  First Ptx of that chunk  */
+	for (lo = file->iptx, hi = file->nptx; lo < hi; ) {
+		mid = lo+(hi-lo)/2;
+		if (file->offs[mid] < file->chunks[2*ichunk+1])
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	file->iptx = lo;
+	
+	return cpt_bufseek(&file->buf, file->chunks[2*ichunk+1]);
+}
+
+/*  Shared by decoding threads of cpt_readallopt  */
+struct cpt_par {
+	const char *fname;
+	struct cpt_ptx *ptx;
+	const uint64_t *offs;    /*  nptx+1 Ptx offsets, last one is Ending  */
+	const uint64_t *ranges;  /*  first Ptx of each range, nrange+1       */
+	const uint8_t  *skips;   /*  ranges zone maps rule out, NULL if none */
+	const uint64_t *chunks;  /*  chunk table, NULL if not chunked        */
+	uint32_t nchunk;
+	off_t    data;
+	uint8_t  chunked;
+	uint8_t  flags;
+	uint8_t  ntlen;
+	uint32_t nsite;
+	const char *const *sites;
+	const char *const *names;  /*  copy of sites in tree, NULL to copy each  */
+	uint64_t nrange;
+	uint64_t next;           /*  next range to claim                     */
+	size_t sparams;
+	size_t chunksize;        /*  arena chunk of each thread, 0 to malloc */
+	uint8_t skip;
+	const struct cpt_filter *filter;
+	uint8_t *kept;           /*  Ptx passing filter                      */
+	int ret;
+};
+
+struct cpt_worker {
+	pthread_t tid;
+	struct cpt_par  *par;
+	struct cpt_arena arena;
+};
+
+/*  Append chunks of src to dst, src is left empty  */
+static void arenajoin(struct cpt_arena *dst, struct cpt_arena *src)
+{
+	struct cpt_arenachunk *tail;
+	
+	if (!src->head)
+		return;
+	if (!(tail = dst->head)) {
+		dst->head = src->head;
+		dst->cur  = src->cur;
+	} else {
+		while (tail->next)
+			tail = tail->next;
+		tail->next = src->head;
+	}
+	src->head = src->cur = NULL;
+}
+
+/*  Thread claims ranges one by one, each with its own descriptor  */
+static void *decworker(void *arg)
+{
+	int fd, hit, ret = 0;
+	uint64_t irange, iptx;
+	struct cpt_buf     buf;
+	struct cpt_worker *worker = arg;
+	struct cpt_par    *par    = worker->par;
+	struct cpt_dec     dec    = {.buf = &buf, .arena = par->chunksize ? &worker->arena : NULL,
+	                             .sparams = par->sparams, .skip = par->skip, .names = par->names};
+	
+	if ((fd = open(par->fname, O_RDONLY)) < 0) {
+		CPT_ERROPEN(par->fname);
+		__atomic_store_n(&par->ret, CPT_EOPEN, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	if (cpt_bufinit(&buf, fd, CPT_BUFSIZE)) {
+		close(fd);
+		__atomic_store_n(&par->ret, CPT_EMEM, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	buf.scaled  = !!(par->flags & CPT_FSCALED);
+	buf.aligned = !!(par->flags & CPT_FALIGNED);
+	buf.siteid  = !!(par->flags & CPT_FSITEID);
+	buf.ntlen   = par->ntlen;
+	buf.nsite   = par->nsite;
+	buf.sites   = par->sites;
+	if (par->chunked) {
+		bufchunk(&buf, par->data, par->flags, par->sparams/sizeof(double));
+		buf.chunks = par->chunks;
+		buf.nchunk = par->nchunk;
+	}
+	
+	while (!ret && !__atomic_load_n(&par->ret, __ATOMIC_RELAXED)
+	       && ((irange = __atomic_fetch_add(&par->next, 1, __ATOMIC_RELAXED)) < par->nrange)) {
+		if (par->skips && par->skips[irange])
+			continue;
+		iptx = par->ranges[irange];
+		if (cpt_bufseek(&buf, par->offs[iptx]))
+			ret = CPT_ETRUNC;
+		for (; !ret && (iptx < par->ranges[irange+1]); ++iptx) {
+			if (par->filter) {
+				if ((ret = filterptx(&dec, par->filter, &hit)))
+					break;
+				if (!(par->kept[iptx] = hit))
+					continue;
+			}
+			ret = decptx(&dec, par->ptx->pt+iptx, par->ptx->px+iptx);
+		}
+		if (CPT_ETRUNC == ret)
+			CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", par->fname, (unsigned long) iptx+1);
+		else if (ret)
+			CPT_ERRECHOWITHTIME("%s can NOT be decoded at Ptx No.%lu, error %d", par->fname,
+			                    (unsigned long) iptx+1, ret);
+	}
+	if (ret)
+		__atomic_store_n(&par->ret, ret, __ATOMIC_RELAXED);
+	cpt_buffree(&buf);
+	
+	return NULL;
+}
+
+/*
+ *  Offsets of every Ptx and the Ending, from footer or sidecar index,
+ *  otherwise by skipping over payloads, then Ending is checked.
+ */
+static int scanoffs(struct cpt_file *file, uint64_t *offs)
+{
+	struct cpt_dec dec = {.buf = &file->buf, .sparams = sizeof(double[file->nparam])};
+	
+	if (!file->offs && !file->noidx)
+		fileoffs(file);
+	if (file->offs) {
+		memcpy(offs, file->offs, sizeof(uint64_t[file->nptx+1]));
+		if (cpt_bufseek(&file->buf, offs[file->nptx]))
+			return CPT_ETRUNC;
+	} else {
+		for (uint64_t iptx = 0; iptx < file->nptx; ++iptx) {
+			offs[iptx] = buftell(&file->buf);
+			if (scanptx(&dec, NULL, NULL)) {
+				CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", file->fname, (unsigned long) iptx+1);
+				return CPT_ETRUNC;
+			}
+		}
+		offs[file->nptx] = buftell(&file->buf);
+		if (!file->buf.chunked && (offs[file->nptx] > file->fsize)) {
+			CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", file->fname, (unsigned long) file->nptx);
+			return CPT_ETRUNC;
+		}
+	}
+	file->iptx = file->nptx;
+	
+	return readending(file);
+}
+
+/*
+ *  Data part of cpt_readallopt by nthread threads, ptx->pt and ptx->px
+ *  are zeroed arrays, ptx->arena is empty or NULL.
+ *  Ptx passing file->filter are moved to front, *nkept of them.
+ *  Names point into names if given, otherwise each Pt has a copy.
+ *  CPT_EFORMAT from missing Ending still leaves a complete tree.
+ */
+static int decpar(struct cpt_file *file, struct cpt_ptx *ptx, uint8_t nthread, uint64_t *nkept,
+                  const char *const *names)
+{
+	int ret, ending;
+	uint32_t site;
+	uint64_t *offs, target, nrange;
+	uint64_t *ranges;
+	uint8_t  *kept = NULL, *skips = NULL, miss;
+	struct cpt_par     par;
+	struct cpt_worker *workers;
+	
+	offs    = malloc(sizeof(uint64_t[file->nptx+1]));
+	ranges  = malloc(sizeof(uint64_t[file->nptx+1]));
+	workers = calloc(nthread, sizeof(struct cpt_worker));
+	if (file->filter)
+		kept = calloc(file->nptx+1, 1);
+	if (!offs || !ranges || !workers || (file->filter && !kept)) {
+		CPT_FREE(offs);
+		CPT_FREE(ranges);
+		CPT_FREE(kept);
+		CPT_ERRMEM(workers);
+		return CPT_EMEM;
+	}
+	
+	/*  Boundaries  */
+	if ((ending = scanoffs(file, offs)) && (CPT_EFORMAT != ending)) {
+		free(offs);
+		free(ranges);
+		free(workers);
+		CPT_FREE(kept);
+		return ending;
+	}
+	
+	/*
+	 *  Ranges of similar bytes, never smaller than an input window,
+	 *  and made of whole chunks so that each is inflated once.
+	 *  Chunks zone maps rule out make ranges of their own to skip.
+	 */
+	if (file->filter && file->zones && !(skips = malloc(file->nptx+1))) {
+		free(offs);
+		free(ranges);
+		free(workers);
+		CPT_ERRMEM(kept);
+		return CPT_EMEM;
+	}
+	site = file->filter ? zonesite(file, file->filter) : CPT_NOSITE;
+	target = (offs[file->nptx]-offs[0]) / ((uint64_t) nthread*CPT_PARSPLIT);
+	if (target < CPT_BUFSIZE)
+		target = CPT_BUFSIZE;
+	ranges[nrange = 0] = 0;
+	if (skips)
+		skips[0] = zonemiss(file->zones, file->filter, site);
+	for (uint64_t iptx = 1, ichunk = 1; iptx < file->nptx; ++iptx) {
+		if (file->chunks) {
+			while ((ichunk < file->buf.nchunk) && (file->chunks[2*ichunk+1] < offs[iptx]))
+				++ichunk;
+			if (file->chunks[2*ichunk+1] != offs[iptx])
+				continue;
+		}
+		miss = skips && zonemiss(file->zones+ichunk, file->filter, site);
+		if ((skips && (miss != skips[nrange]))
+		    || (!miss && (offs[iptx]-offs[ranges[nrange]] >= target))) {
+			ranges[++nrange] = iptx;
+			if (skips)
+				skips[nrange] = miss;
+		}
+	}
+	if (file->nptx)
+		++nrange;
+	ranges[nrange] = file->nptx;
+	
+	par.fname   = file->fname;
+	par.ptx     = ptx;
+	par.offs    = offs;
+	par.ranges  = ranges;
+	par.skips   = skips;
+	par.chunks  = file->chunks;
+	par.nchunk  = file->buf.nchunk;
+	par.data    = file->data;
+	par.chunked = file->buf.chunked;
+	par.flags   = file->flags;
+	par.ntlen   = file->buf.ntlen;
+	par.nsite   = file->nsite;
+	par.sites   = file->sites;
+	par.names   = names;
+	par.nrange  = nrange;
+	par.next    = 0;
+	par.sparams = sizeof(double[file->nparam]);
+	par.skip    = file->skip;
+	par.filter  = file->filter;
+	par.kept    = kept;
+	par.chunksize = ptx->arena ? (offs[file->nptx]+offs[file->nptx]/4)/nthread+CPT_ARENACHUNK : 0;
+	par.ret     = 0;
+	
+	for (uint8_t ithread = 0; ithread < nthread; ++ithread) {
+		workers[ithread].par = &par;
+		cpt_arenainit(&workers[ithread].arena, par.chunksize);
+		if (pthread_create(&workers[ithread].tid, NULL, decworker, workers+ithread)) {
+			par.ret = CPT_EMEM;
+			nthread = ithread;
+			break;
+		}
+	}
+	for (uint8_t ithread = 0; ithread < nthread; ++ithread) {
+		pthread_join(workers[ithread].tid, NULL);
+		if (ptx->arena)
+			arenajoin(ptx->arena, &workers[ithread].arena);
+	}
+	ret = par.ret ? par.ret : ending;
+	
+	/*  Close gaps left by filtered out Ptx  */
+	*nkept = file->nptx;
+	if (kept && (!ret || (CPT_EFORMAT == ret))) {
+		*nkept = 0;
+		for (uint64_t iptx = 0; iptx < file->nptx; ++iptx) {
+			if (!kept[iptx])
+				continue;
+			if (*nkept != iptx) {
+				ptx->pt[*nkept] = ptx->pt[iptx];
+				ptx->px[*nkept] = ptx->px[iptx];
+				memset(ptx->pt+iptx, 0, sizeof(struct cpt_pt));
+				memset(ptx->px+iptx, 0, sizeof(struct cpt_px));
+			}
+			++*nkept;
+		}
+	}
+	
+	free(offs);
+	free(ranges);
+	free(workers);
+	CPT_FREE(kept);
+	CPT_FREE(skips);
+	
+	return ret;
+}
+
+/*  One copy of site dictionary in arena, which names of a whole tree point into  */
+static const char *const *sitecopy(struct cpt_arena *arena, const struct cpt_file *file)
+{
+	char  *pool  = cpt_arenaalloc(arena, file->nsitebyte+1);
+	const char **sites = cpt_arenaalloc(arena, sizeof(char *[file->nsite+1]));
+	
+	if (!pool || !sites)
+		return NULL;
+	memcpy(pool, file->sitepool, file->nsitebyte);
+	for (uint32_t isite = 0; isite < file->nsite; ++isite)
+		sites[isite] = pool+(file->sites[isite]-file->sitepool);
+	
+	return sites;
+}
+
+#ifdef CPT_READ_MAIN
 int main(int argc, char *argv[])
 {
-	if (argc != 2) {
-		CPT_ERRECHOWITHTIME("Usage: %s cptfile", argv[0]);
-		return 1;
+	if (argc != 2) {
+		CPT_ERRECHOWITHTIME("Usage: %s cptfile", argv[0]);
+		return 1;
+	}
+	
+	uint8_t  nparam;
+	uint32_t nptx;
+	struct cpt_ptx ptx;
+	
+	cpt_readall(argv[1], &ptx, &nptx, &nparam);
+	for (uint32_t i = 0; i < nptx; ++i) {
+		printf("No.%03lu: lon %9.4f lat %8.4f with %2d points (%s)\n",
+		       (unsigned long) i+1, (ptx.px+i)->centrepixel->lon,
+		       (ptx.px+i)->centrepixel->lat, (ptx.pt+i)->nt,
+		       (ptx.pt+i)->name);
+	}
+	
+	cpt_freeptall(&ptx.pt, nptx);
+	cpt_freepxall(&ptx.px, nptx);
+	
+	return 0;
+}
+#endif
+
+/*
+ *  Count stays 32-bit as callers before 0.3 expect, a file of more Ptx
+ *  gives CPT_EFORMAT and must go through cpt_readallopt instead
+ */
+int cpt_readall(const char *fname, struct cpt_ptx *ptx, uint32_t *nptx, uint8_t *nparam)
+{
+	int ret;
+	uint64_t n;
+	
+	ret = cpt_readallopt(fname, ptx, &n, nparam, NULL);
+	if (n > UINT32_MAX) {
+		cpt_release(ptx, n);
+		CPT_ERRECHOWITHTIME("%s has %lu Ptx, more than cpt_readall counts, see cpt_readallopt",
+		                    fname, (unsigned long) n);
+		n = 0;
+		ret = CPT_EFORMAT;
+	}
+	*nptx = n;
+	
+	return ret;
+}
+
+/*
+ *  cpt_readall with options, NULL opt behaves the same as cpt_readall.
+ *  Tree decoded with opt->arena set must be released by cpt_release.
+ *  With opt->nthread > 1 record boundaries are found by a skipping pass
+ *  (or sidecar index), then ranges of Ptx are decoded in parallel.
+ *  Blocks in opt->skip are stepped over without being decoded,
+ *  so are Ptx failing opt->filter, *nptx is then the count kept.
+ *  ptx may be passed to cpt_release whatever this returns, it holds
+ *  the tree on 0 and on CPT_EFORMAT of a missing Ending, nothing else.
+ */
+int cpt_readallopt(const char *fname, struct cpt_ptx *ptx, uint64_t *nptx, uint8_t *nparam,
+                   const struct cpt_readopt *opt)
+{
+	int ret, hit;
+	uint64_t iptx;
+	struct cpt_dec  dec;
+	struct cpt_file file;
+	
+	*nptx      = 0;
+	ptx->pt    = NULL;
+	ptx->px    = NULL;
+	ptx->arena = NULL;
+	if ((ret = cpt_open(fname, &file)))
+		return ret;
+	*nptx   = file.nptx;
+	*nparam = file.nparam;
+	
+	file.skip   = opt ? opt->skip : 0;
+	file.filter = opt ? opt->filter : NULL;
+	dec.buf     = &file.buf;
+	dec.arena   = NULL;
+	dec.sparams = sizeof(double[file.nparam]);
+	dec.skip    = file.skip;
+	dec.names   = NULL;
+	
+	/*  Decoded tree is slightly larger than the file, mostly one chunk  */
+	if (opt && opt->arena) {
+		if (!(ptx->arena = malloc(sizeof(struct cpt_arena)))) {
+			cpt_close(&file);
+			CPT_ERRMEM(ptx->arena);
+			return CPT_EMEM;
+		}
+		cpt_arenainit(ptx->arena, (file.fsize > CPT_ARENACHUNK) ?
+		                          file.fsize+file.fsize/4 : CPT_ARENACHUNK);
+		dec.arena = ptx->arena;
+		
+		/*  Names are shared by Pt of the same site, not copied  */
+		if (file.buf.siteid)
+			dec.names = sitecopy(ptx->arena, &file);
+	}
+	
+	/*  Zeroed so that a truncated tree can be freed as a whole  */
+	ptx->pt = deccalloc(&dec, *nptx, sizeof(struct cpt_pt));
+	ptx->px = deccalloc(&dec, *nptx, sizeof(struct cpt_px));
+	if (!ptx->pt || !ptx->px) {
+		cpt_release(ptx, *nptx);
+		cpt_close(&file);
+		CPT_ERRMEM(ptx->pt);
+		return CPT_EMEM;
+	}
+	
+	/*  Data, *nptx counts Ptx kept by filter  */
+	if (opt && (opt->nthread > 1)) {
+		if ((ret = decpar(&file, ptx, opt->nthread, nptx, dec.names)) && (CPT_EFORMAT != ret))
+			cpt_release(ptx, file.nptx);
+		cpt_close(&file);
+		return ret;
+	}
+	ret = 0;
+	*nptx = 0;
+	for (iptx = 0; iptx < file.nptx; ++iptx) {
+		if (file.filter) {
+			file.iptx = iptx;
+			if ((ret = zoneskip(&file, file.filter)) || ((iptx = file.iptx) >= file.nptx))
+				break;
+			if ((ret = filterptx(&dec, file.filter, &hit)))
+				break;
+			if (!hit)
+				continue;
+		}
+		if ((ret = decptx(&dec, ptx->pt+*nptx, ptx->px+*nptx)))
+			break;
+		++*nptx;
+	}
+	
+	/*  Passed on as is, as the threaded path does  */
+	if (ret) {
+		cpt_release(ptx, file.nptx);
+		cpt_close(&file);
+		if (CPT_ETRUNC == ret)
+			CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", fname, (unsigned long) iptx+1);
+		else
+			CPT_ERRECHOWITHTIME("%s can NOT be decoded at Ptx No.%lu, error %d", fname, (unsigned long) iptx+1, ret);
+		return ret;
+	}
+	
+	/*  Ending  */
+	file.iptx = file.nptx;
+	ret = readending(&file);
+	cpt_close(&file);
+	
+	return ret;
+}
+
+/*
+ *  Site dictionary of nsite names in nbyte of pool, each NUL-terminated,
+ *  into sites which takes nsite pointers
+ */
+static int sitedict(const char *pool, uint32_t nbyte, uint32_t nsite, const char **sites)
+{
+	const char *p = pool, *pend, *end = pool+nbyte;
+	
+	for (uint32_t isite = 0; isite < nsite; ++isite) {
+		if (!(pend = memchr(p, '\0', end-p)))
+			return CPT_EFORMAT;
+		sites[isite] = p;
+		p = pend+1;
+	}
+	
+	return (p == end) ? 0 : CPT_EFORMAT;
+}
+
+/*  Site dictionary right after header, Data starts after it  */
+static int sitesload(struct cpt_file *file)
+{
+	if (bufget(&file->buf, &file->nsite, _cpt_4byte)
+	    || bufget(&file->buf, &file->nsitebyte, _cpt_4byte)
+	    || (file->nsite > file->nsitebyte) || (file->nsitebyte > file->fsize))
+		return CPT_EFORMAT;
+	if (!(file->sitepool = malloc(file->nsitebyte+1))
+	    || !(file->sites = malloc(sizeof(char *[file->nsite+1]))))
+		return CPT_EMEM;
+	if (bufget(&file->buf, file->sitepool, file->nsitebyte)
+	    || sitedict(file->sitepool, file->nsitebyte, file->nsite, file->sites))
+		return CPT_EFORMAT;
+	
+	file->buf.siteid = 1;
+	file->buf.nsite  = file->nsite;
+	file->buf.sites  = file->sites;
+	
+	return 0;
+}
+
+/*
+ *  Open a cpt file for streaming, header is checked and kept in file.
+ *  e.g.
+ *      cpt_open(fname, &file);
+ *      cpt_arenainit(&arena, 0);
+ *      while (!(ret = cpt_next_ptx(&file, &ptx, &arena)))
+ *          use ptx.pt and ptx.px, valid until next call;
+ *      cpt_arenafree(&arena);
+ *      cpt_close(&file);
+ */
+int cpt_open(const char *fname, struct cpt_file *file)
+{
+	int fd;
+	uint8_t mgc[CPT_MAGICLEN];
+	
+	if ((fd = open(fname, O_RDONLY)) < 0) {
+		CPT_ERROPEN(fname);
+		return CPT_EOPEN;
+	}
+	file->fsize = lseek(fd, 0, SEEK_END);
+	lseek(fd, 0, SEEK_SET);
+	if (cpt_bufinit(&file->buf, fd, CPT_BUFSIZE)) {
+		close(fd);
+		return CPT_EMEM;
+	}
+	file->fname = strdup(fname);
+	file->iptx  = 0;
+	file->ended = 0;
+	file->noidx = 0;
+	file->skip  = 0;
+	file->flags = 0;
+	file->offs  = NULL;
+	file->chunks = NULL;
+	file->zones = NULL;
+	file->raw   = NULL;
+	file->rawcap = 0;
+	file->filter = NULL;
+	file->nsite = 0;
+	file->nsitebyte = 0;
+	file->sitepool  = NULL;
+	file->sites = NULL;
+	
+	/*  Header check  */
+	if (bufget(&file->buf, mgc, CPT_MAGICLEN) || memcmp(mgc, CPT_MAGIC, CPT_MAGICLEN)) {
+		CPT_ERRECHOWITHTIME("%s is NOT a cpt file!", fname);
+		cpt_close(file);
+		return CPT_EFORMAT;
+	}
+	
+	/*  Version check, 0.1 and 0.2 are still read  */
+	if (bufget(&file->buf, &file->ver, _cpt_1byte)) {
+		CPT_ERRECHOWITHTIME("%s is truncated in header", fname);
+		cpt_close(file);
+		return CPT_ETRUNC;
+	}
+	if ((CPT_VERSION != file->ver) && (CPT_VERSION02 != file->ver) && (CPT_VERSION01 != file->ver)) {
+		CPT_ERRECHOWITHTIME("%s is a cpt file in version %d.%d!\n"
+		                    "while current lib is %d.%d",
+		                    fname, file->ver>>4, file->ver&0b00001111,
+		                    CPT_VER_MAJOR, CPT_VER_MINOR);
+		cpt_close(file);
+		return CPT_EFORMAT;
+	}
+	
+	/*  Meta info  */
+	file->nptx = 0;
+	if (bufget(&file->buf, &file->nptx, CPT_NPTXLENOF(file->ver))
+	    || bufget(&file->buf, &file->nparam, _cpt_1byte)
+	    || ((CPT_VERSION01 != file->ver) && bufget(&file->buf, &file->flags, _cpt_1byte))) {
+		CPT_ERRECHOWITHTIME("%s is truncated in header", fname);
+		cpt_close(file);
+		return CPT_ETRUNC;
+	}
+	if ((file->flags & ~CPT_FLAGS) || ((file->flags & CPT_FSHUFFLE) && !(file->flags & CPT_FCHUNK))
+	    || ((file->flags & CPT_FCOLUMN) && ((file->flags & CPT_FSHUFFLE) || !(file->flags & CPT_FCHUNK)))
+	    || ((file->flags & CPT_FALIGNED) && (file->flags & CPT_FCHUNK))
+	    || ((file->flags & CPT_FZONE) && !(file->flags & CPT_FCHUNK))) {
+		CPT_ERRECHOWITHTIME("%s has unknown layout flags 0x%02x", fname, file->flags);
+		cpt_close(file);
+		return CPT_EFORMAT;
+	}
+	if ((file->flags & CPT_FSITEID) && sitesload(file)) {
+		CPT_ERRECHOWITHTIME("%s has broken site dictionary", fname);
+		cpt_close(file);
+		return CPT_EFORMAT;
+	}
+	file->buf.scaled  = !!(file->flags & CPT_FSCALED);
+	file->buf.aligned = !!(file->flags & CPT_FALIGNED);
+	file->buf.ntlen   = CPT_NTLENOF(file->ver);
+	if (bufpad(&file->buf)) {
+		CPT_ERRECHOWITHTIME("%s is truncated in header", fname);
+		cpt_close(file);
+		return CPT_ETRUNC;
+	}
+	file->data = buftell(&file->buf);
+	
+	/*  Count of header bounds offset table and Data, so a broken one can NOT be trusted  */
+	if (file->nptx > (file->fsize-file->data)/CPT_PTXMINLENOF(file->flags)) {
+		CPT_ERRECHOWITHTIME("%s has %lu Ptx in header, more than its %lu bytes hold", fname,
+		                    (unsigned long) file->nptx, (unsigned long) file->fsize);
+		cpt_close(file);
+		return CPT_EFORMAT;
+	}
+	if (file->flags & CPT_FCHUNK)
+		bufchunk(&file->buf, file->data, file->flags, file->nparam);
+	
+	return 0;
+}
+
+static int nextptx(struct cpt_file *file, struct cpt_ptx *ptx, struct cpt_arena *arena,
+                   const struct cpt_filter *filter)
+{
+	int ret, hit;
+	struct cpt_dec dec = {.buf = &file->buf, .arena = arena, .sparams = sizeof(double[file->nparam]),
+	                      .skip = file->skip, .names = arena ? file->buf.sites : NULL};
+	
+	for (;;) {
+		if (filter && zoneskip(file, filter)) {
+			CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", file->fname, (unsigned long) file->iptx+1);
+			return CPT_ETRUNC;
+		}
+		if (file->iptx >= file->nptx) {
+			if (!file->ended && readending(file))
+				return CPT_EFORMAT;
+			return CPT_EEND;
+		}
+		if (!filter)
+			break;
+		if (filterptx(&dec, filter, &hit)) {
+			CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", file->fname, (unsigned long) file->iptx+1);
+			return CPT_ETRUNC;
+		}
+		if (hit)
+			break;
+		++file->iptx;
+	}
+	
+	if (arena)
+		cpt_arenareset(arena);
+	ptx->arena = arena;
+	ptx->pt = deccalloc(&dec, 1, sizeof(struct cpt_pt));
+	ptx->px = deccalloc(&dec, 1, sizeof(struct cpt_px));
+	if (!ptx->pt || !ptx->px) {
+		if (!arena)
+			cpt_release(ptx, 1);
+		return CPT_EMEM;
+	}
+	
+	if ((ret = decptx(&dec, ptx->pt, ptx->px))) {
+		if (!arena)
+			cpt_release(ptx, 1);
+		if (CPT_ETRUNC == ret)
+			CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", file->fname, (unsigned long) file->iptx+1);
+		else
+			CPT_ERRECHOWITHTIME("%s can NOT be decoded at Ptx No.%lu, error %d", file->fname,
+			                    (unsigned long) file->iptx+1, ret);
+		return ret;
+	}
+	++file->iptx;
+	
+	return 0;
+}
+
+/*
+ *  Decode next Ptx into arena, which is reset beforehand,
+ *  so memory stays as large as the largest Ptx seen.
+ *  Such Ptx needs no free, do NOT pass it to cpt_release.
+ *  Its name points into file->sites with site dictionary, valid until cpt_close.
+ *  With NULL arena the Ptx is malloc-ed and freed by cpt_release(ptx, 1).
+ *  Projection is taken from file->skip, Ptx failing file->filter
+ *  are skipped over.
+ *  Return CPT_EEND after the last Ptx.
+ */
+int cpt_next_ptx(struct cpt_file *file, struct cpt_ptx *ptx, struct cpt_arena *arena)
+{
+	return nextptx(file, ptx, arena, file->filter);
+}
+
+int cpt_close(struct cpt_file *file)
+{
+	cpt_buffree(&file->buf);
+	CPT_FREE(file->fname);
+	CPT_FREE(file->offs);
+	CPT_FREE(file->chunks);
+	CPT_FREE(file->zones);
+	CPT_FREE(file->raw);
+	CPT_FREE(file->sitepool);
+	CPT_FREE(file->sites);
+	
+	return 0;
+}
+
+/*
+ *  Position file before Ptx No.i (from 0), i == nptx is the Ending.
+ *  Offsets come from footer since 0.2, or sidecar index when it matches
+ *  the file, otherwise Ptx are skipped over from current or first Ptx.
+ */
+int cpt_seek(struct cpt_file *file, uint64_t i)
+{
+	int ret;
+	struct cpt_dec dec = {.buf = &file->buf, .sparams = sizeof(double[file->nparam])};
+	
+	if (i > file->nptx)
+		return CPT_EEND;
+	if (i == file->iptx)
+		return 0;
+	if (!file->offs && !file->noidx)
+		fileoffs(file);
+	file->ended = 0;
+	
+	if (file->offs) {
+		file->iptx = i;
+		return cpt_bufseek(&file->buf, file->offs[i]);
+	}
+	
+	/*  Fallback scan  */
+	if (i < file->iptx) {
+		if ((ret = cpt_bufseek(&file->buf, file->data)))
+			return ret;
+		file->iptx = 0;
+	}
+	for (; file->iptx < i; ++file->iptx) {
+		if (scanptx(&dec, NULL, NULL)) {
+			CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", file->fname, (unsigned long) file->iptx+1);
+			return CPT_ETRUNC;
+		}
+	}
+	
+	return 0;
+}
+
+/*
+ *  Decode Ptx No.i (from 0) as cpt_next_ptx does, regardless of filter
+ */
+int cpt_read_ptx(struct cpt_file *file, uint64_t i, struct cpt_ptx *ptx, struct cpt_arena *arena)
+{
+	int ret;
+	
+	if (i >= file->nptx)
+		return CPT_EEND;
+	if ((ret = cpt_seek(file, i)))
+		return ret;
+	
+	return nextptx(file, ptx, arena, NULL);
+}
+
+/*
+ *  Next Ptx as its encoded bytes, e.g. to copy records without decoding.
+ *  *data points into the input window, or a copy when the record
+ *  does not fit in it, and stays valid until next call.
+ *  Filter and projection are ignored.
+ *  Return CPT_EEND after the last Ptx.
+ */
+int cpt_next_raw(struct cpt_file *file, const uint8_t **data, size_t *len)
+{
+	uint8_t *raw;
+	size_t   pos;
+	off_t    win, start;
+	struct cpt_dec dec = {.buf = &file->buf, .sparams = sizeof(double[file->nparam])};
+	
+	if (file->iptx >= file->nptx) {
+		if (!file->ended && readending(file))
+			return CPT_EFORMAT;
+		return CPT_EEND;
+	}
+	
+	/*  Record right at the end of window starts in the next one  */
+	if ((file->buf.pos == file->buf.len) && bufrefill(&file->buf)) {
+		CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", file->fname, (unsigned long) file->iptx+1);
+		return CPT_ETRUNC;
+	}
+	pos   = file->buf.pos;
+	win   = file->buf.off;
+	start = buftell(&file->buf);
+	if (scanptx(&dec, NULL, NULL)) {
+		CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", file->fname, (unsigned long) file->iptx+1);
+		return CPT_ETRUNC;
+	}
+	*len = buftell(&file->buf)-start;
+	++file->iptx;
+	
+	if (win == file->buf.off) {
+		*data = file->buf.data+pos;
+		return 0;
+	}
+	
+	/*  Across windows, never across chunks  */
+	if (file->buf.chunked) {
+		CPT_ERRECHOWITHTIME("%s has Ptx No.%lu across chunks", file->fname, (unsigned long) file->iptx);
+		return CPT_EFORMAT;
+	}
+	if (*len > file->rawcap) {
+		if (!(raw = realloc(file->raw, *len))) {
+			CPT_ERRMEM(raw);
+			return CPT_EMEM;
+		}
+		file->raw    = raw;
+		file->rawcap = *len;
+	}
+	if (pread(file->buf.fd, file->raw, *len, start) != (ssize_t) *len)
+		return CPT_ETRUNC;
+	*data = file->raw;
+	
+	return 0;
+}
+
+/*
+ *  Next chunk of a columnar file as it is, no Ptx is made of it.
+ *  Not to be mixed with other ways of reading the same file,
+ *  filter and projection are ignored.
+ *  Return CPT_EEND after the last chunk.
+ *  e.g.
+ *      while (!cpt_next_block(&file, &block)) {
+ *          const double *sza = cpt_blockcol(&block, CPT_COLSZA, 865, &n);
+ *          ...
+ *      }
+ */
+int cpt_next_block(struct cpt_file *file, struct cpt_block *block)
+{
+	int    ret;
+	size_t slen, rawlen;
+	struct cpt_buf   *buf = &file->buf;
+	struct cpt_colhdr hdr;
+	
+	if (!(file->flags & CPT_FCOLUMN) || (buf->pos != buf->len))
+		return CPT_EFORMAT;
+	if (file->iptx >= file->nptx) {
+		if (!file->ended && readending(file))
+			return CPT_EFORMAT;
+		return CPT_EEND;
+	}
+	
+	if ((ret = chunkload(buf, &buf->sdata, &buf->scap, &slen))) {
+		CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", file->fname, (unsigned long) file->iptx+1);
+		return ret;
+	}
+	if (colcheck(buf->sdata, slen, buf->scaled, &hdr, &rawlen)
+	    || (hdr.nptx > file->nptx-file->iptx)) {
+		CPT_ERRECHOWITHTIME("%s has bad chunk at Ptx No.%lu", file->fname, (unsigned long) file->iptx+1);
+		return CPT_EFORMAT;
+	}
+	buf->off += buf->len+rawlen;
+	buf->len  = buf->pos = 0;
+	
+	block->iptx = file->iptx;
+	block->nptx = hdr.nptx;
+	block->ncol = hdr.ncol;
+	block->dir  = (const struct cpt_coldir *) (buf->sdata+sizeof(hdr));
+	block->base = buf->sdata;
+	file->iptx += hdr.nptx;
+	
+	return 0;
+}
+
+/*
+ *  Column id of a block, of centre wavelength wv if it is one per wavelength,
+ *  items are 8 bytes aligned. Return NULL with n of 0 if there is none.
+ */
+const void *cpt_blockcol(const struct cpt_block *block, uint8_t id, int16_t wv, uint32_t *n)
+{
+	for (uint32_t icol = 0; icol < block->ncol; ++icol) {
+		if ((block->dir[icol].id == id) && ((id < CPT_COLFIXED) || (block->dir[icol].wv == wv))) {
+			*n = block->dir[icol].n;
+			return block->base+block->dir[icol].off;
+		}
+	}
+	*n = 0;
+	
+	return NULL;
+}
+
+/*
+ *  Next complete Ptx of a file that is still being appended to.
+ *  Count in header is re-read on each call, since writer may patch it,
+ *  and Ending is taken as such only after that many Ptx.
+ *  Return CPT_EAGAIN if trailing record is not complete yet, file is
+ *  then left before it so that next call tries again on new data,
+ *  CPT_EEND once Ending is seen.
+ *  e.g.
+ *      while ((ret = cpt_follow(&file, &ptx, &arena)) != CPT_EEND) {
+ *          if (CPT_EAGAIN == ret)
+ *              sleep(1);
+ *          else if (!ret)
+ *              use ptx.pt and ptx.px, valid until next call;
+ *          else
+ *              break;
+ *      }
+ */
+int cpt_follow(struct cpt_file *file, struct cpt_ptx *ptx, struct cpt_arena *arena)
+{
+	int      ret;
+	uint64_t nptx = 0;
+	size_t   len   = CPT_NPTXLENOF(file->ver);
+	off_t    start = buftell(&file->buf);
+	struct cpt_dec dec = {.buf = &file->buf, .arena = arena, .sparams = sizeof(double[file->nparam]),
+	                      .skip = file->skip, .names = arena ? file->buf.sites : NULL};
+	
+	if (file->ended)
+		return CPT_EEND;
+	if (pread(file->buf.fd, &nptx, len, CPT_MAGICLEN+_cpt_1byte) == (ssize_t) len)
+		file->nptx = nptx;
+	
+	if (file->iptx >= file->nptx) {
+		if (!(ret = tryending(file))) {
+			file->ended = 1;
+			return CPT_EEND;
+		}
+		if (CPT_ETRUNC == ret) {
+			cpt_bufseek(&file->buf, start);
+			return CPT_EAGAIN;
+		}
+		/*  Count is not final yet, it is a Ptx  */
+		if (cpt_bufseek(&file->buf, start))
+			return CPT_ETRUNC;
+	}
+	
+	if (arena)
+		cpt_arenareset(arena);
+	ptx->arena = arena;
+	ptx->pt = deccalloc(&dec, 1, sizeof(struct cpt_pt));
+	ptx->px = deccalloc(&dec, 1, sizeof(struct cpt_px));
+	if (!ptx->pt || !ptx->px) {
+		if (!arena)
+			cpt_release(ptx, 1);
+		return CPT_EMEM;
+	}
+	
+	/*  Partial record is not an error here, running out of memory is  */
+	if ((ret = decptx(&dec, ptx->pt, ptx->px))) {
+		if (!arena)
+			cpt_release(ptx, 1);
+		ptx->pt = NULL;
+		ptx->px = NULL;
+		if (CPT_EMEM == ret)
+			return ret;
+		if (cpt_bufseek(&file->buf, start))
+			return CPT_ETRUNC;
+		return CPT_EAGAIN;
+	}
+	++file->iptx;
+	
+	return 0;
+}
+
+/*
+ *  Offset after the last complete Ptx, save it with file->iptx
+ *  to pick up from there later by cpt_resume
+ */
+off_t cpt_tell(const struct cpt_file *file)
+{
+	return buftell(&file->buf);
+}
+
+/*
+ *  Continue from Ptx No.iptx (from 0) at off, as told by cpt_tell,
+ *  on a file freshly opened by cpt_open
+ */
+int cpt_resume(struct cpt_file *file, off_t off, uint64_t iptx)
+{
+	if (off < file->data)
+		return CPT_EFORMAT;
+	file->iptx  = iptx;
+	file->ended = 0;
+	
+	return cpt_bufseek(&file->buf, off);
+}
+
+/*
+ *  Scan fname and save its offset index to fname.cptidx,
+ *  temporary file is renamed over so readers never see half an index.
+ */
+int cpt_idxbuild(const char *fname)
+{
+	int fd, ret;
+	char *iname, *tname, *name;
+	size_t cap = 4096;
+	uint32_t nslot, *slots;
+	struct stat st;
+	struct cpt_idx   idx;
+	struct cpt_dec   dec;
+	struct cpt_file  file;
+	struct cpt_arena arena;
+	
+	if ((ret = cpt_open(fname, &file)))
+		return ret;
+	if (fstat(file.buf.fd, &st)) {
+		CPT_ERROPEN(fname);
+		cpt_close(&file);
+		return CPT_EOPEN;
+	}
+	memcpy(idx.hdr.magic, CPT_IDXMAGIC, CPT_IDXMAGICLEN);
+	idx.hdr.nptx    = file.nptx;
+	idx.hdr.npool   = 1;
+	idx.hdr.reserved = 0;
+	idx.hdr.fsize   = st.st_size;
+	idx.hdr.mtime   = st.st_mtim.tv_sec;
+	idx.hdr.mtimens = st.st_mtim.tv_nsec;
+	
+	/*  Hash is kept at most half full, names are fewer than 2^31 in a 32-bit pool  */
+	for (nslot = 64; (nslot < 2*file.nptx) && (nslot < (uint32_t) 1<<31); nslot <<= 1) ;
+	idx.ents = calloc(file.nptx, sizeof(struct cpt_idxent));
+	idx.pool = calloc(cap, 1);
+	slots    = calloc(nslot, sizeof(uint32_t));
+	if (!idx.ents || !idx.pool || !slots) {
+		cpt_idxfree(&idx);
+		cpt_close(&file);
+		CPT_ERRMEM(slots);
+		return CPT_EMEM;
+	}
+	
+	cpt_arenainit(&arena, 0);
+	dec.buf     = &file.buf;
+	dec.arena   = &arena;
+	dec.sparams = sizeof(double[file.nparam]);
+	dec.skip    = 0;
+	dec.names   = file.buf.sites;
+	for (ret = 0; file.iptx < file.nptx; ++file.iptx) {
+		idx.ents[file.iptx].off = buftell(&file.buf);
+		cpt_arenareset(&arena);
+		if (scanptx(&dec, idx.ents+file.iptx, &name)) {
+			CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", fname, (unsigned long) file.iptx+1);
+			ret = CPT_ETRUNC;
+			break;
+		}
+		if (UINT32_MAX == (idx.ents[file.iptx].name = idxname(&idx, &cap, slots, nslot, name))) {
+			CPT_ERRMEM(slots);
+			ret = CPT_EMEM;
+			break;
+		}
+	}
+	idx.hdr.end = buftell(&file.buf);
+	if (!ret && ((!file.buf.chunked && (idx.hdr.end > (uint64_t) st.st_size))
+	             || readending(&file)))
+		ret = CPT_EFORMAT;
+	cpt_arenafree(&arena);
+	cpt_close(&file);
+	CPT_FREE(slots);
+	if (ret) {
+		cpt_idxfree(&idx);
+		return ret;
+	}
+	
+	/*  Save  */
+	if ((asprintf(&iname, "%s%s", fname, CPT_IDXSUFFIX) < 0)
+	    || (asprintf(&tname, "%s.%d", iname, getpid()) < 0)) {
+		cpt_idxfree(&idx);
+		return CPT_EMEM;
+	}
+	if ((fd = open(tname, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) {
+		CPT_ERROPEN(tname);
+		ret = CPT_EOPEN;
+	} else if (fdwrite(fd, &idx.hdr, sizeof(struct cpt_idxhdr))
+	           || fdwrite(fd, idx.ents, sizeof(struct cpt_idxent[idx.hdr.nptx]))
+	           || fdwrite(fd, idx.pool, idx.hdr.npool)
+	           || close(fd) || rename(tname, iname)) {
+		CPT_ERROPEN(iname);
+		unlink(tname);
+		ret = CPT_EOPEN;
+	}
+	free(tname);
+	free(iname);
+	cpt_idxfree(&idx);
+	
+	return ret;
+}
+
+/*
+ *  Load fname.cptidx, CPT_EOPEN quietly if there is none,
+ *  CPT_EFORMAT if it no longer matches size or mtime of fname.
+ */
+int cpt_idxload(const char *fname, struct cpt_idx *idx)
+{
+	int fd, ret = 0;
+	char *iname;
+	struct stat st, ist;
+	
+	idx->ents = NULL;
+	idx->pool = NULL;
+	if (stat(fname, &st)) {
+		CPT_ERROPEN(fname);
+		return CPT_EOPEN;
+	}
+	if (asprintf(&iname, "%s%s", fname, CPT_IDXSUFFIX) < 0)
+		return CPT_EMEM;
+	if ((fd = open(iname, O_RDONLY)) < 0) {
+		if (ENOENT != errno)
+			CPT_ERROPEN(iname);
+		free(iname);
+		return CPT_EOPEN;
+	}
+	
+	if (fstat(fd, &ist) || fdread(fd, &idx->hdr, sizeof(struct cpt_idxhdr))
+	    || memcmp(idx->hdr.magic, CPT_IDXMAGIC, CPT_IDXMAGICLEN)
+	    || ((uint64_t) ist.st_size != sizeof(struct cpt_idxhdr)
+	                                  +sizeof(struct cpt_idxent[idx->hdr.nptx])+idx->hdr.npool)) {
+		CPT_ERRECHOWITHTIME("%s is NOT a cpt index!", iname);
+		ret = CPT_EFORMAT;
+	} else if ((idx->hdr.fsize != (uint64_t) st.st_size)
+	           || (idx->hdr.mtime != st.st_mtim.tv_sec)
+	           || (idx->hdr.mtimens != st.st_mtim.tv_nsec)) {
+		CPT_ERRECHOWITHTIME("%s is stale, fall back to scan", iname);
+		ret = CPT_EFORMAT;
+	} else if (!(idx->ents = malloc(sizeof(struct cpt_idxent[idx->hdr.nptx])+1))
+	           || !(idx->pool = malloc(idx->hdr.npool+1))) {
+		CPT_ERRMEM(idx->ents);
+		ret = CPT_EMEM;
+	} else if (fdread(fd, idx->ents, sizeof(struct cpt_idxent[idx->hdr.nptx]))
+	           || fdread(fd, idx->pool, idx->hdr.npool)) {
+		ret = CPT_ETRUNC;
+	}
+	close(fd);
+	free(iname);
+	
+	if (ret)
+		cpt_idxfree(idx);
+	
+	return ret;
+}
+
+int cpt_idxfree(struct cpt_idx *idx)
+{
+	CPT_FREE(idx->ents);
+	CPT_FREE(idx->pool);
+	
+	return 0;
+}
+
+/*  Widen range [lo, hi] by v  */
+#define CPT_STATRANGE(lo, hi, v) \
+	do { \
+		if ((v) < (lo)) \
+			(lo) = (v); \
+		if ((v) > (hi)) \
+			(hi) = (v); \
+	} while (0)
+
+/*  Pixel header into stat, payload skipped  */
+static int statpixel(struct cpt_buf *buf, struct cpt_stat *stat)
+{
+	int16_t  centrewv;
+	uint8_t  nchannel, nlayer, nextra;
+	uint16_t iwv;
+	
+	if (bufskip(buf, _cpt_4byte+_cpt_4byte+_cpt_2byte+_cpt_1byte)
+	    || bufget(buf, &nchannel, _cpt_1byte)
+	    || bufget(buf, &nlayer, _cpt_1byte)
+	    || (buf->scaled && (bufpad(buf) || bufskip(buf, CPT_SCALELEN))))
+		return CPT_ETRUNC;
+	CPT_STATRANGE(stat->nchannelmin, stat->nchannelmax, nchannel);
+	if (nchannel)
+		CPT_STATRANGE(stat->nlayermin, stat->nlayermax, nlayer);
+	
+	for (uint8_t ichannel = 0; ichannel < nchannel; ++ichannel) {
+		if (bufget(buf, &centrewv, _cpt_2byte) || bufpad(buf)
+		    || bufskip(buf, channelsize(buf->scaled, nlayer, centrewv)))
+			return CPT_ETRUNC;
+		for (iwv = 0; (iwv < stat->nwv) && (stat->wv[iwv] != centrewv); ++iwv) ;
+		if ((iwv == stat->nwv) && (iwv < CPT_STATMAXWV))
+			stat->wv[stat->nwv++] = centrewv;
+		if (iwv < CPT_STATMAXWV)
+			++stat->nwvchannel[iwv];
+	}
+	
+	if (bufget(buf, &nextra, _cpt_1byte) || bufpad(buf)
+	    || bufskip(buf, sizeof(double[nextra])))
+		return CPT_ETRUNC;
+	CPT_STATRANGE(stat->nextramin, stat->nextramax, nextra);
+	++stat->npixel;
+	
+	return 0;
+}
+
+static int statptx(struct cpt_buf *buf, size_t sparams, struct cpt_stat *stat)
+{
+	float    lon, lat;
+	uint64_t seconds;
+	uint8_t  nvicinity;
+	uint16_t nt = 0;
+	
+	if (skipname(buf)
+	    || bufget(buf, &lon, _cpt_4byte)
+	    || bufget(buf, &lat, _cpt_4byte)
+	    || bufskip(buf, _cpt_2byte)
+	    || bufget(buf, &nt, buf->ntlen)
+	    || bufpad(buf)
+	    || bufskip(buf, nt*(_cpt_8byte+sparams))
+	    || bufget(buf, &seconds, _cpt_8byte)
+	    || statpixel(buf, stat)
+	    || bufget(buf, &nvicinity, _cpt_1byte))
+		return CPT_ETRUNC;
+	for (uint8_t ivicinity = 0; ivicinity < nvicinity; ++ivicinity) {
+		if (statpixel(buf, stat))
+			return CPT_ETRUNC;
+	}
+	if (bufpad(buf))
+		return CPT_ETRUNC;
+	
+	CPT_STATRANGE(stat->lonmin, stat->lonmax, lon);
+	CPT_STATRANGE(stat->latmin, stat->latmax, lat);
+	CPT_STATRANGE(stat->tmin, stat->tmax, seconds);
+	CPT_STATRANGE(stat->ntmin, stat->ntmax, nt);
+	stat->npoint += nt;
+	++stat->nvicinity[nvicinity];
+	
+	return 0;
+}
+
+/*
+ *  Summarize fname without decoding any payload, see struct cpt_stat.
+ *  Only the first CPT_STATMAXWV distinct wavelengths are counted.
+ */
+int cpt_stat(const char *fname, struct cpt_stat *stat)
+{
+	int ret = 0;
+	struct cpt_file file;
+	
+	if ((ret = cpt_open(fname, &file)))
+		return ret;
+	
+	memset(stat, 0, sizeof(struct cpt_stat));
+	stat->ver    = file.ver;
+	stat->nparam = file.nparam;
+	stat->nptx   = file.nptx;
+	stat->fsize  = file.fsize;
+	stat->nsite  = file.nsite;
+	stat->lonmin = stat->latmin = INFINITY;
+	stat->lonmax = stat->latmax = -INFINITY;
+	stat->tmin   = UINT64_MAX;
+	stat->ntmin  = UINT16_MAX;
+	stat->nchannelmin = stat->nlayermin = stat->nextramin = UINT8_MAX;
+	
+	for (; file.iptx < file.nptx; ++file.iptx) {
+		if (statptx(&file.buf, sizeof(double[file.nparam]), stat)) {
+			CPT_ERRECHOWITHTIME("%s is truncated at Ptx No.%lu", fname, (unsigned long) file.iptx+1);
+			ret = CPT_ETRUNC;
+			break;
+		}
+	}
+	if (!ret && ((!file.buf.chunked && (buftell(&file.buf) > (off_t) file.fsize))
+	             || readending(&file)))
+		ret = CPT_EFORMAT;
+	cpt_close(&file);
+	
+	return ret;
+}
+
+/*
+ *  CRC32C (Castagnoli, reflected 0x82F63B78), by crc32 instruction where
+ *  the CPU has it, otherwise by tables of slicing by 8, both little-endian
+ */
+#define CPT_CRCPOLY 0x82F63B78u
+
+static uint32_t crctab[8][256];
+static uint8_t  crchw;
+static pthread_once_t crconce = PTHREAD_ONCE_INIT;
+
+static void crcinit(void)
+{
+	uint32_t crc;
+	
+	for (uint32_t i = 0; i < 256; ++i) {
+		crc = i;
+		for (int k = 0; k < 8; ++k)
+			crc = (crc>>1) ^ (CPT_CRCPOLY & -(crc&1));
+		crctab[0][i] = crc;
+	}
+	for (uint32_t i = 0; i < 256; ++i) {
+		for (int k = 1; k < 8; ++k)
+			crctab[k][i] = (crctab[k-1][i]>>8) ^ crctab[0][crctab[k-1][i]&0xff];
+	}
+#ifdef CPT_CRCHW
+	crchw = !!__builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static uint32_t crcsoft(uint32_t crc, const uint8_t *p, size_t n)
+{
+	uint64_t w;
+	
+	for (; n && ((uintptr_t) p % 8); --n)
+		crc = (crc>>8) ^ crctab[0][(crc^*p++)&0xff];
+	for (; n >= 8; n -= 8, p += 8) {
+		memcpy(&w, p, 8);
+		w  ^= crc;
+		crc = crctab[7][w&0xff] ^ crctab[6][(w>>8)&0xff]
+		    ^ crctab[5][(w>>16)&0xff] ^ crctab[4][(w>>24)&0xff]
+		    ^ crctab[3][(w>>32)&0xff] ^ crctab[2][(w>>40)&0xff]
+		    ^ crctab[1][(w>>48)&0xff] ^ crctab[0][w>>56];
+	}
+	for (; n; --n)
+		crc = (crc>>8) ^ crctab[0][(crc^*p++)&0xff];
+	
+	return crc;
+}
+
+#ifdef CPT_CRCHW
+__attribute__((target("sse4.2")))
+static uint32_t crchard(uint32_t crc, const uint8_t *p, size_t n)
+{
+	uint64_t c = crc, w;
+	
+	for (; n && ((uintptr_t) p % 8); --n)
+		c = _mm_crc32_u8(c, *p++);
+	for (; n >= 8; n -= 8, p += 8) {
+		memcpy(&w, p, 8);
+		c = _mm_crc32_u64(c, w);
+	}
+	for (; n; --n)
+		c = _mm_crc32_u8(c, *p++);
+	
+	return c;
+}
+#endif
+
+/*
+ *  CRC32C of n bytes at src following those crc was of, 0 to start,
+ *  e.g. cpt_crc32c(0, "123456789", 9) is 0xE3069283
+ */
+uint32_t cpt_crc32c(uint32_t crc, const void *src, size_t n)
+{
+	pthread_once(&crconce, crcinit);
+#ifdef CPT_CRCHW
+	if (crchw)
+		return ~crchard(~crc, src, n);
+#endif
+	
+	return ~crcsoft(~crc, src, n);
+}
+
+/*  Shared by checking threads of cpt_verify  */
+struct cpt_vfy {
+	const uint8_t  *map;
+	const uint64_t *bounds;  /*  n+1 file offsets of Ptx or chunks  */
+	const uint8_t  *crcs;    /*  n CRC as stored                    */
+	const uint64_t *ranges;  /*  first unit of each range, nrange+1 */
+	uint64_t nrange;
+	uint64_t next;           /*  next range to claim                */
+	uint8_t *bad;            /*  n, set where CRC differs           */
+};
+
+static void *vfyworker(void *arg)
+{
+	uint32_t crc;
+	uint64_t irange;
+	struct cpt_vfy *vfy = arg;
+	
+	while ((irange = __atomic_fetch_add(&vfy->next, 1, __ATOMIC_RELAXED)) < vfy->nrange) {
+		for (uint64_t i = vfy->ranges[irange]; i < vfy->ranges[irange+1]; ++i) {
+			memcpy(&crc, vfy->crcs+sizeof(uint32_t[i]), sizeof(crc));
+			vfy->bad[i] = crc != cpt_crc32c(0, vfy->map+vfy->bounds[i],
+			                                vfy->bounds[i+1]-vfy->bounds[i]);
+		}
 	}
 	
-	uint8_t  nparam;
-	uint32_t nptx;
-	struct cpt_ptx ptx;
+	return NULL;
+}
+
+/*
+ *  CRC of n units bounded by bounds and the rest of mapped file,
+ *  CRC table at at, units split by bytes into ranges for nthread threads
+ */
+static int vfymap(const struct cpt_file *file, const uint8_t *map, const uint64_t *bounds,
+                  uint64_t n, uint64_t at, uint8_t nthread, uint64_t *ranges, uint8_t *bad)
+{
+	int ret = 0;
+	uint32_t crc;
+	uint64_t nrange, target;
+	pthread_t tids[256];
+	struct cpt_vfy vfy;
 	
-	cpt_readall(argv[1], &ptx, &nptx, &nparam);
-	for (uint16_t i = 0; i < nptx; ++i) {
-		printf("No.%03d: lon %9.4f lat %8.4f with %2d points (%s)\n",
-		       i+1, (ptx.px+i)->centrepixel->lon,
-		       (ptx.px+i)->centrepixel->lat, (ptx.pt+i)->nt,
-		       (ptx.pt+i)->name);
+	target = (bounds[n]-bounds[0]) / ((uint64_t) nthread*CPT_PARSPLIT);
+	if (target < CPT_BUFSIZE)
+		target = CPT_BUFSIZE;
+	ranges[nrange = 0] = 0;
+	for (uint64_t i = 1; i < n; ++i) {
+		if (bounds[i]-bounds[ranges[nrange]] >= target)
+			ranges[++nrange] = i;
 	}
+	if (n)
+		++nrange;
+	ranges[nrange] = n;
 	
-	cpt_freeptall(&ptx.pt, nptx);
-	cpt_freepxall(&ptx.px, nptx);
+	vfy.map    = map;
+	vfy.bounds = bounds;
+	vfy.crcs   = map+at;
+	vfy.ranges = ranges;
+	vfy.nrange = nrange;
+	vfy.next   = 0;
+	vfy.bad    = bad;
 	
-	return 0;
+	/*  Caller takes ranges as well, so one fewer thread is started  */
+	for (uint8_t ithread = 1; ithread < nthread; ++ithread) {
+		if (pthread_create(tids+ithread, NULL, vfyworker, &vfy)) {
+			nthread = ithread;
+			break;
+		}
+	}
+	vfyworker(&vfy);
+	for (uint8_t ithread = 1; ithread < nthread; ++ithread)
+		pthread_join(tids[ithread], NULL);
+	
+	/*  Head before Data, then closing chunk and tables  */
+	crc = cpt_crc32c(0, map, file->data);
+	crc = cpt_crc32c(crc, map+bounds[n], at-bounds[n]);
+	if (memcmp(&crc, map+at+sizeof(uint32_t[n]), sizeof(crc))) {
+		CPT_ERRECHOWITHTIME("%s has broken header or footer", file->fname);
+		ret = CPT_EFORMAT;
+	}
+	for (uint64_t i = 0; i < n; ++i) {
+		if (!bad[i])
+			continue;
+		CPT_ERRECHOWITHTIME("%s has broken %s No.%lu", file->fname,
+		                    file->buf.chunked ? "chunk" : "Ptx", (unsigned long) i+1);
+		ret = CPT_EFORMAT;
+	}
+	if (memcmp(map+file->fsize-CPT_ENDINGLEN, CPT_ENDING, CPT_ENDINGLEN)) {
+		CPT_ERRECHOWITHTIME("%s has NO ending", file->fname);
+		ret = CPT_EFORMAT;
+	}
+	
+	return ret;
 }
-#endif
 
-int cpt_readall(const char *fname, struct cpt_ptx *ptx, uint32_t *nptx, uint8_t *nparam)
+/*
+ *  Check a checksummed file against its CRC table by nthread threads,
+ *  each broken Ptx or chunk is reported, CPT_EFORMAT if there is any
+ *  or the file is not checksummed.
+ */
+int cpt_verify(const char *fname, uint8_t nthread)
 {
-	int fd;
-	size_t  sparams;
-	uint8_t mgc[CPT_MAGICLEN], ending[CPT_ENDINGLEN], ver;
-	uint8_t  ipoint, ivicinity;
-	uint16_t iptx;
-	struct cpt_pt *ppt;
-	struct cpt_px *ppx;
-	struct cpt_point *ppoint;
+	int ret;
+	void *map;
+	uint8_t  *bad;
+	uint64_t n, *ranges;
+	uint64_t *bounds, tables, at;
+	struct cpt_file file;
 	
-	if ((fd = open(fname, O_RDONLY)) < 0) {
-		CPT_ERROPEN(fname);
-		return 1;
+	if ((ret = cpt_open(fname, &file)))
+		return ret;
+	if (!(file.flags & CPT_FCRC)) {
+		CPT_ERRECHOWITHTIME("%s has NO checksum, see cpttrans", fname);
+		cpt_close(&file);
+		return CPT_EFORMAT;
+	}
+	fileoffs(&file);
+	if (file.noidx || (file.buf.chunked && !file.chunks)) {
+		CPT_ERRECHOWITHTIME("%s has broken footer", fname);
+		cpt_close(&file);
+		return CPT_EFORMAT;
 	}
 	
-	/*  Header check  */
-	read(fd, mgc, CPT_MAGICLEN);
-	if (memcmp(mgc, CPT_MAGIC, CPT_MAGICLEN)) {
-		close(fd);
-		CPT_ERRECHOWITHTIME("%s is NOT a cpt file!", fname);
-		return 2;
+	n = file.buf.chunked ? file.buf.nchunk : file.nptx;
+	bounds = malloc(sizeof(uint64_t[n+1]));
+	ranges = malloc(sizeof(uint64_t[n+1]));
+	if (!bounds || !ranges || !(bad = calloc(n+1, 1))) {
+		CPT_FREE(bounds);
+		CPT_ERRMEM(ranges);
+		cpt_close(&file);
+		return CPT_EMEM;
 	}
 	
-	/*  Version check  */
-	read(fd, &ver, _cpt_1byte);
-	if (CPT_VERSION != ver) {
-		close(fd);
-		CPT_ERRECHOWITHTIME("%s is a cpt file in version %d.%d!\n"
-		                    "while current lib is %d.%d",
-		                    fname, ver>>4, ver|0b00001111, CPT_VER_MAJOR, CPT_VER_MINOR);
+	/*  Units must tile Data and tables must end right at CRC table  */
+	for (uint64_t i = 0; i <= n; ++i)
+		bounds[i] = file.buf.chunked ? file.chunks[2*i] : file.offs[i];
+	tables = bounds[n]+sizeof(uint64_t[file.nptx]);
+	if (file.buf.chunked)
+		tables += CPT_CHUNKHDRLEN+sizeof(uint64_t[n+1][2])+CPT_ZONETABLEN(file.flags, n);
+	at  = file.fsize-CPT_ENDINGLEN-CPT_TRAILERLEN-CPT_CRCTABLEN(file.flags, n);
+	ret = (bounds[0] != (uint64_t) file.data) || (tables != at);
+	for (uint64_t i = 0; !ret && (i < n); ++i)
+		ret = bounds[i] > bounds[i+1];
+	
+	if (ret) {
+		CPT_ERRECHOWITHTIME("%s has broken footer", fname);
+		ret = CPT_EFORMAT;
+	} else if (MAP_FAILED == (map = mmap(NULL, file.fsize, PROT_READ, MAP_SHARED, file.buf.fd, 0))) {
+		CPT_ERRECHOWITHTIME("ERROR %d %s: %s", errno, strerror(errno), fname);
+		ret = CPT_EMEM;
+	} else {
+		madvise(map, file.fsize, MADV_SEQUENTIAL);
+		ret = vfymap(&file, map, bounds, n, at, nthread ? nthread : 1, ranges, bad);
+		munmap(map, file.fsize);
 	}
 	
-	/*  Meta info  */
-	read(fd, nptx, _cpt_4byte);
-	read(fd, nparam, _cpt_1byte);
-	sparams = sizeof(double[*nparam]);
+	free(bounds);
+	free(ranges);
+	free(bad);
+	cpt_close(&file);
 	
-	ptx->pt = malloc(sizeof(struct cpt_pt[*nptx]));
-	ptx->px = malloc(sizeof(struct cpt_px[*nptx]));
+	return ret;
+}
+
+int readpixel(struct cpt_buf *buf, struct cpt_pixel *pixel)
+{
+	struct cpt_dec dec = {.buf = buf};
 	
-	/*  Data  */
-	char namec;
-	uint8_t namelen; // Assume all name is shorter than 255 characters.
-	for (iptx = 0; iptx < *nptx; ++iptx) {
-		
-		/*  Pt  */
-		ppt = ptx->pt+iptx;
-		
-		ppt->name = NULL;
-		namelen = 0;
-		while (read(fd, &namec, _cpt_1byte) && (namec != '\0') && (++namelen)) {
-			ppt->name = realloc(ppt->name, namelen+1);
-			ppt->name[namelen-1] = namec;
-			ppt->name[namelen] = '\0';
+	return decpixel(&dec, pixel);
+}
+
+/*
+ *  Attach a buffer of cap bytes to an opened file descriptor,
+ *  the descriptor is owned by buffer since then.
+ */
+int cpt_bufinit(struct cpt_buf *buf, int fd, size_t cap)
+{
+	buf->fd  = fd;
+	buf->cap = cap;
+	buf->len = buf->pos = 0;
+	buf->off = lseek(fd, 0, SEEK_CUR);
+	buf->nsyscall = 0;
+	buf->chunked  = 0;
+	buf->zdata    = NULL;
+	buf->zcap     = 0;
+	buf->shuffle  = 0;
+	buf->column   = 0;
+	buf->sdata    = NULL;
+	buf->scap     = 0;
+	buf->chunks   = NULL;
+	buf->nchunk   = 0;
+	buf->scaled   = 0;
+	buf->aligned  = 0;
+	buf->ntlen    = 1;
+	buf->siteid   = 0;
+	buf->nsite    = 0;
+	buf->sites    = NULL;
+	if (!(buf->data = malloc(cap))) {
+		CPT_ERRMEM(buf->data);
+		return CPT_EMEM;
+	}
+	
+	return 0;
+}
+
+/*
+ *  Copy next n bytes to dst, refilling the window when exhausted.
+ *  Return CPT_ETRUNC if EOF comes before n bytes.
+ */
+int cpt_bufread(struct cpt_buf *buf, void *dst, size_t n)
+{
+	ssize_t  ret;
+	uint8_t *pdst  = dst;
+	size_t   avail = buf->len - buf->pos;
+	
+	if (n <= avail) {
+		memcpy(pdst, buf->data+buf->pos, n);
+		buf->pos += n;
+		return 0;
+	}
+	
+	/*  Chunks are refilled whole  */
+	while (buf->chunked) {
+		memcpy(pdst, buf->data+buf->pos, avail);
+		pdst += avail;
+		n    -= avail;
+		buf->pos = buf->len;
+		if (bufrefill(buf))
+			return CPT_ETRUNC;
+		if (n <= (avail = buf->len)) {
+			memcpy(pdst, buf->data, n);
+			buf->pos = n;
+			return 0;
 		}
-		
-		read(fd, &ppt->lon, _cpt_4byte);
-		read(fd, &ppt->lat, _cpt_4byte);
-		read(fd, &ppt->alt, _cpt_2byte);
-		read(fd, &ppt->nt , _cpt_1byte);
-		ppt->points = malloc(sizeof(struct cpt_point[ppt->nt]));
-		for (ipoint = 0; ipoint < ppt->nt; ++ipoint) {
-			ppoint = ppt->points+ipoint;
-			read(fd, &ppoint->seconds, _cpt_8byte);
-			ppoint->params = malloc(sparams);
-			read(fd, ppoint->params, sparams);
+	}
+	
+	/*  Drain what is left, then start a new window  */
+	memcpy(pdst, buf->data+buf->pos, avail);
+	pdst += avail;
+	n    -= avail;
+	buf->off += buf->len;
+	buf->len = buf->pos = 0;
+	
+	/*  Oversized field goes straight to destination  */
+	if (n >= buf->cap) {
+		while (n > 0) {
+			++buf->nsyscall;
+			if ((ret = read(buf->fd, pdst, n)) <= 0)
+				return CPT_ETRUNC;
+			buf->off += ret;
+			pdst += ret;
+			n    -= ret;
 		}
-		
-		/*  Px  */
-		ppx = ptx->px+iptx;
-		read(fd, &ppx->seconds, _cpt_8byte);
-		ppx->centrepixel = malloc(sizeof(struct cpt_pixel));
-		readpixel(fd, ppx->centrepixel);
-		read(fd, &ppx->nvicinity, _cpt_1byte);
-		ppx->vicinity = malloc(sizeof(struct cpt_pixel[ppx->nvicinity]));
-		for (ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity) {
-			readpixel(fd, ppx->vicinity+ivicinity);
+		return 0;
+	}
+	
+	while (buf->len < n) {
+		++buf->nsyscall;
+		if ((ret = read(buf->fd, buf->data+buf->len, buf->cap-buf->len)) <= 0)
+			return CPT_ETRUNC;
+		buf->len += ret;
+	}
+	memcpy(pdst, buf->data, n);
+	buf->pos = n;
+	
+	return 0;
+}
+
+/*
+ *  Inflated offset off of chunked layout, by chunk table if any,
+ *  otherwise chunks are inflated from current or first one on.
+ */
+static int chunkseek(struct cpt_buf *buf, off_t off)
+{
+	uint32_t lo = 0, hi = buf->nchunk, mid;
+	
+	if (buf->chunks) {
+		if (off < (off_t) buf->chunks[1])
+			return CPT_ETRUNC;
+		while (lo < hi) {
+			mid = (lo+hi+1)/2;
+			if ((off_t) buf->chunks[2*mid+1] <= off)
+				lo = mid;
+			else
+				hi = mid-1;
 		}
-		
+		buf->ichunk = lo;
+		buf->foff   = buf->chunks[2*lo];
+		buf->off    = buf->chunks[2*lo+1];
+		buf->len    = buf->pos = 0;
+	} else if (off < buf->off) {
+		bufchunk(buf, buf->start, (buf->shuffle ? CPT_FSHUFFLE : 0) | (buf->column ? CPT_FCOLUMN : 0),
+		         buf->nparam);
 	}
 	
-	/*  Ending  */
-	read(fd, ending, CPT_ENDINGLEN);
-	close(fd);
-	if (memcmp(ending, CPT_ENDING, CPT_ENDINGLEN)) {
-		CPT_ERRECHOWITHTIME("%s has NO ending, the results may be incorrect", fname);
-		return 2;
+	return bufskip(buf, off-(buf->off+buf->pos));
+}
+
+/*
+ *  Move to file offset off, no read(2) if it is inside current window,
+ *  offset is an inflated one in chunked layout
+ */
+int cpt_bufseek(struct cpt_buf *buf, off_t off)
+{
+	if ((off >= buf->off) && (off <= buf->off+(off_t) buf->len)) {
+		buf->pos = off-buf->off;
+		return 0;
 	}
+	if (buf->chunked)
+		return chunkseek(buf, off);
+	if (lseek(buf->fd, off, SEEK_SET) < 0)
+		return CPT_ETRUNC;
+	buf->off = off;
+	buf->len = buf->pos = 0;
 	
-	ppt = NULL;
-	ppx = NULL;
-	ppoint = NULL;
+	return 0;
+}
+
+/*
+ *  Release buffer along with its file descriptor
+ */
+int cpt_buffree(struct cpt_buf *buf)
+{
+	if (buf->fd >= 0)
+		close(buf->fd);
+	buf->fd = -1;
+	CPT_FREE(buf->data);
+	CPT_FREE(buf->zdata);
+	CPT_FREE(buf->sdata);
 	
 	return 0;
 }
 
-int readpixel(int filedes, struct cpt_pixel *pixel)
+/*
+ *  Free a tree from cpt_readall or cpt_readallopt in whichever mode,
+ *  a tree decoded into arena goes away at once.
+ */
+int cpt_release(struct cpt_ptx *ptx, uint64_t nptx)
 {
-	/*  Geolocation  */
-	read(filedes, &pixel->lon, _cpt_4byte);
-	read(filedes, &pixel->lat, _cpt_4byte);
-	read(filedes, &pixel->alt, _cpt_2byte);
-	read(filedes, &pixel->mask, _cpt_1byte);
+	if (ptx->arena) {
+		cpt_arenafree(ptx->arena);
+		CPT_FREE(ptx->arena);
+		ptx->pt = NULL;
+		ptx->px = NULL;
+	} else {
+		cpt_freeptall(&ptx->pt, nptx);
+		cpt_freepxall(&ptx->px, nptx);
+	}
 	
-	/*  Dimensions  */
-	read(filedes, &pixel->nchannel, _cpt_1byte);
-	read(filedes, &pixel->nlayer, _cpt_1byte);
+	return 0;
+}
+
+/*
+ *  Region allocator
+ *  Chunks double in size up to CPT_ARENAMAXCHUNK unless a larger block
+ *  is asked, they are kept on reset so that a reused arena stops growing.
+ */
+int cpt_arenainit(struct cpt_arena *arena, size_t chunksize)
+{
+	arena->head = arena->cur = NULL;
+	arena->chunksize = chunksize ? chunksize : CPT_ARENACHUNK;
 	
-	if (pixel->nchannel) {
-		size_t angsize = sizeof(double[pixel->nlayer][4]);
-		size_t _obssize = sizeof(double[pixel->nlayer]);
-		
-		/*  Channel  */
-		size_t obssize;
-		struct cpt_channel *pchannel;
-		pixel->channels = malloc(sizeof(struct cpt_channel[pixel->nchannel]));
-		for (uint8_t ichannel = 0; ichannel < pixel->nchannel; ++ichannel) {
-			pchannel = pixel->channels+ichannel;
-			read(filedes, &pchannel->centrewv, _cpt_2byte);
-			
-			pchannel->obs = malloc(obssize = _obssize*((pchannel->centrewv < 0) ? 3 : 1));
-			read(filedes, pchannel->obs, obssize);
-			pchannel->ang = malloc(angsize);
-			read(filedes, pchannel->ang, angsize);
-		}
-		pchannel = NULL;
-	} else {
-		pixel->nlayer = 0;
-		pixel->channels = NULL;
+	return 0;
+}
+
+void *cpt_arenaalloc(struct cpt_arena *arena, size_t size)
+{
+	void  *ptr;
+	size_t cap;
+	struct cpt_arenachunk *chunk;
+	
+	size = (size+CPT_ARENAALIGN-1) & ~(CPT_ARENAALIGN-1);
+	
+	/*  Current chunk, or an emptied one left by reset  */
+	while ((chunk = arena->cur) && (chunk->cap-chunk->used < size)) {
+		if (!chunk->next)
+			break;
+		arena->cur = chunk->next;
+		arena->cur->used = 0;
 	}
 	
-	read(filedes, &pixel->nextra, _cpt_1byte);
-	if (pixel->nextra) {
-		pixel->extra = malloc(sizeof(double[pixel->nextra]));
-		for (uint8_t iextra = 0; iextra < pixel->nextra; ++iextra) {
-			read(filedes, pixel->extra+iextra, _cpt_8byte);
+	if (!chunk || (chunk->cap-chunk->used < size)) {
+		cap = (size > arena->chunksize) ? size : arena->chunksize;
+		if (!(chunk = malloc(CPT_ARENAHDR+cap)))
+			return NULL;
+		chunk->cap  = cap;
+		chunk->used = 0;
+		if (arena->cur) {
+			chunk->next = arena->cur->next;
+			arena->cur->next = chunk;
+		} else {
+			chunk->next = NULL;
+			arena->head = chunk;
 		}
-	} else {
-		pixel->extra = NULL;
+		arena->cur = chunk;
+		if (arena->chunksize < CPT_ARENAMAXCHUNK)
+			arena->chunksize <<= 1;
 	}
+	
+	ptr = (uint8_t *) chunk + CPT_ARENAHDR + chunk->used;
+	chunk->used += size;
+	
+	return ptr;
+}
+
+int cpt_arenareset(struct cpt_arena *arena)
+{
+	if ((arena->cur = arena->head))
+		arena->cur->used = 0;
+	
+	return 0;
+}
 
+int cpt_arenafree(struct cpt_arena *arena)
+{
+	struct cpt_arenachunk *chunk;
+	
+	while ((chunk = arena->head)) {
+		arena->head = chunk->next;
+		free(chunk);
+	}
+	arena->cur = NULL;
+	
 	return 0;
 }
 
@@ -225,7 +3438,7 @@ int cpt_freepointall(struct cpt_point **p, uint16_t n)
 /*
  *  Free one or more cpt_pt st pointer
  */
-int cpt_freeptall(struct cpt_pt **p, uint32_t n)
+int cpt_freeptall(struct cpt_pt **p, uint64_t n)
 {
 	if (*p) {
 		while (n-- > 0) {
@@ -271,7 +3484,7 @@ int cpt_freepixelall(struct cpt_pixel **p, uint16_t n)
 /*
  *  Free one or more cpt_px st pointer
  */
-int cpt_freepxall(struct cpt_px **p, uint32_t n)
+int cpt_freepxall(struct cpt_px **p, uint64_t n)
 {
 	if (*p) {
 		while (n-- > 0) {
@@ -284,3 +3497,323 @@ int cpt_freepxall(struct cpt_px **p, uint32_t n)
 	return 0;
 }
 
+/*  Take n bytes at *p of view, fail if it goes beyond end  */
+static inline int viewget(const uint8_t **p, const uint8_t *end, void *dst, size_t n)
+{
+	if (n > (size_t) (end-*p))
+		return CPT_ETRUNC;
+	memcpy(dst, *p, n);
+	*p += n;
+	
+	return 0;
+}
+
+static inline int viewskip(const uint8_t **p, const uint8_t *end, size_t n)
+{
+	if (n > (size_t) (end-*p))
+		return CPT_ETRUNC;
+	*p += n;
+	
+	return 0;
+}
+
+/*  Step over padding of aligned layout, mapping starts on a page so addresses will do  */
+static inline int viewpad(const uint8_t **p, const uint8_t *end, uint8_t aligned)
+{
+	return aligned ? viewskip(p, end, CPT_PADLEN((uintptr_t) *p)) : 0;
+}
+
+/*
+ *  Map a cpt file read-only, pages are shared with page cache
+ *  so that several processes may view the same file cheaply.
+ */
+int cpt_viewopen(const char *fname, struct cpt_view *view)
+{
+	void *map;
+	const uint8_t *p;
+	uint32_t nchunk, nbyte;
+	struct stat st;
+	struct cpt_trailer trailer;
+	
+	if ((view->fd = open(fname, O_RDONLY)) < 0) {
+		CPT_ERROPEN(fname);
+		return CPT_EOPEN;
+	}
+	if (fstat(view->fd, &st) || (st.st_size < CPT_HDRLEN01+CPT_ENDINGLEN)) {
+		close(view->fd);
+		CPT_ERRECHOWITHTIME("%s is NOT a cpt file!", fname);
+		return CPT_EFORMAT;
+	}
+	
+	view->size = st.st_size;
+	if (MAP_FAILED == (map = mmap(NULL, view->size, PROT_READ, MAP_SHARED, view->fd, 0))) {
+		CPT_ERRFIO(view->fd);
+		return CPT_EMEM;
+	}
+	view->map = map;
+	view->end = view->map+view->size;
+	view->table = NULL;
+	view->flags = 0;
+	view->nsite = 0;
+	view->sites = NULL;
+	
+	/*  Header  */
+	p = view->map;
+	if (memcmp(p, CPT_MAGIC, CPT_MAGICLEN)) {
+		cpt_viewclose(view);
+		CPT_ERRECHOWITHTIME("%s is NOT a cpt file!", fname);
+		return CPT_EFORMAT;
+	}
+	p += CPT_MAGICLEN;
+	viewget(&p, view->end, &view->ver, _cpt_1byte);
+	view->nptx = 0;
+	viewget(&p, view->end, &view->nptx, CPT_NPTXLENOF(view->ver));
+	viewget(&p, view->end, &view->nparam, _cpt_1byte);
+	if (CPT_VERSION01 != view->ver)
+		viewget(&p, view->end, &view->flags, _cpt_1byte);
+	if (((CPT_VERSION != view->ver) && (CPT_VERSION02 != view->ver) && (CPT_VERSION01 != view->ver))
+	    || (view->flags & ~CPT_FLAGS)) {
+		cpt_viewclose(view);
+		CPT_ERRECHOWITHTIME("%s is a cpt file in version %d.%d!\n"
+		                    "while current lib is %d.%d",
+		                    fname, view->ver>>4, view->ver&0b00001111,
+		                    CPT_VER_MAJOR, CPT_VER_MINOR);
+		return CPT_EFORMAT;
+	}
+	if (view->flags & CPT_FCHUNK) {
+		cpt_viewclose(view);
+		CPT_ERRECHOWITHTIME("%s is chunked and can NOT be mapped, see cpttrans", fname);
+		return CPT_EFORMAT;
+	}
+	
+	/*  Site dictionary, names point into the mapping  */
+	if (view->flags & CPT_FSITEID) {
+		if (viewget(&p, view->end, &view->nsite, _cpt_4byte)
+		    || viewget(&p, view->end, &nbyte, _cpt_4byte)
+		    || (view->nsite > nbyte) || (nbyte > (size_t) (view->end-p))
+		    || !(view->sites = malloc(sizeof(char *[view->nsite+1])))
+		    || sitedict((const char *) p, nbyte, view->nsite, view->sites)) {
+			cpt_viewclose(view);
+			CPT_ERRECHOWITHTIME("%s has broken site dictionary", fname);
+			return CPT_EFORMAT;
+		}
+		p += nbyte;
+	}
+	if (viewpad(&p, view->end, !!(view->flags & CPT_FALIGNED))) {
+		cpt_viewclose(view);
+		CPT_ERRECHOWITHTIME("%s is NOT a cpt file!", fname);
+		return CPT_EFORMAT;
+	}
+	view->data = p;
+	if (view->nptx > (uint64_t) (view->map+view->size-p)/CPT_PTXMINLEN) {
+		cpt_viewclose(view);
+		CPT_ERRECHOWITHTIME("%s has %lu Ptx in header, more than its %lu bytes hold", fname,
+		                    (unsigned long) view->nptx, (unsigned long) view->size);
+		return CPT_EFORMAT;
+	}
+	
+	/*  Ending  */
+	if (memcmp(view->end-CPT_ENDINGLEN, CPT_ENDING, CPT_ENDINGLEN)) {
+		CPT_ERRECHOWITHTIME("%s has NO ending, the results may be incorrect", fname);
+		return 0;
+	}
+	view->end -= CPT_ENDINGLEN;
+	
+	/*  Footer, Data ends at offset table  */
+	if ((CPT_VERSION01 != view->ver) && (view->end-view->data >= CPT_TRAILERLEN)) {
+		memcpy(&trailer, view->end-CPT_TRAILERLEN, CPT_TRAILERLEN);
+		if (trailerok(&trailer, view->nptx, view->flags, view->data-view->map, view->size, &nchunk)) {
+			view->table = view->map+trailer.table;
+			view->end   = view->table;
+		} else {
+			CPT_ERRECHOWITHTIME("%s has NO footer, the results may be incorrect", fname);
+		}
+	}
+	
+	return 0;
+}
+
+/*
+ *  Start of Ptx No.i (from 0) by offset table, NULL if out of range
+ *  or there is no table (0.1), then walk with cpt_viewnext instead.
+ */
+const uint8_t *cpt_viewat(const struct cpt_view *view, uint64_t i)
+{
+	uint64_t off;
+	
+	if (!view->table || (i >= view->nptx))
+		return NULL;
+	memcpy(&off, view->table+sizeof(uint64_t[i]), _cpt_8byte);
+	
+	return view->map+off;
+}
+
+/*
+ *  Describe the Ptx starting at cur, ptx->next is where the following one starts.
+ *  e.g.
+ *      for (i = 0, cur = view.data; i < view.nptx; ++i, cur = ptx.next)
+ *          cpt_viewnext(&view, cur, &ptx);
+ */
+int cpt_viewnext(const struct cpt_view *view, const uint8_t *cur, struct cpt_vptx *ptx)
+{
+	const uint8_t *pend, *end = view->end;
+	struct cpt_vpixel pixel;
+	
+	ptx->base = cur;
+	
+	/*  Pt, name is looked up by site ID with dictionary  */
+	ptx->pt.nt   = 0;
+	ptx->pt.site = CPT_NOSITE;
+	if (view->sites) {
+		if (viewget(&cur, end, &ptx->pt.site, _cpt_4byte) || (ptx->pt.site >= view->nsite))
+			return CPT_ETRUNC;
+		ptx->pt.name = view->sites[ptx->pt.site];
+	} else if ((pend = memchr(cur, '\0', end-cur))) {
+		ptx->pt.name = (const char *) cur;
+		cur = pend+1;
+	} else {
+		return CPT_ETRUNC;
+	}
+	if (viewget(&cur, end, &ptx->pt.lon, _cpt_4byte)
+	    || viewget(&cur, end, &ptx->pt.lat, _cpt_4byte)
+	    || viewget(&cur, end, &ptx->pt.alt, _cpt_2byte)
+	    || viewget(&cur, end, &ptx->pt.nt , CPT_NTLENOF(view->ver))
+	    || viewpad(&cur, end, !!(view->flags & CPT_FALIGNED)))
+		return CPT_ETRUNC;
+	ptx->pt.points = cur;
+	if (viewskip(&cur, end, ptx->pt.nt*(_cpt_8byte+sizeof(double[view->nparam]))))
+		return CPT_ETRUNC;
+	
+	/*  Px  */
+	if (viewget(&cur, end, &ptx->px.seconds, _cpt_8byte))
+		return CPT_ETRUNC;
+	ptx->px.centrepixel = cur;
+	if (cpt_viewpixel(view, cur, &pixel))
+		return CPT_ETRUNC;
+	cur = pixel.next;
+	if (viewget(&cur, end, &ptx->px.nvicinity, _cpt_1byte))
+		return CPT_ETRUNC;
+	ptx->px.vicinity = cur;
+	for (uint8_t ivicinity = 0; ivicinity < ptx->px.nvicinity; ++ivicinity) {
+		if (cpt_viewpixel(view, cur, &pixel))
+			return CPT_ETRUNC;
+		cur = pixel.next;
+	}
+	if (viewpad(&cur, end, !!(view->flags & CPT_FALIGNED)))
+		return CPT_ETRUNC;
+	ptx->next = cur;
+	
+	return 0;
+}
+
+/*
+ *  i-th Point of a Pt
+ */
+int cpt_viewpoint(const struct cpt_view *view, const struct cpt_vpt *pt, uint16_t i,
+                  struct cpt_vpoint *point)
+{
+	const uint8_t *p = pt->points + i*(_cpt_8byte+sizeof(double[view->nparam]));
+	
+	if (i >= pt->nt)
+		return CPT_EFORMAT;
+	memcpy(&point->seconds, p, _cpt_8byte);
+	point->params = p+_cpt_8byte;
+	
+	return 0;
+}
+
+/*
+ *  Describe the Pixel starting at cur, which is either px.centrepixel,
+ *  px.vicinity or pixel.next of previous vicinity Pixel.
+ */
+int cpt_viewpixel(const struct cpt_view *view, const uint8_t *cur, struct cpt_vpixel *pixel)
+{
+	int16_t centrewv;
+	const uint8_t *end = view->end;
+	
+	/*  Geolocation and dimensions  */
+	if (viewget(&cur, end, &pixel->lon, _cpt_4byte)
+	    || viewget(&cur, end, &pixel->lat, _cpt_4byte)
+	    || viewget(&cur, end, &pixel->alt, _cpt_2byte)
+	    || viewget(&cur, end, &pixel->mask, _cpt_1byte)
+	    || viewget(&cur, end, &pixel->nchannel, _cpt_1byte)
+	    || viewget(&cur, end, &pixel->nlayer, _cpt_1byte))
+		return CPT_ETRUNC;
+	if (!pixel->nchannel)
+		pixel->nlayer = 0;
+	pixel->aligned = !!(view->flags & CPT_FALIGNED);
+	pixel->scale = NULL;
+	if (view->flags & CPT_FSCALED) {
+		if (viewpad(&cur, end, pixel->aligned))
+			return CPT_ETRUNC;
+		pixel->scale = cur;
+		if (viewskip(&cur, end, CPT_SCALELEN))
+			return CPT_ETRUNC;
+	}
+	
+	/*  Channel  */
+	pixel->channels = cur;
+	for (uint8_t ichannel = 0; ichannel < pixel->nchannel; ++ichannel) {
+		if (viewget(&cur, end, &centrewv, _cpt_2byte)
+		    || viewpad(&cur, end, pixel->aligned)
+		    || viewskip(&cur, end, channelsize(!!pixel->scale, pixel->nlayer, centrewv)))
+			return CPT_ETRUNC;
+	}
+	
+	/*  Extra  */
+	if (viewget(&cur, end, &pixel->nextra, _cpt_1byte)
+	    || viewpad(&cur, end, pixel->aligned))
+		return CPT_ETRUNC;
+	pixel->extra = cur;
+	if (viewskip(&cur, end, sizeof(double[pixel->nextra])))
+		return CPT_ETRUNC;
+	pixel->next = cur;
+	
+	return 0;
+}
+
+/*
+ *  i-th Channel of a Pixel
+ */
+int cpt_viewchannel(const struct cpt_vpixel *pixel, uint8_t i, struct cpt_vchannel *channel)
+{
+	const uint8_t *cur = pixel->channels;
+	
+	if (i >= pixel->nchannel)
+		return CPT_EFORMAT;
+	
+	channel->nlayer = pixel->nlayer;
+	channel->scale  = pixel->scale;
+	for (;;) {
+		memcpy(&channel->centrewv, cur, _cpt_2byte);
+		cur += _cpt_2byte;
+		if (pixel->aligned)
+			cur += CPT_PADLEN((uintptr_t) cur);
+		if (!i--)
+			break;
+		cur += channelsize(!!pixel->scale, pixel->nlayer, channel->centrewv);
+	}
+	channel->obs = cur;
+	channel->ang = cur+(pixel->scale ? _cpt_2byte : _cpt_8byte)
+	                   *pixel->nlayer*((channel->centrewv < 0) ? 3 : 1);
+	
+	return 0;
+}
+
+/*
+ *  Unmap the view
+ */
+int cpt_viewclose(struct cpt_view *view)
+{
+	CPT_FREE(view->sites);
+	if (view->map) {
+		munmap((void *) view->map, view->size);
+		view->map = NULL;
+	}
+	if (view->fd >= 0) {
+		close(view->fd);
+		view->fd = -1;
+	}
+	
+	return 0;
+}
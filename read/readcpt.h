@@ -1,7 +1,7 @@
 /*
  *file: read/readcpt.h
  *init date: May/10/2022
- *last modify: Jul/27/2022
+ *last modify: Oct/17/2026
  *
  */
 
@@ -18,6 +18,18 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CPT_CRCHW  /*  crc32 instruction of SSE4.2, picked at run time  */
+#include <nmmintrin.h>
+#endif
 
 
 /*  Const numbers  */
@@ -31,15 +43,185 @@
 
 /*  Version  */
 #define CPT_VER_MAJOR (uint8_t) 0
-#define CPT_VER_MINOR (uint8_t) 1
+#define CPT_VER_MINOR (uint8_t) 3
 #define CPT_VERSION   ((CPT_VER_MAJOR<<4) | CPT_VER_MINOR)
+#define CPT_VERSION01 ((0<<4) | 1)  /*  no layout flags nor footer  */
+#define CPT_VERSION02 ((0<<4) | 2)  /*  32-bit nptx, 8-bit nt       */
+
+
+/*
+ *  Header is one byte longer since 0.2 for layout flags,
+ *  nptx of header takes 8 bytes and nt of Pt 2 bytes since 0.3
+ */
+#define CPT_HDRLEN01 (CPT_MAGICLEN+1+4+1)
+#define CPT_HDRLEN02 (CPT_HDRLEN01+1)
+#define CPT_HDRLEN   (CPT_HDRLEN02+4)
+#define CPT_HDRLENOF(ver) ((CPT_VERSION01 == (ver)) ? CPT_HDRLEN01 : \
+                           (CPT_VERSION02 == (ver)) ? CPT_HDRLEN02 : CPT_HDRLEN)
+#define CPT_NPTXLENOF(ver) ((CPT_VERSION02 < (ver)) ? 8 : 4)
+#define CPT_NTLENOF(ver)   ((CPT_VERSION02 < (ver)) ? 2 : 1)
+#define CPT_NTMAXOF(ver)   ((CPT_VERSION02 < (ver)) ? UINT16_MAX : UINT8_MAX)
+#define CPT_NPTXMAXOF(ver) ((CPT_VERSION02 < (ver)) ? UINT64_MAX : UINT32_MAX)
+
+/*
+ *  Least bytes a Ptx takes in plain Data, name of one byte and a Pixel
+ *  of no channel, in chunked Data each still has its offset in footer
+ */
+#define CPT_PTXMINLEN  (1+4+4+2+1+8+4+4+2+1+1+1+1+1)
+#define CPT_PTXMINLENOF(flags) (((flags) & CPT_FCHUNK) ? sizeof(uint64_t) : CPT_PTXMINLEN)
+
+/*  Layout flags  */
+#define CPT_FCHUNK   0x01  /*  Data in deflated chunks of whole Ptx         */
+#define CPT_FSHUFFLE 0x02  /*  chunks split and byte-shuffled, with FCHUNK  */
+#define CPT_FSCALED  0x04  /*  obs and ang as integers scaled per Pixel     */
+#define CPT_FCOLUMN  0x08  /*  chunks in columns, with FCHUNK not FSHUFFLE  */
+#define CPT_FSITEID  0x10  /*  names of Pt as u32 IDs into site dictionary  */
+#define CPT_FALIGNED 0x20  /*  arrays padded to CPT_ALIGN, not with FCHUNK  */
+#define CPT_FCRC     0x40  /*  CRC32C of each Ptx or chunk in footer        */
+#define CPT_FZONE    0x80  /*  zone map of each chunk in footer, with FCHUNK  */
+#define CPT_FLAGS    (CPT_FCHUNK|CPT_FSHUFFLE|CPT_FSCALED|CPT_FCOLUMN|CPT_FSITEID|CPT_FALIGNED \
+                      |CPT_FCRC|CPT_FZONE)
+
+/*
+ *  Site dictionary lies between header and Data, as nsite and nbyte in u32
+ *  then nbyte of nsite NUL-terminated names, ID of a name is its order
+ */
+#define CPT_SITEHDRLEN 8
+#define CPT_NOSITE     UINT32_MAX  /*  site of Pt without dictionary  */
+
+/*
+ *  Chunked layout, chunk header is inflated and deflated length as u32,
+ *  equal lengths mean the chunk is stored as is
+ */
+#define CPT_CHUNKHDRLEN 8
+#define CPT_CHUNKSIZE   ((size_t) 1<<20)  /*  inflated bytes a writer aims at  */
+
+/*
+ *  Shuffled chunk, Ptx are split into skeleton, doubles and u64 seconds,
+ *  inflated as counts of them in u32 then the three streams in turn,
+ *  doubles and delta-coded seconds are stored as byte planes
+ */
+#define CPT_SHUFHDRLEN 12
+
+/*
+ *  Scaled layout, Dimensions of each Pixel are followed by scale and offset
+ *  of obs then of ang as doubles, obs are int16 and ang uint16 in Channels,
+ *  a value is offset+scale*raw
+ */
+#define CPT_SCALELEN 32
+
+/*
+ *  Aligned layout, Data and every Ptx start at a multiple of CPT_ALIGN
+ *  from start of file, zeros are padded up to the next one before Points,
+ *  scale block, obs of each Channel and extra, and at the end of Ptx,
+ *  so that arrays of double in a mapping may be used in place.
+ *  Ptx copied into CPT_PADBOUND(len) bytes always fits, whichever way.
+ */
+#define CPT_ALIGN 8
+#define CPT_PADLEN(off)    ((CPT_ALIGN-(size_t) (off)%CPT_ALIGN)%CPT_ALIGN)
+#define CPT_PADBOUND(len)  (4*(len)+CPT_ALIGN)
+
+/*
+ *  Columnar chunk, fields of Pt, Px and centre Pixel are taken out of Ptx
+ *  into columns, what is left makes the skeleton.
+ *  Inflated chunk is a header, ncol entries of directory, the skeleton
+ *  and columns, each of those starting 8 bytes aligned.
+ *  There are CPT_COLFIXED columns then CPT_COLPERWV for each centre
+ *  wavelength in order of appearance, items of the latter are doubles,
+ *  or int16 and uint16 in scaled layout, nlayer of them per centre Pixel.
+ */
+#define CPT_COLPTLON   0  /*  float of Pt                    */
+#define CPT_COLPTLAT   1
+#define CPT_COLSECONDS 2  /*  u64 of Px                      */
+#define CPT_COLLON     3  /*  float of centre Pixel          */
+#define CPT_COLLAT     4
+#define CPT_COLMASK    5  /*  u8                             */
+#define CPT_COLSCALE   6  /*  CPT_SCALELEN bytes, if scaled  */
+#define CPT_COLFIXED   7
+#define CPT_COLI       7  /*  from here on per wavelength    */
+#define CPT_COLQ       8
+#define CPT_COLU       9
+#define CPT_COLSZA     10
+#define CPT_COLVZA     11
+#define CPT_COLSAA     12
+#define CPT_COLVAA     13
+#define CPT_COLPERWV   7
+#define CPT_COLMAXWV   64
+#define CPT_COLMAX     (CPT_COLFIXED+CPT_COLPERWV*CPT_COLMAXWV)
+
+struct cpt_colhdr {
+	uint32_t nptx;
+	uint32_t ncol;
+	uint32_t nskel;     /*  bytes of skeleton  */
+	uint32_t reserved;
+};
+
+struct cpt_coldir {
+	uint8_t  id;        /*  CPT_COL*                      */
+	uint8_t  size;      /*  bytes per item                */
+	int16_t  wv;        /*  centre wavelength, 0 if none  */
+	uint32_t n;         /*  items                         */
+	uint32_t off;       /*  from start of inflated chunk  */
+};
+
+/*  Room a columnar chunk of len bytes of Ptx takes at most  */
+#define CPT_COLBOUND(len) (sizeof(struct cpt_colhdr)+sizeof(struct cpt_coldir[CPT_COLMAX]) \
+                           +(len)+8*(CPT_COLMAX+1))
+
+
+/*
+ *  Footer since 0.2, offset table of Ptx then trailer,
+ *  trailer sits right before Ending.
+ */
+#define CPT_TRAILERLEN   24
+#define CPT_TRAILERMAGIC (uint8_t[8]) {'c', 'p', 't', 'f', 'o', 'o', 't', '\n'}
+
+struct cpt_trailer {
+	uint64_t table;   /*  file offset of offset table  */
+	uint64_t ntable;  /*  entries of offset table      */
+	uint8_t  magic[8];
+};
+
+/*
+ *  Checksummed layout, tables are followed by CRC32C of each of n Ptx,
+ *  or of each of n chunks with its header, then one of the rest of file
+ *  but trailer and Ending, that is head before Data and Data to CRC table
+ */
+#define CPT_CRCTABLEN(flags, n) (((flags) & CPT_FCRC) ? sizeof(uint32_t)*((size_t) (n)+1) : 0)
+
+/*
+ *  Zone mapped layout, chunk table is followed by bounds of what
+ *  each of n chunks holds, then one more of them all, so that chunks
+ *  a filter rules out are skipped without being inflated
+ */
+struct cpt_zone {
+	float    lonmin, lonmax;    /*  of Pt                                   */
+	float    latmin, latmax;
+	uint64_t tmin, tmax;        /*  seconds of Px                           */
+	uint32_t sitemin, sitemax;  /*  IDs, min > max without site dictionary  */
+};
+
+#define CPT_ZONETABLEN(flags, n) (((flags) & CPT_FZONE) ? sizeof(struct cpt_zone[(size_t) (n)+1]) : 0)
+
+
+/*  Error numbers  */
+enum CPT_ERR {
+CPT_EOPEN = 1,
+CPT_EFORMAT,
+CPT_ETRUNC,
+CPT_EMEM,
+CPT_EEND,
+CPT_EAGAIN,
+CPT_EWRITE
+};
 
 
 /*  Structures in cpt hierarchy  */
 struct cpt_header {
 	uint8_t  ver;
 	uint8_t  nparam;
-	uint32_t nptx;
+	uint8_t  flags;
+	uint64_t nptx;
 	uint8_t *magic_number;
 };
 
@@ -76,17 +258,19 @@ struct cpt_point {
 #define CPT_POINTSIZE  (sizeof(struct cpt_point))
 
 struct cpt_pt {
-	uint8_t nt;
+	uint16_t nt;
 	int16_t alt;
 	float   lon;
 	float   lat;
 	char   *name;
+	uint32_t site;  /*  ID into site dictionary, CPT_NOSITE without  */
 	struct cpt_point *points;
 };
 
 struct cpt_ptx {
 	struct cpt_pt *pt;
 	struct cpt_px *px;
+	struct cpt_arena *arena;  /*  non-NULL if decoded into arena  */
 };
 
 struct cpt_ff {
@@ -96,6 +280,340 @@ struct cpt_ff {
 };
 
 
+/*
+ *  Buffered input
+ *  Fields are parsed out of a large user-space window of the file
+ *  instead of issuing one read(2) per field.
+ */
+#define CPT_BUFSIZE ((size_t) 1<<20)
+
+struct cpt_buf {
+	int      fd;
+	uint8_t *data;
+	size_t   cap;       /*  allocated size of data     */
+	size_t   len;       /*  valid bytes in data        */
+	size_t   pos;       /*  cursor inside data         */
+	off_t    off;       /*  file offset of data[0]     */
+	uint64_t nsyscall;  /*  count of read(2) issued    */
+	
+	/*  Chunked layout, window is one inflated chunk and offsets are inflated ones  */
+	uint8_t  chunked;
+	uint32_t ichunk;    /*  index of next chunk        */
+	off_t    start;     /*  file offset of first chunk */
+	off_t    foff;      /*  file offset of next chunk  */
+	uint8_t *zdata;     /*  deflated chunk             */
+	size_t   zcap;
+	uint8_t  shuffle;   /*  chunks are shuffled        */
+	uint8_t  nparam;
+	uint8_t *sdata;     /*  inflated shuffled chunk    */
+	size_t   scap;
+	uint8_t  column;    /*  chunks are columnar, also inflated into sdata  */
+	const uint64_t *chunks;  /*  nchunk+1 pairs of file and inflated offset, NULL to seek by scan  */
+	uint32_t nchunk;
+	
+	uint8_t  scaled;    /*  Pixels in scaled layout    */
+	uint8_t  aligned;   /*  arrays padded to CPT_ALIGN */
+	uint8_t  ntlen;     /*  bytes of nt, CPT_NTLENOF   */
+	
+	/*  Names of Pt are IDs into these, not owned by buffer  */
+	uint8_t  siteid;
+	uint32_t nsite;
+	const char *const *sites;
+};
+
+
+/*
+ *  Region allocator
+ *  A tree decoded into arena takes a few large blocks
+ *  and is torn down by cpt_release at once.
+ */
+#define CPT_ARENACHUNK    ((size_t) 1<<20)
+#define CPT_ARENAMAXCHUNK ((size_t) 1<<26)
+#define CPT_ARENAALIGN    ((size_t) 16)
+#define CPT_ARENAHDR      ((sizeof(struct cpt_arenachunk)+CPT_ARENAALIGN-1) & ~(CPT_ARENAALIGN-1))
+
+struct cpt_arenachunk {
+	struct cpt_arenachunk *next;
+	size_t cap;
+	size_t used;
+};
+
+struct cpt_arena {
+	struct cpt_arenachunk *head;
+	struct cpt_arenachunk *cur;
+	size_t chunksize;  /*  size of next chunk  */
+};
+
+
+/*
+ *  Projection, blocks left out of decoding.
+ *  Skipped arrays come out as NULL with their count zeroed,
+ *  except that obs of a polarized channel holds I only without Q and U.
+ */
+#define CPT_SKIPQU    0x01  /*  Q and U of polarized channels  */
+#define CPT_SKIPANG   0x02  /*  sza, vza, saa and vaa          */
+#define CPT_SKIPVICI  0x04  /*  vicinity pixels                */
+#define CPT_SKIPEXTRA 0x08  /*  extra info of pixels           */
+
+/*
+ *  Predicates tested on leading fields of each Ptx,
+ *  a Ptx failing any of those set in flags is skipped undecoded,
+ *  whole chunks are if their zone maps rule them out.
+ *  Bounds are inclusive, lonmin > lonmax wraps across 180.
+ */
+#define CPT_FBBOX 0x01  /*  lon and lat of Pt     */
+#define CPT_FTIME 0x02  /*  seconds of Px         */
+#define CPT_FSITE 0x04  /*  name of Pt            */
+#define CPT_FMASK 0x08  /*  mask of centre pixel  */
+
+struct cpt_filter {
+	uint8_t  flags;
+	uint8_t  mask;
+	float    lonmin, lonmax;
+	float    latmin, latmax;
+	uint64_t tmin, tmax;
+	const char *site;
+};
+
+/*
+ *  One chunk of columnar layout as inflated, valid until next cpt_next_block,
+ *  columns are looked up by cpt_blockcol.
+ */
+struct cpt_block {
+	uint64_t iptx;  /*  index of first Ptx in it  */
+	uint32_t nptx;
+	uint32_t ncol;
+	const struct cpt_coldir *dir;
+	const uint8_t *base;
+};
+
+/*  Options of cpt_readallopt  */
+struct cpt_readopt {
+	uint8_t arena;    /*  decode into one arena, free by cpt_release  */
+	uint8_t nthread;  /*  decode by so many threads if more than 1    */
+	uint8_t skip;     /*  projection, CPT_SKIP* or-ed                 */
+	const struct cpt_filter *filter;  /*  only Ptx passing it are kept  */
+};
+
+/*  Parallel decoding splits data into ranges of Ptx, about 8 per thread  */
+#define CPT_PARSPLIT 8
+
+
+/*
+ *  Sidecar offset index, saved as <cpt file>.cptidx
+ *  Header is followed by nptx entries, then a pool of NUL-terminated
+ *  site names starting with the empty one.
+ *  Size and mtime of the indexed file tell whether index is stale.
+ */
+#define CPT_IDXMAGICLEN 8
+#define CPT_IDXMAGIC    (uint8_t[CPT_IDXMAGICLEN]) {'c', 'p', 't', 'i', 'd', 'x', 0, 2}
+#define CPT_IDXSUFFIX   ".cptidx"
+
+struct cpt_idxhdr {
+	uint8_t  magic[CPT_IDXMAGICLEN];
+	uint64_t nptx;
+	uint32_t npool;    /*  bytes of name pool        */
+	uint32_t reserved;
+	uint64_t fsize;
+	int64_t  mtime;    /*  seconds                   */
+	int64_t  mtimens;  /*  nanoseconds               */
+	uint64_t end;      /*  file offset after Data    */
+};
+
+struct cpt_idxent {
+	uint64_t off;      /*  file offset of Ptx        */
+	uint64_t seconds;  /*  of Px                     */
+	float    lon;      /*  of Pt                     */
+	float    lat;
+	uint32_t name;     /*  offset into name pool     */
+	uint32_t reserved;
+};
+
+struct cpt_idx {
+	struct cpt_idxhdr  hdr;
+	struct cpt_idxent *ents;
+	char *pool;
+};
+
+
+/*
+ *  Streaming reader
+ *  Ptx are decoded one at a time into caller's arena,
+ *  so memory does not grow with the file.
+ */
+struct cpt_file {
+	uint8_t  ver;
+	uint8_t  nparam;
+	uint8_t  flags;  /*  layout flags, 0 before 0.2         */
+	uint8_t  ended;  /*  Ending has been checked            */
+	uint8_t  noidx;  /*  no footer nor valid sidecar index  */
+	uint8_t  skip;   /*  projection, may be set after open  */
+	uint64_t nptx;
+	uint64_t iptx;   /*  index of next Ptx                  */
+	size_t   fsize;
+	off_t    data;   /*  file offset of first Ptx           */
+	char    *fname;
+	uint64_t *offs;    /*  nptx+1 offsets, last is after Data, loaded on first cpt_seek  */
+	uint64_t *chunks;  /*  chunk table of chunked layout, loaded along with offs        */
+	struct cpt_zone *zones;  /*  nchunk+1 zone maps, loaded along with chunks, may be NULL  */
+	uint8_t  *raw;   /*  copy of a record across windows    */
+	size_t    rawcap;
+	struct cpt_buf buf;
+	const struct cpt_filter *filter;  /*  for cpt_next_ptx, may be set after open  */
+	uint32_t nsite;  /*  site dictionary, sites[i] is name of ID i, NULL without  */
+	uint32_t nsitebyte;
+	char    *sitepool;
+	const char **sites;
+};
+
+
+/*
+ *  Summary of a cpt file, gathered by skipping payloads.
+ *  Ranges of Pt geolocation and Px seconds, dimensions as min and max,
+ *  counts of Ptx per nvicinity and of channels per centre wavelength.
+ */
+#define CPT_STATMAXWV 64
+
+struct cpt_stat {
+	uint8_t  ver;
+	uint8_t  nparam;
+	uint64_t nptx;
+	uint64_t fsize;
+	uint64_t npoint;
+	uint64_t npixel;       /*  centre and vicinity        */
+	float    lonmin, lonmax;
+	float    latmin, latmax;
+	uint64_t tmin, tmax;   /*  seconds of Px              */
+	uint16_t ntmin, ntmax;
+	uint8_t  nchannelmin, nchannelmax;
+	uint8_t  nlayermin, nlayermax;
+	uint8_t  nextramin, nextramax;
+	uint32_t nvicinity[256];
+	uint16_t nwv;          /*  distinct centre wavelength, by first seen  */
+	int16_t  wv[CPT_STATMAXWV];
+	uint64_t nwvchannel[CPT_STATMAXWV];
+	uint32_t nsite;        /*  of site dictionary, 0 without  */
+};
+
+
+
+/*
+ *  Read-only mapped view
+ *  Descriptors below point into the mapping rather than owning copies,
+ *  arrays of double are not aligned, use cpt_viewdouble to load them,
+ *  and cpt_viewobs or cpt_viewang for those of Channel.
+ *  In aligned layout cpt_viewarray hands them out in place instead.
+ */
+struct cpt_view {
+	int      fd;
+	uint8_t  ver;
+	uint8_t  nparam;
+	uint8_t  flags;
+	uint64_t nptx;
+	size_t   size;
+	const uint8_t *map;
+	const uint8_t *data;   /*  first Ptx                        */
+	const uint8_t *end;    /*  footer or Ending                 */
+	const uint8_t *table;  /*  offset table, NULL before 0.2    */
+	uint32_t nsite;
+	const char **sites;    /*  into the mapping, NULL without site dictionary  */
+};
+
+struct cpt_vchannel {
+	int16_t centrewv;
+	uint8_t nlayer;
+	const uint8_t *obs;  /*  I, followed by Q and U if polarized  */
+	const uint8_t *ang;  /*  sza, vza, saa and vaa                */
+	const uint8_t *scale;  /*  that of Pixel                      */
+};
+
+struct cpt_vpixel {
+	uint8_t mask;
+	uint8_t nchannel;
+	uint8_t nlayer;
+	uint8_t nextra;
+	uint8_t aligned;  /*  arrays padded to CPT_ALIGN  */
+	int16_t alt;
+	float   lat;
+	float   lon;
+	const uint8_t *channels;  /*  first Channel   */
+	const uint8_t *scale;     /*  CPT_SCALELEN bytes, NULL unless scaled  */
+	const uint8_t *extra;
+	const uint8_t *next;      /*  byte after it   */
+};
+
+struct cpt_vpoint {
+	uint64_t seconds;
+	const uint8_t *params;
+};
+
+struct cpt_vpt {
+	uint16_t nt;
+	int16_t alt;
+	float   lon;
+	float   lat;
+	const char    *name;
+	uint32_t       site;  /*  CPT_NOSITE without site dictionary  */
+	const uint8_t *points;
+};
+
+struct cpt_vpx {
+	uint8_t  nvicinity;
+	uint64_t seconds;
+	const uint8_t *centrepixel;
+	const uint8_t *vicinity;  /*  first vicinity Pixel  */
+};
+
+struct cpt_vptx {
+	const uint8_t *base;
+	const uint8_t *next;
+	struct cpt_vpt pt;
+	struct cpt_vpx px;
+};
+
+/*  i-th double of an array inside view  */
+static inline double cpt_viewdouble(const uint8_t *p, size_t i)
+{
+	double d;
+	
+	memcpy(&d, p+sizeof(double)*i, sizeof(double));
+	return d;
+}
+
+/*
+ *  Array of double inside view as it is, NULL if it is not aligned,
+ *  which never happens in aligned layout except for obs and ang if scaled
+ */
+static inline const double *cpt_viewarray(const uint8_t *p)
+{
+	return ((uintptr_t) p % CPT_ALIGN) ? NULL : (const double *) p;
+}
+
+/*
+ *  i-th obs or ang of a Channel inside view, expanded from raw integer
+ *  if scaled, those who take integers read int16 or uint16 arrays instead
+ */
+static inline double cpt_viewobs(const struct cpt_vchannel *channel, size_t i)
+{
+	int16_t raw;
+	
+	if (!channel->scale)
+		return cpt_viewdouble(channel->obs, i);
+	memcpy(&raw, channel->obs+sizeof(int16_t)*i, sizeof(int16_t));
+	return cpt_viewdouble(channel->scale, 1)+cpt_viewdouble(channel->scale, 0)*raw;
+}
+
+static inline double cpt_viewang(const struct cpt_vchannel *channel, size_t i)
+{
+	uint16_t raw;
+	
+	if (!channel->scale)
+		return cpt_viewdouble(channel->ang, i);
+	memcpy(&raw, channel->ang+sizeof(uint16_t)*i, sizeof(uint16_t));
+	return cpt_viewdouble(channel->scale, 3)+cpt_viewdouble(channel->scale, 2)*raw;
+}
+
+
 /*  Useful fn  */
 #define CPT_FREE(ptr) \
 	do { \
@@ -105,9 +623,9 @@ struct cpt_ff {
 		} \
 	} while (0)
 
-time_t curtime;
 #define __CPT_ECHOWITHTIME(stream, ...) \
 	do { \
+		time_t curtime; \
 		time(&curtime); \
 		fprintf(stream, "[%15.15s] ", ctime(&curtime)+4); \
 		fprintf(stream, __VA_ARGS__); \
@@ -144,11 +662,53 @@ time_t curtime;
 
 /*  fn  */
 int cpt_readall(const char *fname, struct cpt_ptx *ptx, uint32_t *nptx, uint8_t *nparam);
-int readpixel(int filedes, struct cpt_pixel *pixel);
+int cpt_readallopt(const char *fname, struct cpt_ptx *ptx, uint64_t *nptx, uint8_t *nparam,
+                   const struct cpt_readopt *opt);
+int cpt_release(struct cpt_ptx *ptx, uint64_t nptx);
+int cpt_open(const char *fname, struct cpt_file *file);
+int cpt_next_ptx(struct cpt_file *file, struct cpt_ptx *ptx, struct cpt_arena *arena);
+int cpt_close(struct cpt_file *file);
+int cpt_seek(struct cpt_file *file, uint64_t i);
+int cpt_read_ptx(struct cpt_file *file, uint64_t i, struct cpt_ptx *ptx, struct cpt_arena *arena);
+int cpt_follow(struct cpt_file *file, struct cpt_ptx *ptx, struct cpt_arena *arena);
+int cpt_next_raw(struct cpt_file *file, const uint8_t **data, size_t *len);
+int cpt_next_block(struct cpt_file *file, struct cpt_block *block);
+const void *cpt_blockcol(const struct cpt_block *block, uint8_t id, int16_t wv, uint32_t *n);
+off_t cpt_tell(const struct cpt_file *file);
+int cpt_resume(struct cpt_file *file, off_t off, uint64_t iptx);
+int cpt_idxbuild(const char *fname);
+int cpt_idxload(const char *fname, struct cpt_idx *idx);
+int cpt_idxfree(struct cpt_idx *idx);
+int cpt_stat(const char *fname, struct cpt_stat *stat);
+int cpt_verify(const char *fname, uint8_t nthread);
+uint32_t cpt_crc32c(uint32_t crc, const void *src, size_t n);
+int readpixel(struct cpt_buf *buf, struct cpt_pixel *pixel);
+int cpt_bufinit(struct cpt_buf *buf, int fd, size_t cap);
+int cpt_bufread(struct cpt_buf *buf, void *dst, size_t n);
+int cpt_bufseek(struct cpt_buf *buf, off_t off);
+int cpt_chunkshuffle(const uint8_t *raw, size_t len, uint8_t ver, uint8_t nparam, uint8_t flags,
+                     uint8_t *out);
+int cpt_chunkcolumn(const uint8_t *raw, size_t len, uint8_t ver, uint8_t nparam, uint8_t flags,
+                    uint8_t *out, size_t *outlen);
+int cpt_ptxalign(const uint8_t *raw, size_t len, uint8_t ver, uint8_t nparam,
+                 uint8_t from, uint8_t to, uint8_t *out, size_t *outlen);
+int cpt_buffree(struct cpt_buf *buf);
+int cpt_arenainit(struct cpt_arena *arena, size_t chunksize);
+void *cpt_arenaalloc(struct cpt_arena *arena, size_t size);
+int cpt_arenareset(struct cpt_arena *arena);
+int cpt_arenafree(struct cpt_arena *arena);
+int cpt_viewopen(const char *fname, struct cpt_view *view);
+int cpt_viewnext(const struct cpt_view *view, const uint8_t *cur, struct cpt_vptx *ptx);
+const uint8_t *cpt_viewat(const struct cpt_view *view, uint64_t i);
+int cpt_viewpoint(const struct cpt_view *view, const struct cpt_vpt *pt, uint16_t i,
+                  struct cpt_vpoint *point);
+int cpt_viewpixel(const struct cpt_view *view, const uint8_t *cur, struct cpt_vpixel *pixel);
+int cpt_viewchannel(const struct cpt_vpixel *pixel, uint8_t i, struct cpt_vchannel *channel);
+int cpt_viewclose(struct cpt_view *view);
 int cpt_freethemall(uint8_t n, ...);
 int cpt_freepointall(struct cpt_point **p, uint16_t n);
-int cpt_freeptall(struct cpt_pt **p, uint32_t n);
+int cpt_freeptall(struct cpt_pt **p, uint64_t n);
 int cpt_freechannelall(struct cpt_channel **p, uint16_t n);
 int cpt_freepixelall(struct cpt_pixel **p, uint16_t n);
-int cpt_freepxall(struct cpt_px **p, uint32_t n);
+int cpt_freepxall(struct cpt_px **p, uint64_t n);
 
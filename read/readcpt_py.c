@@ -3,15 +3,22 @@
 
 #include "readcpt.c"
 
-static int setpixeldict(PyObject *pixeldict, struct cpt_pixel *ppixel);
+static int setpixeldict(PyObject *pixeldict, struct cpt_pixel *ppixel, uint8_t skip);
 
 /*  Main fn src  */
-static PyObject *cpt_readall_py(PyObject *self, PyObject *args)
+static PyObject *cpt_readall_py(PyObject *self, PyObject *args, PyObject *kwargs)
 {
+	static char *kwlist[] = {"fname", "nthread", "skip", "bbox", "time", "site", "mask", NULL};
+	int   ret;
 	char *fname = NULL;
-	uint8_t  nparam, iparam, ipoint, ivicinity;
-	uint32_t nptx, iptx;
+	uint8_t  nparam, iparam, ivicinity;
+	uint16_t ipoint;
+	uint64_t nptx, iptx;
 	struct cpt_ptx ptx;
+	int   mask = -1;
+	PyObject *bbox = Py_None, *period = Py_None;
+	struct cpt_filter  filter = {0};
+	struct cpt_readopt opt = {.arena = 1};
 	struct cpt_pt *ppt;
 	struct cpt_px *ppx;
 	struct cpt_point *ppoint;
@@ -24,13 +31,41 @@ static PyObject *cpt_readall_py(PyObject *self, PyObject *args)
 	         *pixeldict,
 	         *vicilist;
 	
-	/*  Wrap pystring to char*  */
-	if(!PyArg_ParseTuple(args, "s", &fname))
+	/*  Wrap pystring to char*, optional count of decoding threads, projection and filter  */
+	if(!PyArg_ParseTupleAndKeywords(args, kwargs, "s|bbOOzi", kwlist,
+	                                &fname, &opt.nthread, &opt.skip,
+	                                &bbox, &period, &filter.site, &mask))
 		return NULL;
+	if (Py_None != bbox) {
+		if (!PyArg_ParseTuple(bbox, "ffff", &filter.lonmin, &filter.lonmax,
+		                                    &filter.latmin, &filter.latmax))
+			return NULL;
+		filter.flags |= CPT_FBBOX;
+	}
+	if (Py_None != period) {
+		if (!PyArg_ParseTuple(period, "KK", &filter.tmin, &filter.tmax))
+			return NULL;
+		filter.flags |= CPT_FTIME;
+	}
+	if (filter.site)
+		filter.flags |= CPT_FSITE;
+	if (mask >= 0) {
+		filter.mask   = mask;
+		filter.flags |= CPT_FMASK;
+	}
+	if (filter.flags)
+		opt.filter = &filter;
 	
 	/*  Original C result  */
-	if ((cpt_readall(fname, &ptx, &nptx, &nparam)))
-		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	ret = cpt_readallopt(fname, &ptx, &nptx, &nparam, &opt);
+	Py_END_ALLOW_THREADS
+	if (ret) {
+		cpt_release(&ptx, nptx);
+		if (CPT_EMEM == ret)
+			return PyErr_NoMemory();
+		return PyErr_Format(PyExc_OSError, "%s can NOT be read, error %d", fname, ret);
+	}
 	
 	/*  Wrap C result to python  */
 	retlist = PyList_New(nptx);
@@ -56,6 +91,8 @@ static PyObject *cpt_readall_py(PyObject *self, PyObject *args)
 		}
 		PyDict_SetItemString(ptxdict, "pt", pointlist);
 		PyDict_SetItemString(ptxdict, "ptname", Py_BuildValue("s", ppt->name));
+		PyDict_SetItemString(ptxdict, "ptsite", PyLong_FromLong((CPT_NOSITE == ppt->site) ?
+		                                                        -1 : (long) ppt->site));
 		PyDict_SetItemString(ptxdict, "ptlon", PyFloat_FromDouble(ppt->lon));
 		PyDict_SetItemString(ptxdict, "ptlat", PyFloat_FromDouble(ppt->lat));
 		PyDict_SetItemString(ptxdict, "ptalt", PyLong_FromLong(ppt->alt));
@@ -66,14 +103,14 @@ static PyObject *cpt_readall_py(PyObject *self, PyObject *args)
 		
 		ppixel = ppx->centrepixel;
 		pixeldict = PyDict_New();
-		setpixeldict(pixeldict, ppixel);
+		setpixeldict(pixeldict, ppixel, opt.skip);
 		PyDict_SetItemString(ptxdict, "pxcenter", pixeldict);
 		
 		vicilist = PyList_New(ppx->nvicinity);
 		for (ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity) {
 			ppixel = ppx->vicinity+ivicinity;
 			pixeldict = PyDict_New();
-			setpixeldict(pixeldict, ppixel);
+			setpixeldict(pixeldict, ppixel, opt.skip);
 			
 			PyList_SetItem(vicilist, ivicinity, pixeldict);
 		}
@@ -83,14 +120,13 @@ static PyObject *cpt_readall_py(PyObject *self, PyObject *args)
 	}
 	
 	/*  Free original C result  */
-	cpt_freeptall(&ptx.pt, nptx);
-	cpt_freepxall(&ptx.px, nptx);
+	cpt_release(&ptx, nptx);
 	
 	/*  Return to python  */
 	return retlist;
 }
 
-static int setpixeldict(PyObject *pixeldict, struct cpt_pixel *ppixel)
+static int setpixeldict(PyObject *pixeldict, struct cpt_pixel *ppixel, uint8_t skip)
 {
 	uint8_t ilayer;
 	PyObject *satlist;
@@ -115,7 +151,7 @@ static int setpixeldict(PyObject *pixeldict, struct cpt_pixel *ppixel)
 		PyDict_SetItemString(pixeldict, keyname, satlist);
 		
 		/*  Q and U  */
-		if (pchannel->centrewv < 0) {
+		if ((pchannel->centrewv < 0) && !(skip & CPT_SKIPQU)) {
 			satlist = PyList_New(ppixel->nlayer);
 			for (ilayer = ppixel->nlayer; ilayer < 2*ppixel->nlayer; ++ilayer) {
 				PyList_SetItem(satlist, ilayer-ppixel->nlayer,
@@ -134,6 +170,8 @@ static int setpixeldict(PyObject *pixeldict, struct cpt_pixel *ppixel)
 		}
 		
 		/*  sz/vz/sa/va  */
+		if (!pchannel->ang)
+			continue;
 		satlist = PyList_New(ppixel->nlayer);
 		for (ilayer = 0; ilayer < ppixel->nlayer; ++ilayer) {
 			PyList_SetItem(satlist, ilayer,
@@ -185,7 +223,9 @@ static int setpixeldict(PyObject *pixeldict, struct cpt_pixel *ppixel)
 
 /*  Register fn to python  */
 static PyMethodDef cptreadallpymethod[] = {
-	{"load", cpt_readall_py, METH_VARARGS, "Load entire cpt"},
+	{"load", (PyCFunction) cpt_readall_py, METH_VARARGS|METH_KEYWORDS,
+	 "Load entire cpt, load(fname, nthread=0, skip=0, bbox=None, time=None, site=None, mask=-1)\n"
+	 "skip or-ed from SKIP*, bbox (lonmin, lonmax, latmin, latmax), time (tmin, tmax)"},
 	{NULL, NULL, 0, NULL}
 };
 static struct PyModuleDef cptreadallpymod = {
@@ -197,6 +237,15 @@ static struct PyModuleDef cptreadallpymod = {
 };
 PyMODINIT_FUNC PyInit_pycpt(void)
 {
-	return PyModule_Create(&cptreadallpymod);
+	PyObject *mod;
+	
+	if (!(mod = PyModule_Create(&cptreadallpymod)))
+		return NULL;
+	PyModule_AddIntConstant(mod, "SKIPQU", CPT_SKIPQU);
+	PyModule_AddIntConstant(mod, "SKIPANG", CPT_SKIPANG);
+	PyModule_AddIntConstant(mod, "SKIPVICI", CPT_SKIPVICI);
+	PyModule_AddIntConstant(mod, "SKIPEXTRA", CPT_SKIPEXTRA);
+	
+	return mod;
 }
 
@@ -7,7 +7,9 @@ def main():
 		description="Python interface for reading cpt file format file",
 		author="Jay Tsung",
 		author_email="dongjt@proton.me",
-		ext_modules=[Extension("pycpt", ["readcpt_py.c"])])
+		ext_modules=[Extension("pycpt", ["readcpt_py.c"],
+		                       extra_link_args=["-pthread"],
+		                       libraries=["z"])])
 
 if __name__ == "__main__":
 	main()
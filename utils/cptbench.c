@@ -0,0 +1,1352 @@
+/*
+ *file: utils/cptbench.c
+ *descreption:
+ *  benchmark harness of cpt reading on synthetic or real files
+ *synopsis:
+ *  cptbench gen output nptx [nt]
+ *  cptbench read input [repeat]
+ *  cptbench view input
+ *  cptbench stream input [input...]
+ *  cptbench seek input [nread]
+ *  cptbench par input [maxthread]
+ *  cptbench proj input
+ *  cptbench filter input [lonmin lonmax latmin latmax]
+ *  cptbench stat input
+ *  cptbench zip input chunked [nthread]
+ *  cptbench col input columnar [wv]
+ *  cptbench scale input [input...]
+ *  cptbench write input output [repeat [nthread]]
+ *  cptbench corrupt input copy
+ *  cptbench append input copy
+ *  cptbench range output
+ *init date: Oct/17/2026
+ *last modify: Oct/17/2026
+ *
+ */
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "../write/writecpt.h"
+
+
+/*  Synthetic file settings, mimic a DPC matchup  */
+#define CPT_BENCH_NPARAM  4
+#define CPT_BENCH_NSITE   300
+#define CPT_BENCH_NLAYER  12
+#define CPT_BENCH_NCHNL   8
+#define CPT_BENCH_NVICI   8
+#define CPT_BENCH_CNTRWV  (int16_t[CPT_BENCH_NCHNL]) \
+                          {443, -490, 565, -670, 763, 765, -865, 910}
+
+
+/*  Deterministic pseudo random numbers  */
+static uint64_t benchseed = 20220510;
+static double benchrand(void)
+{
+	benchseed = benchseed*6364136223846793005ULL + 1442695040888963407ULL;
+	return (benchseed >> 11) * (1.0/9007199254740992.0);
+}
+
+static double benchnow(void)
+{
+	struct timeval tv;
+	
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+/*  Count of read(2), key syscr, or write(2), key syscw, issued so far  */
+static uint64_t benchsysc(const char *key)
+{
+	char line[64];
+	size_t klen = strlen(key);
+	uint64_t count = 0;
+	FILE *fp;
+	
+	if (!(fp = fopen("/proc/self/io", "r")))
+		return 0;
+	while (fgets(line, sizeof(line), fp)) {
+		if (!strncmp(line, key, klen) && (':' == line[klen])) {
+			count = strtoull(line+klen+1, NULL, 10);
+			break;
+		}
+	}
+	fclose(fp);
+	
+	return count;
+}
+
+static void genpixel(FILE *fp, float lon, float lat)
+{
+	uint8_t  mask = 1, nchannel = CPT_BENCH_NCHNL, nlayer = CPT_BENCH_NLAYER, nextra = 1;
+	int16_t  alt = 100*benchrand();
+	int16_t  wv;
+	double   obs[CPT_BENCH_NLAYER*3], ang[CPT_BENCH_NLAYER*4], extra;
+	
+	fwrite(&lon, 4, 1, fp);
+	fwrite(&lat, 4, 1, fp);
+	fwrite(&alt, 2, 1, fp);
+	fwrite(&mask, 1, 1, fp);
+	fwrite(&nchannel, 1, 1, fp);
+	fwrite(&nlayer, 1, 1, fp);
+	for (uint8_t ichannel = 0; ichannel < nchannel; ++ichannel) {
+		wv = CPT_BENCH_CNTRWV[ichannel];
+		for (uint16_t i = 0; i < nlayer*3; ++i)
+			obs[i] = 0.1+0.2*benchrand();
+		for (uint16_t i = 0; i < nlayer*4; ++i)
+			ang[i] = 10*(i/nlayer) + 0.5*(i%nlayer) + 0.01*benchrand();
+		fwrite(&wv, 2, 1, fp);
+		fwrite(obs, 8, nlayer*((wv < 0) ? 3 : 1), fp);
+		fwrite(ang, 8, nlayer*4, fp);
+	}
+	extra = 1+(int) (16*benchrand());
+	fwrite(&nextra, 1, 1, fp);
+	fwrite(&extra, 8, 1, fp);
+}
+
+/*
+ *  Written in 0.1 layout, which legacyreadall understands, with 1 to 6
+ *  Points per Pt, or in current layout with offset table if ntfix is
+ *  given, every Pt then has ntfix Points which may go beyond 255.
+ */
+static int benchgen(const char *fname, uint64_t nptx, uint16_t ntfix)
+{
+	char     name[16];
+	float    lon, lat;
+	int16_t  alt;
+	uint16_t nt;
+	uint8_t  nparam = CPT_BENCH_NPARAM, nvicinity = CPT_BENCH_NVICI, flags = 0;
+	uint8_t  ver = ntfix ? CPT_VERSION : CPT_VERSION01;
+	uint64_t sec, t0 = 1654041600, *offs = NULL;
+	double   params[CPT_BENCH_NPARAM];
+	FILE    *fp;
+	struct cpt_trailer trailer;
+	
+	if ((ver == CPT_VERSION01) && (nptx > UINT32_MAX))
+		return CPT_EFORMAT;
+	if (ntfix && !(offs = malloc(sizeof(uint64_t[nptx+1]))))
+		return CPT_EMEM;
+	if (!(fp = fopen(fname, "wb"))) {
+		CPT_ERROPEN(fname);
+		free(offs);
+		return CPT_EOPEN;
+	}
+	setvbuf(fp, NULL, _IOFBF, CPT_BUFSIZE);
+	
+	fwrite(CPT_MAGIC, 1, CPT_MAGICLEN, fp);
+	fwrite(&ver, 1, 1, fp);
+	fwrite(&nptx, CPT_NPTXLENOF(ver), 1, fp);
+	fwrite(&nparam, 1, 1, fp);
+	if (ntfix)
+		fwrite(&flags, 1, 1, fp);
+	
+	for (uint64_t iptx = 0; iptx < nptx; ++iptx) {
+		uint32_t isite = benchrand()*CPT_BENCH_NSITE;
+		
+		if (offs)
+			offs[iptx] = ftello(fp);
+		
+		/*  Pt  */
+		snprintf(name, sizeof(name), "Site_%03u", isite);
+		lon = -180+360.f*isite/CPT_BENCH_NSITE;
+		lat = -60+120.f*((isite*37)%CPT_BENCH_NSITE)/CPT_BENCH_NSITE;
+		alt = isite;
+		nt  = ntfix ? ntfix : 1+6*benchrand();
+		sec = t0 + (uint64_t) iptx*600;
+		fwrite(name, 1, strlen(name)+1, fp);
+		fwrite(&lon, 4, 1, fp);
+		fwrite(&lat, 4, 1, fp);
+		fwrite(&alt, 2, 1, fp);
+		fwrite(&nt, CPT_NTLENOF(ver), 1, fp);
+		for (uint16_t ipoint = 0; ipoint < nt; ++ipoint) {
+			uint64_t psec = sec - 900 + 300*ipoint;
+			for (uint8_t iparam = 0; iparam < nparam; ++iparam)
+				params[iparam] = benchrand();
+			fwrite(&psec, 8, 1, fp);
+			fwrite(params, 8, nparam, fp);
+		}
+		
+		/*  Px  */
+		fwrite(&sec, 8, 1, fp);
+		genpixel(fp, lon, lat);
+		fwrite(&nvicinity, 1, 1, fp);
+		for (uint8_t ivicinity = 0; ivicinity < nvicinity; ++ivicinity)
+			genpixel(fp, lon+0.01f*(ivicinity%3), lat+0.01f*(ivicinity/3));
+	}
+	
+	if (offs) {
+		trailer.table  = ftello(fp);
+		trailer.ntable = nptx;
+		memcpy(trailer.magic, CPT_TRAILERMAGIC, sizeof(trailer.magic));
+		fwrite(offs, sizeof(uint64_t), nptx, fp);
+		fwrite(&trailer, CPT_TRAILERLEN, 1, fp);
+		free(offs);
+	}
+	fwrite(CPT_ENDING, 1, CPT_ENDINGLEN, fp);
+	
+	return fclose(fp) ? CPT_EOPEN : 0;
+}
+
+/*
+ *  Decoder as it was before buffering, one read(2) per field,
+ *  kept here only as the baseline of comparison.
+ */
+static void legacypixel(int fd, struct cpt_pixel *pixel)
+{
+	read(fd, &pixel->lon, 4);
+	read(fd, &pixel->lat, 4);
+	read(fd, &pixel->alt, 2);
+	read(fd, &pixel->mask, 1);
+	read(fd, &pixel->nchannel, 1);
+	read(fd, &pixel->nlayer, 1);
+	pixel->channels = malloc(sizeof(struct cpt_channel[pixel->nchannel]));
+	for (uint8_t ichannel = 0; ichannel < pixel->nchannel; ++ichannel) {
+		struct cpt_channel *pchannel = pixel->channels+ichannel;
+		size_t obssize;
+		read(fd, &pchannel->centrewv, 2);
+		obssize = sizeof(double[pixel->nlayer][(pchannel->centrewv < 0) ? 3 : 1]);
+		pchannel->obs = malloc(obssize);
+		read(fd, pchannel->obs, obssize);
+		pchannel->ang = malloc(sizeof(double[pixel->nlayer][4]));
+		read(fd, pchannel->ang, sizeof(double[pixel->nlayer][4]));
+	}
+	read(fd, &pixel->nextra, 1);
+	pixel->extra = malloc(sizeof(double[pixel->nextra]));
+	for (uint8_t iextra = 0; iextra < pixel->nextra; ++iextra)
+		read(fd, pixel->extra+iextra, 8);
+}
+
+static int legacyreadall(const char *fname, struct cpt_ptx *ptx, uint64_t *nptx, uint8_t *nparam)
+{
+	int  fd;
+	char namec;
+	uint8_t mgc[CPT_MAGICLEN+1], namelen, ending[CPT_ENDINGLEN];
+	
+	*nptx = 0;
+	ptx->pt = NULL;
+	ptx->px = NULL;
+	ptx->arena = NULL;
+	if ((fd = open(fname, O_RDONLY)) < 0)
+		return CPT_EOPEN;
+	read(fd, mgc, CPT_MAGICLEN+1);
+	read(fd, nptx, 4);
+	read(fd, nparam, 1);
+	ptx->pt = malloc(sizeof(struct cpt_pt[*nptx]));
+	ptx->px = malloc(sizeof(struct cpt_px[*nptx]));
+	for (uint64_t iptx = 0; iptx < *nptx; ++iptx) {
+		struct cpt_pt *ppt = ptx->pt+iptx;
+		struct cpt_px *ppx = ptx->px+iptx;
+		
+		ppt->name = NULL;
+		namelen = 0;
+		while (read(fd, &namec, 1) && (namec != '\0') && (++namelen)) {
+			ppt->name = realloc(ppt->name, namelen+1);
+			ppt->name[namelen-1] = namec;
+			ppt->name[namelen] = '\0';
+		}
+		read(fd, &ppt->lon, 4);
+		read(fd, &ppt->lat, 4);
+		read(fd, &ppt->alt, 2);
+		ppt->nt = 0;
+		read(fd, &ppt->nt, 1);
+		ppt->points = malloc(sizeof(struct cpt_point[ppt->nt]));
+		for (uint16_t ipoint = 0; ipoint < ppt->nt; ++ipoint) {
+			read(fd, &ppt->points[ipoint].seconds, 8);
+			ppt->points[ipoint].params = malloc(sizeof(double[*nparam]));
+			read(fd, ppt->points[ipoint].params, sizeof(double[*nparam]));
+		}
+		read(fd, &ppx->seconds, 8);
+		ppx->centrepixel = malloc(CPT_PIXELSIZE);
+		legacypixel(fd, ppx->centrepixel);
+		read(fd, &ppx->nvicinity, 1);
+		ppx->vicinity = malloc(sizeof(struct cpt_pixel[ppx->nvicinity]));
+		for (uint8_t ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity)
+			legacypixel(fd, ppx->vicinity+ivicinity);
+	}
+	read(fd, ending, CPT_ENDINGLEN);
+	close(fd);
+	
+	return 0;
+}
+
+#define CPT_BENCH_NREAD 3
+
+static int benchread(const char *fname, int repeat)
+{
+	int      fd, ret;
+	off_t    fsize;
+	double   t0, dt[CPT_BENCH_NREAD] = {0}, dtfree[CPT_BENCH_NREAD] = {0};
+	uint8_t  nparam;
+	uint32_t nptx32;
+	uint64_t nptx;
+	uint64_t syscr, nsys[CPT_BENCH_NREAD] = {0};
+	struct cpt_ptx ptx;
+	struct cpt_readopt opt = {.arena = 1};
+	const char *label[CPT_BENCH_NREAD] = {"per-field read(2)", "buffered", "buffered+arena"};
+	
+	if ((fd = open(fname, O_RDONLY)) < 0) {
+		CPT_ERROPEN(fname);
+		return CPT_EOPEN;
+	}
+	fsize = lseek(fd, 0, SEEK_END);
+	close(fd);
+	
+	for (int irepeat = 0; irepeat < repeat; ++irepeat) {
+		for (int imode = 0; imode < CPT_BENCH_NREAD; ++imode) {
+			syscr = benchsysc("syscr");
+			t0 = benchnow();
+			switch (imode) {
+			case 0: ret = legacyreadall(fname, &ptx, &nptx, &nparam); break;
+			case 1: ret = cpt_readall(fname, &ptx, &nptx32, &nparam); nptx = nptx32; break;
+			default: ret = cpt_readallopt(fname, &ptx, &nptx, &nparam, &opt);
+			}
+			if (ret) {
+				cpt_release(&ptx, nptx);
+				return ret;
+			}
+			dt[imode] += benchnow()-t0;
+			nsys[imode] += benchsysc("syscr")-syscr;
+			
+			t0 = benchnow();
+			cpt_release(&ptx, nptx);
+			dtfree[imode] += benchnow()-t0;
+		}
+	}
+	
+	printf("%s: %lu Ptx, %.1f MB\n", fname, (unsigned long) nptx, fsize/1e6);
+	for (int imode = 0; imode < CPT_BENCH_NREAD; ++imode) {
+		printf("%-18s %12lu read(2) %9.3f s %9.1f MB/s, free %9.4f s\n", label[imode],
+		       nsys[imode]/repeat, dt[imode]/repeat, fsize*repeat/1e6/dt[imode],
+		       dtfree[imode]/repeat);
+	}
+	
+	return 0;
+}
+
+/*
+ *  Mean of first layer I of centre Pixel's first Channel,
+ *  a job touching a few fields, with full decode against mapped view.
+ */
+static int benchview(const char *fname)
+{
+	double   t0, sum;
+	uint8_t  nparam;
+	uint32_t nptx;
+	struct cpt_ptx ptx;
+	struct cpt_view view;
+	struct cpt_vptx vptx;
+	struct cpt_vpixel vpixel;
+	struct cpt_vchannel vchannel;
+	const uint8_t *cur;
+	
+	t0 = benchnow();
+	if (cpt_readall(fname, &ptx, &nptx, &nparam)) {
+		cpt_release(&ptx, nptx);
+		return CPT_EFORMAT;
+	}
+	sum = 0;
+	for (uint64_t iptx = 0; iptx < nptx; ++iptx)
+		sum += ptx.px[iptx].centrepixel->channels->obs[0];
+	cpt_release(&ptx, nptx);
+	printf("%-18s mean %.6f %9.3f s\n", "cpt_readall", sum/nptx, benchnow()-t0);
+	
+	t0 = benchnow();
+	if (cpt_viewopen(fname, &view))
+		return CPT_EFORMAT;
+	sum = 0;
+	cur = view.data;
+	for (uint64_t iptx = 0; iptx < view.nptx; ++iptx, cur = vptx.next) {
+		if (cpt_viewnext(&view, cur, &vptx))
+			return CPT_ETRUNC;
+		cpt_viewpixel(&view, vptx.px.centrepixel, &vpixel);
+		cpt_viewchannel(&vpixel, 0, &vchannel);
+		sum += cpt_viewdouble(vchannel.obs, 0);
+	}
+	cpt_viewclose(&view);
+	printf("%-18s mean %.6f %9.3f s\n", "cpt_view", sum/nptx, benchnow()-t0);
+	
+	return 0;
+}
+
+/*  Peak RSS in MB of running fn(fname) in a child process  */
+static double benchrss(int (*fn)(const char *), const char *fname)
+{
+	int status;
+	pid_t pid;
+	struct rusage ru;
+	
+	if (!(pid = fork()))
+		_exit(fn(fname));
+	if ((pid < 0) || (wait4(pid, &status, 0, &ru) < 0) || status)
+		return -1;
+	
+	return ru.ru_maxrss/1024.;
+}
+
+static int streamall(const char *fname)
+{
+	uint8_t  nparam;
+	uint64_t nptx;
+	struct cpt_ptx ptx;
+	struct cpt_readopt opt = {.arena = 1};
+	
+	return cpt_readallopt(fname, &ptx, &nptx, &nparam, &opt);
+}
+
+static int streamnext(const char *fname)
+{
+	int ret;
+	struct cpt_ptx   ptx;
+	struct cpt_file  file;
+	struct cpt_arena arena;
+	
+	if ((ret = cpt_open(fname, &file)))
+		return ret;
+	cpt_arenainit(&arena, 0);
+	while (!(ret = cpt_next_ptx(&file, &ptx, &arena))) ;
+	cpt_arenafree(&arena);
+	cpt_close(&file);
+	
+	return (CPT_EEND == ret) ? 0 : ret;
+}
+
+/*
+ *  Peak memory of whole-file decode against streaming
+ */
+static int benchstream(int nfile, char *fnames[])
+{
+	int fd;
+	off_t fsize;
+	
+	printf("%12s %16s %16s\n", "file MB", "readall RSS MB", "stream RSS MB");
+	for (int ifile = 0; ifile < nfile; ++ifile) {
+		if ((fd = open(fnames[ifile], O_RDONLY)) < 0) {
+			CPT_ERROPEN(fnames[ifile]);
+			return CPT_EOPEN;
+		}
+		fsize = lseek(fd, 0, SEEK_END);
+		close(fd);
+		printf("%12.1f %16.1f %16.1f\n", fsize/1e6,
+		       benchrss(streamall, fnames[ifile]), benchrss(streamnext, fnames[ifile]));
+	}
+	
+	return 0;
+}
+
+/*
+ *  Random access of nread Ptx through footer or sidecar index against
+ *  scanning, run "cpttrans -to 0.3" or "cptidx" on input first
+ */
+static int benchseek(const char *fname, uint32_t nread)
+{
+	int ret;
+	double t;
+	uint64_t *order;
+	struct cpt_ptx   ptx;
+	struct cpt_file  file;
+	struct cpt_arena arena;
+	
+	if ((ret = cpt_open(fname, &file)))
+		return ret;
+	if (!(order = malloc(sizeof(uint64_t[nread])))) {
+		cpt_close(&file);
+		return CPT_EMEM;
+	}
+	for (uint32_t i = 0; i < nread; ++i)
+		order[i] = benchrand()*file.nptx;
+	cpt_arenainit(&arena, 0);
+	
+	printf("%-10s %12s %12s\n", "mode", "read(2)", "ms/Ptx");
+	for (int mode = 0; mode < 2; ++mode) {
+		/*  Pretend there is no index to force a scan  */
+		file.noidx = !mode;
+		file.buf.nsyscall = 0;
+		t = benchnow();
+		for (uint32_t i = 0; i < nread; ++i) {
+			if ((ret = cpt_read_ptx(&file, order[i], &ptx, &arena)))
+				break;
+		}
+		t = benchnow()-t;
+		if (ret)
+			break;
+		printf("%-10s %12lu %12.3f\n", mode ? "index" : "scan",
+		       (unsigned long) file.buf.nsyscall, t*1e3/nread);
+	}
+	if (!ret && !file.offs)
+		CPT_ERRECHOWITHTIME("%s has NO valid index, both modes scanned", fname);
+	
+	cpt_arenafree(&arena);
+	cpt_close(&file);
+	free(order);
+	
+	return ret;
+}
+
+/*
+ *  Scaling of parallel decode into arena, thread count doubled up to maxthread
+ */
+static int benchpar(const char *fname, int maxthread)
+{
+	int    fd, ret;
+	off_t  fsize;
+	double t0, dt, dt1 = 0;
+	uint8_t  nparam;
+	uint64_t nptx;
+	struct cpt_ptx ptx;
+	struct cpt_readopt opt = {.arena = 1};
+	
+	if ((fd = open(fname, O_RDONLY)) < 0) {
+		CPT_ERROPEN(fname);
+		return CPT_EOPEN;
+	}
+	fsize = lseek(fd, 0, SEEK_END);
+	close(fd);
+	
+	printf("%s: %.1f MB, %ld CPUs online\n", fname, fsize/1e6, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("%8s %9s %9s %8s\n", "threads", "s", "MB/s", "speedup");
+	for (int nthread = 1; nthread <= maxthread; nthread <<= 1) {
+		opt.nthread = nthread;
+		t0 = benchnow();
+		ret = cpt_readallopt(fname, &ptx, &nptx, &nparam, &opt);
+		dt = benchnow()-t0;
+		cpt_release(&ptx, nptx);
+		if (ret)
+			return ret;
+		if (1 == nthread)
+			dt1 = dt;
+		printf("%8d %9.3f %9.1f %8.2f\n", nthread, dt, fsize/1e6/dt, dt1/dt);
+	}
+	
+	return 0;
+}
+
+/*  CRC32C over a few fields of every Ptx, to tell decoded trees apart  */
+static uint32_t treecrc(const struct cpt_ptx *ptx, uint64_t nptx)
+{
+	uint32_t crc = 0;
+	
+	for (uint64_t iptx = 0; iptx < nptx; ++iptx) {
+		crc = cpt_crc32c(crc, &ptx->pt[iptx].lon, sizeof(float));
+		crc = cpt_crc32c(crc, &ptx->pt[iptx].lat, sizeof(float));
+		crc = cpt_crc32c(crc, &ptx->pt[iptx].nt, sizeof(uint16_t));
+		crc = cpt_crc32c(crc, &ptx->px[iptx].seconds, sizeof(uint64_t));
+		crc = cpt_crc32c(crc, &ptx->px[iptx].centrepixel->lon, sizeof(float));
+	}
+	
+	return crc;
+}
+
+/*
+ *  Copy of fname with entry No.i of its offset table set to off, i of
+ *  -1 picks the middle entry, off of -1 a value past end of file and
+ *  off of 0 the offset of first Ptx, which puts the table out of order
+ */
+static int corruptcopy(const char *fname, const char *cname, uint64_t i, uint64_t off)
+{
+	int      fd, ret = 0;
+	uint8_t *data;
+	off_t    fsize;
+	struct cpt_file    file;
+	struct cpt_trailer trailer;
+	
+	if ((ret = cpt_open(fname, &file)))
+		return ret;
+	fsize = file.fsize;
+	if ((CPT_VERSION01 == file.ver) || (file.nptx < 2)) {
+		CPT_ERRECHOWITHTIME("%s has no offset table to corrupt", fname);
+		cpt_close(&file);
+		return CPT_EFORMAT;
+	}
+	if (!(data = malloc(fsize))) {
+		cpt_close(&file);
+		return CPT_EMEM;
+	}
+	if (pread(file.buf.fd, data, fsize, 0) != fsize) {
+		ret = CPT_ETRUNC;
+	} else {
+		memcpy(&trailer, data+fsize-CPT_ENDINGLEN-CPT_TRAILERLEN, CPT_TRAILERLEN);
+		i   = (UINT64_MAX == i) ? file.nptx/2 : i;
+		off = (UINT64_MAX == off) ? (uint64_t) fsize+12345 : off;
+		if (!off)
+			memcpy(&off, data+trailer.table, sizeof(uint64_t));
+		memcpy(data+trailer.table+sizeof(uint64_t[i]), &off, sizeof(uint64_t));
+		if (((fd = open(cname, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR)) < 0)
+		    || (write(fd, data, fsize) != fsize) || close(fd))
+			ret = CPT_EOPEN;
+	}
+	free(data);
+	cpt_close(&file);
+	
+	return ret;
+}
+
+/*
+ *  Broken footer, an entry of offset table past end of file or out of
+ *  order, is to be left out alike by serial and parallel decode, which
+ *  then both agree with what is decoded of the sound file
+ */
+static int benchcorrupt(const char *fname, const char *cname)
+{
+	int      ret;
+	uint8_t  nparam;
+	uint64_t nptx, nptx0, bad[2][2] = {{UINT64_MAX, UINT64_MAX}, {UINT64_MAX, 0}};
+	uint32_t crc0, crc;
+	struct cpt_ptx ptx;
+	struct cpt_readopt opt = {.arena = 1};
+	
+	if ((ret = cpt_readallopt(fname, &ptx, &nptx, &nparam, &opt))) {
+		cpt_release(&ptx, nptx);
+		return ret;
+	}
+	crc0 = treecrc(&ptx, nptx);
+	nptx0 = nptx;
+	cpt_release(&ptx, nptx);
+	
+	for (int ibad = 0; ibad < 2; ++ibad) {
+		if ((ret = corruptcopy(fname, cname, bad[ibad][0], bad[ibad][1])))
+			return ret;
+		for (opt.nthread = 1; opt.nthread <= 4; opt.nthread <<= 1) {
+			ret = cpt_readallopt(cname, &ptx, &nptx, &nparam, &opt);
+			if (ret) {
+				cpt_release(&ptx, nptx);
+				CPT_ERRECHOWITHTIME("%s can NOT be decoded by %d thread", cname, opt.nthread);
+				return ret;
+			}
+			crc = treecrc(&ptx, nptx);
+			cpt_release(&ptx, nptx);
+			printf("offset %s, %d thread: %lu Ptx, crc %08x\n", ibad ? "out of order" : "past end",
+			       opt.nthread, (unsigned long) nptx, crc);
+			if ((nptx != nptx0) || (crc != crc0)) {
+				CPT_ERRECHOWITHTIME("%s decodes unlike %s", cname, fname);
+				return CPT_EFORMAT;
+			}
+		}
+	}
+	
+	return 0;
+}
+
+/*
+ *  Projection, bytes materialized and time of decode into arena
+ */
+static int benchproj(const char *fname)
+{
+	int    ret;
+	size_t used;
+	double t0, dt;
+	uint8_t  nparam;
+	uint64_t nptx;
+	struct cpt_ptx ptx;
+	struct cpt_readopt opt = {.arena = 1};
+	const uint8_t skip[] = {0, CPT_SKIPQU, CPT_SKIPQU|CPT_SKIPANG,
+	                        CPT_SKIPQU|CPT_SKIPANG|CPT_SKIPVICI|CPT_SKIPEXTRA};
+	const char *label[] = {"all", "-QU", "-QU-ang", "-QU-ang-vici-extra"};
+	
+	printf("%-20s %12s %9s\n", "projection", "decoded MB", "s");
+	for (size_t i = 0; i < sizeof(skip); ++i) {
+		opt.skip = skip[i];
+		t0 = benchnow();
+		if ((ret = cpt_readallopt(fname, &ptx, &nptx, &nparam, &opt))) {
+			cpt_release(&ptx, nptx);
+			return ret;
+		}
+		dt = benchnow()-t0;
+		used = 0;
+		for (struct cpt_arenachunk *chunk = ptx.arena->head; chunk; chunk = chunk->next)
+			used += chunk->used;
+		cpt_release(&ptx, nptx);
+		printf("%-20s %12.1f %9.3f\n", label[i], used/1e6, dt);
+	}
+	
+	return 0;
+}
+
+/*
+ *  Regional study, decode all then select against predicate pushdown
+ */
+static int benchfilter(const char *fname, const struct cpt_filter *filter)
+{
+	int    ret;
+	double t0, dt;
+	uint8_t  nparam;
+	uint64_t nptx, nkept;
+	struct cpt_ptx ptx;
+	struct cpt_pt *pt;
+	struct cpt_readopt opt = {.arena = 1};
+	
+	t0 = benchnow();
+	if ((ret = cpt_readallopt(fname, &ptx, &nptx, &nparam, &opt))) {
+		cpt_release(&ptx, nptx);
+		return ret;
+	}
+	nkept = 0;
+	for (uint64_t iptx = 0; iptx < nptx; ++iptx) {
+		pt = ptx.pt+iptx;
+		nkept += (pt->lon >= filter->lonmin) && (pt->lon <= filter->lonmax)
+		         && (pt->lat >= filter->latmin) && (pt->lat <= filter->latmax);
+	}
+	cpt_release(&ptx, nptx);
+	dt = benchnow()-t0;
+	printf("%-18s %8lu of %8lu Ptx %9.3f s\n", "decode+select",
+	       (unsigned long) nkept, (unsigned long) nptx, dt);
+	
+	opt.filter = filter;
+	t0 = benchnow();
+	ret = cpt_readallopt(fname, &ptx, &nkept, &nparam, &opt);
+	cpt_release(&ptx, nkept);
+	if (ret)
+		return ret;
+	dt = benchnow()-t0;
+	printf("%-18s %8lu of %8lu Ptx %9.3f s\n", "pushdown",
+	       (unsigned long) nkept, (unsigned long) nptx, dt);
+	
+	return 0;
+}
+
+/*
+ *  Summary against raw sequential read(2) of the same file
+ */
+static int benchstat(const char *fname)
+{
+	int     fd, ret;
+	ssize_t len;
+	size_t  total = 0;
+	double  t0, dt;
+	uint8_t *data;
+	struct cpt_stat stat;
+	
+	if ((fd = open(fname, O_RDONLY)) < 0) {
+		CPT_ERROPEN(fname);
+		return CPT_EOPEN;
+	}
+	if (!(data = malloc(CPT_BUFSIZE))) {
+		close(fd);
+		return CPT_EMEM;
+	}
+	t0 = benchnow();
+	while ((len = read(fd, data, CPT_BUFSIZE)) > 0)
+		total += len;
+	dt = benchnow()-t0;
+	close(fd);
+	free(data);
+	printf("%-18s %9.3f s %9.1f MB/s\n", "raw read(2)", dt, total/1e6/dt);
+	
+	t0 = benchnow();
+	if ((ret = cpt_stat(fname, &stat)))
+		return ret;
+	dt = benchnow()-t0;
+	printf("%-18s %9.3f s %9.1f MB/s\n", "cpt_stat", dt, stat.fsize/1e6/dt);
+	
+	return 0;
+}
+
+/*
+ *  Compression ratio of a chunked copy made by "cpttrans -to 0.3 -z",
+ *  and decode speed of both, MB/s are of Data as inflated
+ */
+static int benchzip(const char *fname, const char *zname, int nthread)
+{
+	int    ret;
+	off_t  fsize[2];
+	double t0, dt;
+	uint8_t  nparam;
+	uint64_t nptx;
+	struct cpt_ptx ptx;
+	struct cpt_readopt opt = {.arena = 1};
+	const char *fnames[2] = {fname, zname};
+	
+	for (int i = 0; i < 2; ++i) {
+		int fd;
+		if ((fd = open(fnames[i], O_RDONLY)) < 0) {
+			CPT_ERROPEN(fnames[i]);
+			return CPT_EOPEN;
+		}
+		fsize[i] = lseek(fd, 0, SEEK_END);
+		close(fd);
+	}
+	printf("%s: %.1f MB, %s: %.1f MB, ratio %.2f\n", fname, fsize[0]/1e6,
+	       zname, fsize[1]/1e6, (double) fsize[0]/fsize[1]);
+	
+	printf("%-10s %8s %9s %9s\n", "layout", "threads", "s", "MB/s");
+	for (int i = 0; i < 2; ++i) {
+		for (opt.nthread = 1; opt.nthread <= nthread; opt.nthread <<= 1) {
+			t0 = benchnow();
+			ret = cpt_readallopt(fnames[i], &ptx, &nptx, &nparam, &opt);
+			dt = benchnow()-t0;
+			cpt_release(&ptx, nptx);
+			if (ret)
+				return ret;
+			printf("%-10s %8d %9.3f %9.1f\n", i ? "chunked" : "plain", opt.nthread,
+			       dt, fsize[0]/1e6/dt);
+		}
+	}
+	
+	return 0;
+}
+
+/*
+ *  Mean I of centre Pixels at wv where sza < 60, by decoding Ptx of input
+ *  and by column spans of a copy made by "cpttrans -to 0.3 -c"
+ */
+static int benchcol(const char *fname, const char *cname, int16_t wv)
+{
+	int      ret;
+	double   t0, dt, sum;
+	uint32_t n, nsza;
+	uint64_t cnt;
+	struct cpt_file  file;
+	struct cpt_ptx   ptx;
+	struct cpt_arena arena;
+	struct cpt_block block;
+	struct cpt_channel *pchannel;
+	const double *obs, *sza;
+	
+	if ((ret = cpt_open(fname, &file)))
+		return ret;
+	cpt_arenainit(&arena, 0);
+	file.skip = CPT_SKIPQU|CPT_SKIPVICI|CPT_SKIPEXTRA;
+	sum = cnt = 0;
+	t0  = benchnow();
+	while (!(ret = cpt_next_ptx(&file, &ptx, &arena))) {
+		for (uint8_t ichannel = 0; ichannel < ptx.px->centrepixel->nchannel; ++ichannel) {
+			pchannel = ptx.px->centrepixel->channels+ichannel;
+			if (pchannel->centrewv != wv)
+				continue;
+			for (uint8_t ilayer = 0; ilayer < ptx.px->centrepixel->nlayer; ++ilayer) {
+				if (pchannel->ang[ilayer] < 60) {
+					sum += pchannel->obs[ilayer];
+					++cnt;
+				}
+			}
+		}
+	}
+	dt = benchnow()-t0;
+	printf("%-10s %9.3f s %12llu %.17g\n", "rows", dt, (unsigned long long) cnt, cnt ? sum/cnt : 0);
+	cpt_arenafree(&arena);
+	cpt_close(&file);
+	if (CPT_EEND != ret)
+		return ret;
+	
+	if ((ret = cpt_open(cname, &file)))
+		return ret;
+	if (!(file.flags & CPT_FCOLUMN) || (file.flags & CPT_FSCALED)) {
+		CPT_ERRECHOWITHTIME("%s is NOT columnar with doubles", cname);
+		cpt_close(&file);
+		return CPT_EFORMAT;
+	}
+	sum = cnt = 0;
+	t0  = benchnow();
+	while (!(ret = cpt_next_block(&file, &block))) {
+		obs = cpt_blockcol(&block, CPT_COLI, wv, &n);
+		sza = cpt_blockcol(&block, CPT_COLSZA, wv, &nsza);
+		if (n != nsza) {
+			ret = CPT_EFORMAT;
+			break;
+		}
+		for (uint32_t i = 0; i < n; ++i) {
+			if (sza[i] < 60) {
+				sum += obs[i];
+				++cnt;
+			}
+		}
+	}
+	dt = benchnow()-t0;
+	printf("%-10s %9.3f s %12llu %.17g\n", "columns", dt, (unsigned long long) cnt, cnt ? sum/cnt : 0);
+	cpt_close(&file);
+	
+	return (CPT_EEND == ret) ? 0 : ret;
+}
+
+/*
+ *  Writer as it was before buffering, one write(2) per field,
+ *  kept here only as the baseline of comparison.
+ */
+static uint64_t legacyoff;
+static void legacyput(int fd, const void *src, size_t n)
+{
+	write(fd, src, n);
+	legacyoff += n;
+}
+
+static void legacyputpixel(int fd, const struct cpt_pixel *pixel)
+{
+	legacyput(fd, &pixel->lon, 4);
+	legacyput(fd, &pixel->lat, 4);
+	legacyput(fd, &pixel->alt, 2);
+	legacyput(fd, &pixel->mask, 1);
+	legacyput(fd, &pixel->nchannel, 1);
+	legacyput(fd, &pixel->nlayer, 1);
+	for (uint8_t ichannel = 0; ichannel < pixel->nchannel; ++ichannel) {
+		const struct cpt_channel *pchannel = pixel->channels+ichannel;
+		legacyput(fd, &pchannel->centrewv, 2);
+		legacyput(fd, pchannel->obs,
+		          sizeof(double[pixel->nlayer][(pchannel->centrewv < 0) ? 3 : 1]));
+		legacyput(fd, pchannel->ang, sizeof(double[pixel->nlayer][4]));
+	}
+	legacyput(fd, &pixel->nextra, 1);
+	legacyput(fd, pixel->extra, sizeof(double[pixel->nextra]));
+}
+
+static int legacywriteall(const char *fname, const struct cpt_ptx *ptx, uint64_t nptx,
+                          uint8_t nparam)
+{
+	int      fd;
+	uint8_t  ver = CPT_VERSION, flags = 0;
+	uint64_t *offs;
+	struct cpt_trailer trailer;
+	
+	if (!(offs = malloc(sizeof(uint64_t[nptx+1]))))
+		return CPT_EMEM;
+	if ((fd = open(fname, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR)) < 0) {
+		CPT_ERROPEN(fname);
+		free(offs);
+		return CPT_EOPEN;
+	}
+	legacyoff = 0;
+	legacyput(fd, CPT_MAGIC, CPT_MAGICLEN);
+	legacyput(fd, &ver, 1);
+	legacyput(fd, &nptx, CPT_NPTXLENOF(ver));
+	legacyput(fd, &nparam, 1);
+	legacyput(fd, &flags, 1);
+	for (uint64_t iptx = 0; iptx < nptx; ++iptx) {
+		const struct cpt_pt *ppt = ptx->pt+iptx;
+		const struct cpt_px *ppx = ptx->px+iptx;
+		
+		offs[iptx] = legacyoff;
+		legacyput(fd, ppt->name ? ppt->name : "", ppt->name ? strlen(ppt->name)+1 : 1);
+		legacyput(fd, &ppt->lon, 4);
+		legacyput(fd, &ppt->lat, 4);
+		legacyput(fd, &ppt->alt, 2);
+		legacyput(fd, &ppt->nt, CPT_NTLENOF(ver));
+		for (uint16_t ipoint = 0; ipoint < ppt->nt; ++ipoint) {
+			legacyput(fd, &ppt->points[ipoint].seconds, 8);
+			legacyput(fd, ppt->points[ipoint].params, sizeof(double[nparam]));
+		}
+		legacyput(fd, &ppx->seconds, 8);
+		legacyputpixel(fd, ppx->centrepixel);
+		legacyput(fd, &ppx->nvicinity, 1);
+		for (uint8_t ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity)
+			legacyputpixel(fd, ppx->vicinity+ivicinity);
+	}
+	trailer.table  = legacyoff;
+	trailer.ntable = nptx;
+	memcpy(trailer.magic, CPT_TRAILERMAGIC, sizeof(trailer.magic));
+	legacyput(fd, offs, sizeof(uint64_t[nptx]));
+	legacyput(fd, &trailer, CPT_TRAILERLEN);
+	legacyput(fd, CPT_ENDING, CPT_ENDINGLEN);
+	free(offs);
+	
+	return close(fd) ? CPT_EOPEN : 0;
+}
+
+/*  Decoded tree through the streaming writer, Ptx by Ptx or by nthread threads  */
+static int writerall(const char *fname, const struct cpt_ptx *ptx, uint64_t nptx,
+                     uint8_t nparam, uint8_t opts, uint8_t nthread)
+{
+	int ret;
+	struct cpt_writer wr;
+	
+	if ((ret = cpt_writer_open(&wr, fname, CPT_VERSION, nparam, 0, NULL, 0, opts)))
+		return ret;
+	if (nthread > 1)
+		ret = cpt_writer_append_all(&wr, ptx, nptx, nthread);
+	for (uint64_t iptx = 0; (nthread <= 1) && (iptx < nptx) && !ret; ++iptx)
+		ret = cpt_writer_append_ptx(&wr, &(struct cpt_ptx) {ptx->pt+iptx, ptx->px+iptx, NULL});
+	
+	return cpt_writer_close(&wr) ? CPT_EWRITE : ret;
+}
+
+/*  Output of benchrss children  */
+static const char *benchoname;
+
+static int copyall(const char *fname)
+{
+	int ret;
+	uint8_t  nparam;
+	uint64_t nptx;
+	struct cpt_ptx ptx;
+	struct cpt_readopt opt = {.arena = 1};
+	
+	if ((ret = cpt_readallopt(fname, &ptx, &nptx, &nparam, &opt))) {
+		cpt_release(&ptx, nptx);
+		return ret;
+	}
+	ret = writerall(benchoname, &ptx, nptx, nparam, 0, 1);
+	cpt_release(&ptx, nptx);
+	
+	return ret;
+}
+
+static int copynext(const char *fname)
+{
+	int ret;
+	struct cpt_ptx    ptx;
+	struct cpt_file   file;
+	struct cpt_arena  arena;
+	struct cpt_writer wr;
+	
+	if ((ret = cpt_open(fname, &file)))
+		return ret;
+	if ((ret = cpt_writer_open(&wr, benchoname, CPT_VERSION, file.nparam, 0, NULL,
+	                           file.fsize, 0))) {
+		cpt_close(&file);
+		return ret;
+	}
+	cpt_arenainit(&arena, 0);
+	while (!(ret = cpt_next_ptx(&file, &ptx, &arena)))
+		if ((ret = cpt_writer_append_ptx(&wr, &ptx)))
+			break;
+	cpt_arenafree(&arena);
+	cpt_close(&file);
+	if (cpt_writer_close(&wr))
+		return CPT_EWRITE;
+	
+	return (CPT_EEND == ret) ? 0 : ret;
+}
+
+/*  CRC32C of a whole file, to tell the writers agree byte for byte  */
+static uint32_t benchfilecrc(const char *fname)
+{
+	int      fd;
+	ssize_t  n;
+	uint8_t  buf[1<<16];
+	uint32_t crc = 0;
+	
+	if ((fd = open(fname, O_RDONLY)) < 0)
+		return 0;
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		crc = cpt_crc32c(crc, buf, n);
+	close(fd);
+	
+	return crc;
+}
+
+#define CPT_BENCH_NWRITE 4
+
+/*
+ *  Throughput of serialising a decoded tree per field against the
+ *  streaming writer, with CPT_WRSYNC and by nthread threads, and peak
+ *  memory of copying a file through the writer from a whole decoded
+ *  tree against Ptx by Ptx
+ */
+static int benchwrite(const char *fname, const char *oname, int repeat, int nthread)
+{
+	int      ret;
+	double   t0, dt[CPT_BENCH_NWRITE] = {0}, rss[2];
+	uint8_t  nparam;
+	uint64_t nptx, syscw, nsys[CPT_BENCH_NWRITE] = {0};
+	uint32_t crc[CPT_BENCH_NWRITE+1];
+	off_t    osize = 0;
+	struct stat st;
+	struct cpt_ptx ptx;
+	struct cpt_readopt opt = {.arena = 1};
+	char     parlabel[32];
+	const char *label[CPT_BENCH_NWRITE] = {"per-field write(2)", "cpt_writer", "cpt_writer sync",
+	                                       parlabel};
+	
+	if ((nthread < 1) || (nthread > UINT8_MAX))
+		nthread = (sysconf(_SC_NPROCESSORS_ONLN) < UINT8_MAX) ? sysconf(_SC_NPROCESSORS_ONLN) : UINT8_MAX;
+	snprintf(parlabel, sizeof(parlabel), "cpt_writer %d thr", nthread);
+	
+	if ((ret = cpt_readallopt(fname, &ptx, &nptx, &nparam, &opt))) {
+		cpt_release(&ptx, nptx);
+		return ret;
+	}
+	for (int irepeat = 0; irepeat < repeat; ++irepeat) {
+		for (int imode = 0; imode < CPT_BENCH_NWRITE; ++imode) {
+			syscw = benchsysc("syscw");
+			t0 = benchnow();
+			ret = imode ? writerall(oname, &ptx, nptx, nparam, (2 == imode) ? CPT_WRSYNC : 0,
+			                        (3 == imode) ? nthread : 1)
+			            : legacywriteall(oname, &ptx, nptx, nparam);
+			if (ret) {
+				cpt_release(&ptx, nptx);
+				return ret;
+			}
+			dt[imode] += benchnow()-t0;
+			nsys[imode] += benchsysc("syscw")-syscw;
+			crc[imode] = benchfilecrc(oname);
+		}
+	}
+	cpt_release(&ptx, nptx);
+	if (!stat(oname, &st))
+		osize = st.st_size;
+	
+	benchoname = oname;
+	rss[0] = benchrss(copyall, fname);
+	rss[1] = benchrss(copynext, fname);
+	crc[CPT_BENCH_NWRITE] = benchfilecrc(oname);
+	
+	printf("%s: %lu Ptx, %.1f MB written\n", oname, (unsigned long) nptx, osize/1e6);
+	for (int imode = 0; imode < CPT_BENCH_NWRITE; ++imode) {
+		printf("%-18s %12lu write(2) %9.3f s %9.1f MB/s, crc %08x\n", label[imode],
+		       nsys[imode]/repeat, dt[imode]/repeat, osize*repeat/1e6/dt[imode], crc[imode]);
+	}
+	printf("copy RSS MB, readall then write %.1f, Ptx by Ptx %.1f, crc %08x\n",
+	       rss[0], rss[1], crc[CPT_BENCH_NWRITE]);
+	if ((crc[0] != crc[1]) || (crc[0] != crc[2]) || (crc[0] != crc[3])
+	    || (crc[0] != crc[CPT_BENCH_NWRITE])) {
+		CPT_ERRECHOWITHTIME("%s differs between writers", oname);
+		return CPT_EFORMAT;
+	}
+	
+	return 0;
+}
+
+/*  Byte for byte copy of fname  */
+static int benchcopy(const char *fname, const char *cname)
+{
+	int     ifd, ofd, ret = 0;
+	ssize_t n;
+	uint8_t buf[1<<16];
+	
+	if ((ifd = open(fname, O_RDONLY)) < 0)
+		return CPT_EOPEN;
+	if ((ofd = open(cname, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR)) < 0) {
+		close(ifd);
+		return CPT_EOPEN;
+	}
+	while (!ret && ((n = read(ifd, buf, sizeof(buf))) > 0))
+		ret = (write(ofd, buf, n) != n) ? CPT_EOPEN : 0;
+	if ((n < 0) || close(ofd))
+		ret = CPT_EOPEN;
+	close(ifd);
+	
+	return ret;
+}
+
+/*
+ *  Checksummed file, as cpttrans makes it, appended its own Ptx once
+ *  more in place Ptx by Ptx and by 4 threads, is to pass cpt_verify
+ *  and decode to the Ptx of input twice over, alike by both. An append
+ *  aborted leaves the copy byte for byte as it was.
+ */
+static int benchappend(const char *fname, const char *cname)
+{
+	int      ret;
+	uint8_t  nparam;
+	uint64_t nptx, nptx0;
+	uint32_t crc0, crc[2], half[2];
+	struct cpt_ptx ptx, ptx2;
+	struct cpt_writer  wr;
+	struct cpt_readopt opt = {.arena = 1};
+	
+	if ((ret = cpt_readallopt(fname, &ptx, &nptx0, &nparam, &opt))) {
+		cpt_release(&ptx, nptx0);
+		return ret;
+	}
+	crc0 = treecrc(&ptx, nptx0);
+	
+	for (int ithread = 1; (ithread <= 4) && !ret; ithread <<= 2) {
+		if ((ret = benchcopy(fname, cname)) || (ret = cpt_writer_append(&wr, cname, NULL, 0)))
+			break;
+		ret = cpt_writer_append_all(&wr, &ptx, nptx0, ithread);
+		if ((ret = cpt_writer_close(&wr) ? CPT_EWRITE : ret) || (ret = cpt_verify(cname, 2)))
+			break;
+		crc[ithread > 1] = benchfilecrc(cname);
+		if ((ret = cpt_readallopt(cname, &ptx2, &nptx, &nparam, &opt))) {
+			cpt_release(&ptx2, nptx);
+			break;
+		}
+		half[0] = treecrc(&ptx2, nptx0);
+		half[1] = (nptx == 2*nptx0) ? treecrc(&(struct cpt_ptx) {ptx2.pt+nptx0, ptx2.px+nptx0, NULL},
+		                                      nptx0) : 0;
+		printf("append %d thread: %lu Ptx, crc %08x %08x, file crc %08x\n", ithread,
+		       (unsigned long) nptx, half[0], half[1], crc[ithread > 1]);
+		if ((nptx != 2*nptx0) || (half[0] != crc0) || (half[1] != crc0)) {
+			CPT_ERRECHOWITHTIME("%s decodes unlike %s twice over", cname, fname);
+			ret = CPT_EFORMAT;
+		}
+		cpt_release(&ptx2, nptx);
+	}
+	if (!ret && (crc[0] != crc[1])) {
+		CPT_ERRECHOWITHTIME("%s differs between appenders", cname);
+		ret = CPT_EFORMAT;
+	}
+	
+	/*  Abort puts footer, CRC table and Ending back  */
+	if (!ret && !(ret = benchcopy(fname, cname)) && !(ret = cpt_writer_append(&wr, cname, NULL, 0))) {
+		cpt_writer_append_all(&wr, &ptx, nptx0, 1);
+		cpt_writer_abort(&wr);
+		printf("append aborted: file crc %08x, input %08x\n", benchfilecrc(cname), benchfilecrc(fname));
+		if ((benchfilecrc(cname) != benchfilecrc(fname)) || (ret = cpt_verify(cname, 1)))
+			ret = CPT_EFORMAT;
+	}
+	cpt_release(&ptx, nptx0);
+	
+	return ret;
+}
+
+#define CPT_BENCH_NRANGE 9
+
+/*
+ *  Scaled obs and ang just inside either end of int16 and uint16 are
+ *  written and read back as rounded, those just past the ends and NaN
+ *  are refused with nothing of their Ptx written, instead of wrapping
+ */
+static int benchrange(const char *oname)
+{
+	int      ret, nok = 0;
+	uint8_t  nparam;
+	uint64_t nptx, icase;
+	double   obs[1], ang[4];
+	const double scale[4] = {0.5, 100, 0.25, 0};
+	const double cases[CPT_BENCH_NRANGE][3] = {  /*  raw obs, raw ang, written  */
+		{ 32767.49, 0, 1}, { 32767.5, 0, 0}, {-32768.49, 0, 1}, {-32768.5, 0, 0},
+		{0, -0.49, 1}, {0, -0.5, 0}, {0, 65535.49, 1}, {0, 65535.5, 0}, {NAN, 0, 0}};
+	struct cpt_channel channel = {443, obs, ang};
+	struct cpt_pixel   pixel = {.nchannel = 1, .nlayer = 1, .channels = &channel};
+	struct cpt_px      px = {.centrepixel = &pixel};
+	struct cpt_pt      pt = {.name = "range"};
+	struct cpt_channel *pc;
+	struct cpt_ptx     ptx;
+	struct cpt_writer  wr;
+	struct cpt_readopt opt = {.arena = 1};
+	
+	if ((ret = cpt_writer_open(&wr, oname, CPT_VERSION, 1, CPT_FSCALED|CPT_FCRC, scale, 0, 0)))
+		return ret;
+	for (icase = 0; icase < CPT_BENCH_NRANGE; ++icase) {
+		obs[0] = scale[1]+scale[0]*cases[icase][0];
+		for (int i = 0; i < 4; ++i)
+			ang[i] = scale[3]+scale[2]*cases[icase][1];
+		px.seconds = icase;
+		ret = cpt_writer_append_ptx(&wr, &(struct cpt_ptx) {&pt, &px, NULL});
+		printf("raw obs %10.2f ang %9.2f: %s\n", cases[icase][0], cases[icase][1],
+		       ret ? "refused" : "written");
+		if ((ret && (CPT_EFORMAT != ret)) || (!ret != (cases[icase][2] != 0))) {
+			CPT_ERRECHOWITHTIME("%s takes raw obs %.2f ang %.2f wrongly", oname,
+			                    cases[icase][0], cases[icase][1]);
+			cpt_writer_abort(&wr);
+			return ret ? ret : CPT_EFORMAT;
+		}
+		nok += !ret;
+	}
+	if ((ret = cpt_writer_close(&wr)) || (ret = cpt_verify(oname, 1)))
+		return ret;
+	if ((ret = cpt_readallopt(oname, &ptx, &nptx, &nparam, &opt))) {
+		cpt_release(&ptx, nptx);
+		return ret;
+	}
+	
+	/*  seconds of Px tell the case  */
+	ret = (nptx != (uint64_t) nok) ? CPT_EFORMAT : 0;
+	for (uint64_t iptx = 0; (iptx < nptx) && !ret; ++iptx) {
+		icase = ptx.px[iptx].seconds;
+		pc = ptx.px[iptx].centrepixel->channels;
+		if ((pc->obs[0] != scale[1]+scale[0]*lround(cases[icase][0]))
+		    || (pc->ang[0] != scale[3]+scale[2]*lround(cases[icase][1])))
+			ret = CPT_EFORMAT;
+	}
+	cpt_release(&ptx, nptx);
+	printf("%s: %lu Ptx of %d written read back %s\n", oname, (unsigned long) nptx, nok,
+	       ret ? "WRONG" : "as rounded");
+	
+	return ret;
+}
+
+/*
+ *  Cost per Ptx of summary, streaming and whole-file decode over files
+ *  of growing count, which stays flat as long as reading scales linearly
+ */
+static int benchscale(int nfile, char *fnames[])
+{
+	int    ret;
+	double t0, dt[3];
+	uint8_t  nparam;
+	uint64_t nptx;
+	struct cpt_ptx  ptx;
+	struct cpt_stat stat;
+	struct cpt_readopt opt = {.arena = 1};
+	
+	printf("%14s %10s %14s %14s %14s\n", "Ptx", "file MB", "stat ns/Ptx",
+	       "stream ns/Ptx", "readall ns/Ptx");
+	for (int ifile = 0; ifile < nfile; ++ifile) {
+		t0 = benchnow();
+		if ((ret = cpt_stat(fnames[ifile], &stat)))
+			return ret;
+		dt[0] = benchnow()-t0;
+		t0 = benchnow();
+		if ((ret = streamnext(fnames[ifile])))
+			return ret;
+		dt[1] = benchnow()-t0;
+		t0 = benchnow();
+		ret = cpt_readallopt(fnames[ifile], &ptx, &nptx, &nparam, &opt);
+		cpt_release(&ptx, nptx);
+		if (ret)
+			return ret;
+		dt[2] = benchnow()-t0;
+		printf("%14lu %10.1f %14.1f %14.1f %14.1f\n", (unsigned long) stat.nptx, stat.fsize/1e6,
+		       dt[0]*1e9/stat.nptx, dt[1]*1e9/stat.nptx, dt[2]*1e9/stat.nptx);
+	}
+	
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (((4 == argc) || (5 == argc)) && !strcmp(argv[1], "gen"))
+		return benchgen(argv[2], strtoull(argv[3], NULL, 10), (5 == argc) ? atoi(argv[4]) : 0);
+	if (((3 == argc) || (4 == argc)) && !strcmp(argv[1], "read"))
+		return benchread(argv[2], (4 == argc) ? atoi(argv[3]) : 1);
+	if ((3 == argc) && !strcmp(argv[1], "view"))
+		return benchview(argv[2]);
+	if ((argc > 2) && !strcmp(argv[1], "stream"))
+		return benchstream(argc-2, argv+2);
+	if (((3 == argc) || (4 == argc)) && !strcmp(argv[1], "seek"))
+		return benchseek(argv[2], (4 == argc) ? strtoul(argv[3], NULL, 10) : 100);
+	if (((3 == argc) || (4 == argc)) && !strcmp(argv[1], "par"))
+		return benchpar(argv[2], (4 == argc) ? atoi(argv[3]) : 32);
+	if ((3 == argc) && !strcmp(argv[1], "proj"))
+		return benchproj(argv[2]);
+	if (((3 == argc) || (7 == argc)) && !strcmp(argv[1], "filter")) {
+		/*  Default to a national-scale box  */
+		struct cpt_filter filter = {.flags = CPT_FBBOX, .lonmin = 73, .lonmax = 135,
+		                            .latmin = 18, .latmax = 54};
+		if (7 == argc) {
+			filter.lonmin = atof(argv[3]);
+			filter.lonmax = atof(argv[4]);
+			filter.latmin = atof(argv[5]);
+			filter.latmax = atof(argv[6]);
+		}
+		return benchfilter(argv[2], &filter);
+	}
+	if ((3 == argc) && !strcmp(argv[1], "stat"))
+		return benchstat(argv[2]);
+	if (((4 == argc) || (5 == argc)) && !strcmp(argv[1], "zip"))
+		return benchzip(argv[2], argv[3], (5 == argc) ? atoi(argv[4]) : 1);
+	if (((4 == argc) || (5 == argc)) && !strcmp(argv[1], "col"))
+		return benchcol(argv[2], argv[3], (5 == argc) ? atoi(argv[4]) : -865);
+	if ((argc > 2) && !strcmp(argv[1], "scale"))
+		return benchscale(argc-2, argv+2);
+	if ((argc >= 4) && (argc <= 6) && !strcmp(argv[1], "write"))
+		return benchwrite(argv[2], argv[3], (argc >= 5) ? atoi(argv[4]) : 1,
+		                  (6 == argc) ? atoi(argv[5]) : 0);
+	if ((4 == argc) && !strcmp(argv[1], "corrupt"))
+		return benchcorrupt(argv[2], argv[3]);
+	if ((4 == argc) && !strcmp(argv[1], "append"))
+		return benchappend(argv[2], argv[3]);
+	if ((3 == argc) && !strcmp(argv[1], "range"))
+		return benchrange(argv[2]);
+	
+	CPT_ERRECHOWITHTIME("Usage: %s gen output nptx [nt]\n"
+	                    "       %s read input [repeat]\n"
+	                    "       %s view input\n"
+	                    "       %s stream input [input...]\n"
+	                    "       %s seek input [nread]\n"
+	                    "       %s par input [maxthread]\n"
+	                    "       %s proj input\n"
+	                    "       %s filter input [lonmin lonmax latmin latmax]\n"
+	                    "       %s stat input\n"
+	                    "       %s zip input chunked [nthread]\n"
+	                    "       %s col input columnar [wv]\n"
+	                    "       %s scale input [input...]\n"
+	                    "       %s write input output [repeat [nthread]]\n"
+	                    "       %s corrupt input copy\n"
+	                    "       %s append input copy\n"
+	                    "       %s range output",
+	                    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+	                    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+	return 1;
+}
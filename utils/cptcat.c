@@ -2,9 +2,108 @@
  *file: utils/cptcat.c
  *descreption:
  *  concatenate input cpt file to output
+ *  -a to append to output in place, it is then a plain, scaled or
+ *     checksummed cpt file of its own version, such as cpttrans makes
+ *     without -z, -d or -a, otherwise output is written anew
+ *     in current version and plain layout
  *synopsis:
- *  cptcat input [input...] output
+ *  cptcat [-a] input [input...] output
  *init date: May/10/2022
- *last modify: May/10/2022
+ *last modify: Oct/17/2026
  *
  */
+
+#include "../write/writecpt.h"
+
+
+/*  Every Ptx of input, decoded one at a time into arena  */
+static int catfile(struct cpt_writer *wr, const char *input, struct cpt_arena *arena)
+{
+	int ret;
+	struct cpt_ptx  ptx;
+	struct cpt_file file;
+	
+	if ((ret = cpt_open(input, &file)))
+		return ret;
+	if (file.nparam != wr->nparam) {
+		CPT_ERRECHOWITHTIME("%s has %d params of Point while output has %d",
+		                    input, file.nparam, wr->nparam);
+		cpt_close(&file);
+		return CPT_EFORMAT;
+	}
+	while (!(ret = cpt_next_ptx(&file, &ptx, arena))) {
+		if ((ret = cpt_writer_append_ptx(wr, &ptx))) {
+			if ((CPT_EFORMAT == ret) && (ptx.pt->nt > CPT_NTMAXOF(wr->ver)))
+				CPT_ERRECHOWITHTIME("%s has Ptx No.%lu of more Points than version %d.%d holds",
+				                    input, (unsigned long) file.iptx, wr->ver>>4, wr->ver&0b00001111);
+			else if (CPT_EFORMAT == ret)
+				CPT_ERRECHOWITHTIME("%s has Ptx No.%lu of obs or ang out of scaled range of output",
+				                    input, (unsigned long) file.iptx);
+			break;
+		}
+	}
+	
+	/*  Missing Ending of input is already reported, Data is complete  */
+	if ((CPT_EEND == ret) || ((CPT_EFORMAT == ret) && file.ended && (file.iptx == file.nptx)))
+		ret = 0;
+	cpt_close(&file);
+	
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	int      ret, iarg, append;
+	uint8_t  nparam;
+	uint64_t estlen = 0;
+	const char *output;
+	struct stat st, ost;
+	struct cpt_file   file;
+	struct cpt_arena  arena;
+	struct cpt_writer wr;
+	
+	append = (argc > 1) && !strcmp(argv[1], "-a");
+	if (argc < 3+append) {
+		CPT_ERRECHOWITHTIME("Usage: %s [-a] input [input...] output", argv[0]);
+		return 1;
+	}
+	output = argv[argc-1];
+	
+	if (append) {
+		/*  Output has its Ending cut off while appended to, so it can NOT be read  */
+		for (iarg = 2; (iarg < argc-1) && !stat(output, &ost); ++iarg) {
+			if (!stat(argv[iarg], &st) && (st.st_dev == ost.st_dev) && (st.st_ino == ost.st_ino)) {
+				CPT_ERRECHOWITHTIME("%s is the output, it can NOT be appended to itself", argv[iarg]);
+				return 1;
+			}
+		}
+		if ((ret = cpt_writer_append(&wr, output, NULL, 0)))
+			return ret;
+	} else {
+		if ((ret = cpt_open(argv[1], &file)))
+			return ret;
+		nparam = file.nparam;
+		cpt_close(&file);
+		for (iarg = 1; iarg < argc-1; ++iarg)
+			estlen += stat(argv[iarg], &st) ? 0 : st.st_size;
+		if ((ret = cpt_writer_open(&wr, output, CPT_VERSION, nparam, 0, NULL, estlen, 0)))
+			return ret;
+	}
+	
+	cpt_arenainit(&arena, 0);
+	for (iarg = 1+append; (iarg < argc-1) && !ret; ++iarg)
+		ret = catfile(&wr, argv[iarg], &arena);
+	cpt_arenafree(&arena);
+	
+	/*  Output is left as it was on any failure  */
+	if (CPT_EWRITE == ret)
+		CPT_ERRECHOWITHTIME("ERROR %d %s: %s", wr.err, strerror(wr.err), output);
+	if (ret) {
+		cpt_writer_abort(&wr);
+		return ret;
+	}
+	if ((ret = cpt_writer_close(&wr)))
+		CPT_ERRECHOWITHTIME("ERROR %d %s: %s", wr.err, strerror(wr.err), output);
+	
+	return ret;
+}
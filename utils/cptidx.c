@@ -0,0 +1,62 @@
+/*
+ *file: utils/cptidx.c
+ *descreption:
+ *  build sidecar offset index of cpt files for random access,
+ *  or list an existing one
+ *synopsis:
+ *  cptidx input [input...]
+ *  cptidx -l input
+ *init date: Oct/17/2026
+ *last modify: Oct/17/2026
+ *
+ */
+
+#include "../read/readcpt.h"
+
+
+static int idxlist(const char *fname)
+{
+	int ret;
+	struct cpt_idx idx;
+	struct cpt_idxent *ent;
+	
+	if ((ret = cpt_idxload(fname, &idx))) {
+		if (CPT_EOPEN == ret)
+			CPT_ERRECHOWITHTIME("%s has NO index", fname);
+		return ret;
+	}
+	
+	printf("%lu Ptx, Ending at %lu\n", (unsigned long) idx.hdr.nptx, (unsigned long) idx.hdr.end);
+	for (uint64_t i = 0; i < idx.hdr.nptx; ++i) {
+		ent = idx.ents+i;
+		printf("No.%06lu: offset %12lu seconds %12lu lon %9.4f lat %8.4f (%s)\n",
+		       (unsigned long) i+1, (unsigned long) ent->off, (unsigned long) ent->seconds,
+		       ent->lon, ent->lat, idx.pool+ent->name);
+	}
+	cpt_idxfree(&idx);
+	
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret = 0;
+	
+	if ((3 == argc) && !strcmp(argv[1], "-l"))
+		return idxlist(argv[2]);
+	if (argc < 2) {
+		CPT_ERRECHOWITHTIME("Usage: %s input [input...]\n"
+		                    "       %s -l input",
+		                    argv[0], argv[0]);
+		return 1;
+	}
+	
+	for (int i = 1; i < argc; ++i) {
+		if (cpt_idxbuild(argv[i])) {
+			CPT_ERRECHOWITHTIME("Fail to index %s", argv[i]);
+			ret = 1;
+		}
+	}
+	
+	return ret;
+}
@@ -0,0 +1,104 @@
+/*
+ *file: utils/cptstat.c
+ *descreption:
+ *  summarize cpt files without decoding payloads,
+ *  or check them against CRC32C in footer by all cores
+ *synopsis:
+ *  cptstat [--verify] input [input...]
+ *init date: Oct/17/2026
+ *last modify: Oct/17/2026
+ *
+ */
+
+#include "../read/readcpt.h"
+
+
+/*
+ *  UTC, as seconds in cpt are elapsed since the Epoch,
+ *  raw seconds if that is past what gmtime or str holds
+ */
+static const char *stattime(uint64_t seconds, char *str, size_t len)
+{
+	time_t    t = seconds;
+	struct tm tm;
+	
+	if (((uint64_t) t != seconds) || (t < 0) || !gmtime_r(&t, &tm)
+	    || !strftime(str, len, "%Y-%m-%dT%H:%M:%S", &tm))
+		snprintf(str, len, "%lu s", (unsigned long) seconds);
+	return str;
+}
+
+static void statprint(const char *fname, const struct cpt_stat *stat)
+{
+	char tmin[32], tmax[32];
+	
+	printf("%s\n", fname);
+	printf("  version    %d.%d\n", stat->ver>>4, stat->ver&0b00001111);
+	printf("  size       %lu bytes\n", (unsigned long) stat->fsize);
+	printf("  Ptx        %lu\n", (unsigned long) stat->nptx);
+	printf("  params     %u\n", stat->nparam);
+	if (stat->nsite)
+		printf("  sites      %u in dictionary\n", stat->nsite);
+	if (!stat->nptx)
+		return;
+	
+	printf("  points     %lu, %u to %u per Pt\n", (unsigned long) stat->npoint,
+	       stat->ntmin, stat->ntmax);
+	printf("  lon        %.4f to %.4f\n", stat->lonmin, stat->lonmax);
+	printf("  lat        %.4f to %.4f\n", stat->latmin, stat->latmax);
+	printf("  time       %s to %s\n", stattime(stat->tmin, tmin, sizeof(tmin)),
+	       stattime(stat->tmax, tmax, sizeof(tmax)));
+	printf("  pixels     %lu\n", (unsigned long) stat->npixel);
+	printf("  channels   %u to %u per pixel\n", stat->nchannelmin, stat->nchannelmax);
+	if (stat->nchannelmax)
+		printf("  layers     %u to %u\n", stat->nlayermin, stat->nlayermax);
+	printf("  extras     %u to %u per pixel\n", stat->nextramin, stat->nextramax);
+	
+	printf("  vicinity   Ptx\n");
+	for (int i = 0; i < 256; ++i) {
+		if (stat->nvicinity[i])
+			printf("  %8d   %u\n", i, stat->nvicinity[i]);
+	}
+	printf("  wavelength channels (polarized if negative)\n");
+	for (uint16_t iwv = 0; iwv < stat->nwv; ++iwv)
+		printf("  %8d   %lu\n", stat->wv[iwv], (unsigned long) stat->nwvchannel[iwv]);
+}
+
+int main(int argc, char *argv[])
+{
+	int  ret = 0, iarg = 1;
+	long ncore;
+	struct cpt_stat stat;
+	
+	if ((argc > 1) && !strcmp(argv[1], "--verify"))
+		++iarg;
+	if (iarg >= argc) {
+		CPT_ERRECHOWITHTIME("Usage: %s [--verify] input [input...]", argv[0]);
+		return 1;
+	}
+	
+	if (iarg > 1) {
+		ncore = sysconf(_SC_NPROCESSORS_ONLN);
+		ncore = (ncore < 1) ? 1 : (ncore > UINT8_MAX) ? UINT8_MAX : ncore;
+		for (int i = iarg; i < argc; ++i) {
+			if (cpt_verify(argv[i], ncore)) {
+				printf("%s BROKEN\n", argv[i]);
+				ret = 1;
+			} else {
+				printf("%s OK\n", argv[i]);
+			}
+		}
+		return ret;
+	}
+	
+	for (int i = iarg; i < argc; ++i) {
+		if (cpt_stat(argv[i], &stat)) {
+			CPT_ERRECHOWITHTIME("Fail to summarize %s", argv[i]);
+			ret = 1;
+			continue;
+		}
+		statprint(argv[i], &stat);
+	}
+	
+	return ret;
+}
@@ -0,0 +1,57 @@
+/*
+ *file: utils/cpttail.c
+ *descreption:
+ *  follow a cpt file being written, print each Ptx once complete
+ *synopsis:
+ *  cpttail [-s seconds] input
+ *init date: Oct/17/2026
+ *last modify: Oct/17/2026
+ *
+ */
+
+#include "../read/readcpt.h"
+
+
+int main(int argc, char *argv[])
+{
+	int ret, interval = 1;
+	const char *fname;
+	struct cpt_ptx   ptx;
+	struct cpt_file  file;
+	struct cpt_arena arena;
+	
+	if ((4 == argc) && !strcmp(argv[1], "-s")) {
+		interval = atoi(argv[2]);
+		fname = argv[3];
+	} else if (2 == argc) {
+		fname = argv[1];
+	} else {
+		CPT_ERRECHOWITHTIME("Usage: %s [-s seconds] input", argv[0]);
+		return 1;
+	}
+	
+	/*  Header may not be there yet  */
+	while ((ret = cpt_open(fname, &file))) {
+		if (CPT_ETRUNC != ret)
+			return ret;
+		sleep(interval);
+	}
+	
+	cpt_arenainit(&arena, 0);
+	while ((ret = cpt_follow(&file, &ptx, &arena)) != CPT_EEND) {
+		if (CPT_EAGAIN == ret) {
+			fflush(stdout);
+			sleep(interval);
+			continue;
+		}
+		if (ret)
+			break;
+		printf("No.%06lu: end %12lu seconds %12lu lon %9.4f lat %8.4f (%s)\n",
+		       (unsigned long) file.iptx, (unsigned long) cpt_tell(&file), (unsigned long) ptx.px->seconds,
+		       ptx.pt->lon, ptx.pt->lat, ptx.pt->name ? ptx.pt->name : "");
+	}
+	cpt_arenafree(&arena);
+	cpt_close(&file);
+	
+	return (CPT_EEND == ret) ? 0 : ret;
+}
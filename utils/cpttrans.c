@@ -3,8 +3,799 @@
  *descreption:
  *  transform input cpt file into newer or older format
  *synopsis:
- *  cpttrans -to version input [output]
+ *  cpttrans -to version [-z] [-s] [-c] [-0] [-d] [-a] input [output]
+ *  -z to deflate Data in chunks (0.2 and later)
+ *  -s to shuffle chunks before deflate, implies -z
+ *  -c to split chunks into columns before deflate, implies -z
+ *  -0 to store chunks as they are, implies -z
+ *     chunks are deflated and checksummed by a thread per core
+ *  -d to name Pt by IDs into a site dictionary (0.2 and later),
+ *     names are written out in place otherwise
+ *  -a to pad arrays of double to 8 bytes for mapping (0.2 and later),
+ *     not along with chunks
+ *  scaled layout of input is kept, CRC32C of each Ptx or chunk
+ *  is always written since 0.2, check them by cptstat --verify,
+ *  so are zone maps of chunks for filters to skip them
+ *  nt of Pt is widened or narrowed as version wants, up to 0.2
+ *  there are at most 255 Points per Pt and 2^32-1 Ptx
+ *  output defaults to stdout
  *init date: May/10/2022
- *last modify: May/10/2022
+ *last modify: Oct/17/2026
  *
  */
+
+#include "../write/writecpt.h"
+
+
+/*  Chunk on its way out, encoded by any thread of the pool  */
+struct transjob {
+	const struct trans *tr;  /*  of ver, flags, level and nparam only  */
+	uint8_t *raw;      /*  Ptx of chunk          */
+	size_t   nraw;
+	size_t   rawcap;
+	uint8_t *sdata;    /*  shuffled or columnar chunk  */
+	uint8_t *zdata;
+	size_t   zcap;
+	const uint8_t *out;  /*  stored bytes, in one of the above  */
+	uint32_t hdr[2];   /*  inflated and stored length  */
+	uint32_t crc;      /*  of header and stored bytes  */
+	uint64_t off;      /*  inflated offset of chunk  */
+	struct cpt_zone zone;
+};
+
+/*  Output side, offsets are the inflated ones but for file offset foff  */
+struct trans {
+	FILE    *fp;
+	uint64_t off;
+	uint64_t foff;
+	struct transjob  *jobs;  /*  one for each slot of pool  */
+	struct transjob  *job;   /*  chunk being gathered       */
+	struct cpt_wrpool pool;
+	uint8_t  ver;
+	uint8_t  flags;
+	int      level;    /*  of deflate            */
+	uint8_t  nparam;
+	uint64_t *chunks;  /*  pairs of file and inflated offset  */
+	uint32_t nchunk;
+	uint32_t chunkcap;
+	struct cpt_zone *zones;  /*  one for each chunk  */
+	struct cpt_zone  all;    /*  of all chunks       */
+	uint8_t *ptx;      /*  Ptx with its name swapped  */
+	size_t   ptxcap;
+	uint8_t *wide;     /*  Ptx with nt resized  */
+	size_t   widecap;
+	uint8_t *pad;      /*  Ptx padded or not  */
+	size_t   padcap;
+	uint32_t crc;      /*  of bytes written since last unit  */
+	uint32_t *crcs;    /*  of each Ptx or chunk  */
+	uint32_t ncrc;
+};
+
+/*  Site dictionary built of names met, slots is an open addressing hash of ID+1  */
+struct transsite {
+	char     *pool;
+	uint32_t  npool;
+	size_t    poolcap;
+	uint32_t *offs;     /*  of each name in pool  */
+	uint32_t  nsite;
+	uint32_t  sitecap;
+	uint32_t *slots;
+	uint32_t  nslot;
+};
+
+static uint32_t sitehash(const char *name, uint32_t nslot)
+{
+	uint32_t hash = 2166136261u;
+	
+	for (const char *p = name; *p; ++p)
+		hash = (hash ^ (uint8_t) *p) * 16777619u;
+	
+	return hash & (nslot-1);
+}
+
+/*  ID of name, taken as a new site if not met yet, CPT_NOSITE if out of memory  */
+static uint32_t transsiteid(struct transsite *ts, const char *name)
+{
+	void    *p;
+	size_t   len;
+	uint32_t hash;
+	
+	for (hash = sitehash(name, ts->nslot); ts->slots[hash]; hash = (hash+1) & (ts->nslot-1)) {
+		if (!strcmp(ts->pool+ts->offs[ts->slots[hash]-1], name))
+			return ts->slots[hash]-1;
+	}
+	
+	len = strlen(name)+1;
+	if ((ts->nsite == CPT_NOSITE-1) || ((size_t) ts->npool+len > UINT32_MAX))
+		return CPT_NOSITE;
+	if (ts->npool+len > ts->poolcap) {
+		ts->poolcap = 2*(ts->npool+len);
+		if (!(p = realloc(ts->pool, ts->poolcap)))
+			return CPT_NOSITE;
+		ts->pool = p;
+	}
+	if (ts->nsite == ts->sitecap) {
+		ts->sitecap = ts->sitecap ? 2*ts->sitecap : 256;
+		if (!(p = realloc(ts->offs, sizeof(uint32_t[ts->sitecap]))))
+			return CPT_NOSITE;
+		ts->offs = p;
+	}
+	memcpy(ts->pool+ts->npool, name, len);
+	ts->offs[ts->nsite] = ts->npool;
+	ts->npool += len;
+	ts->slots[hash] = ++ts->nsite;
+	
+	/*  Hash is kept at most half full  */
+	if (2*ts->nsite >= ts->nslot) {
+		if (!(p = calloc(2*ts->nslot, sizeof(uint32_t))))
+			return CPT_NOSITE;
+		free(ts->slots);
+		ts->slots  = p;
+		ts->nslot *= 2;
+		for (uint32_t isite = 0; isite < ts->nsite; ++isite) {
+			for (hash = sitehash(ts->pool+ts->offs[isite], ts->nslot); ts->slots[hash];
+			     hash = (hash+1) & (ts->nslot-1)) ;
+			ts->slots[hash] = isite+1;
+		}
+	}
+	
+	return ts->nsite-1;
+}
+
+/*  Names of all Ptx of input into a dictionary, ids[iptx] is that of each  */
+static int transsites(const char *input, struct transsite *ts, uint32_t *ids)
+{
+	int ret;
+	size_t   len;
+	uint32_t id;
+	uint64_t iptx;
+	const uint8_t *data;
+	struct cpt_file file;
+	
+	if ((ret = cpt_open(input, &file)))
+		return ret;
+	ts->nslot = 256;
+	if (!(ts->slots = calloc(ts->nslot, sizeof(uint32_t)))) {
+		cpt_close(&file);
+		return CPT_EMEM;
+	}
+	for (iptx = 0; !(ret = cpt_next_raw(&file, &data, &len)); ++iptx) {
+		if (file.buf.siteid) {
+			memcpy(&id, data, sizeof(id));
+			if (id >= file.nsite) {
+				ret = CPT_ETRUNC;
+				break;
+			}
+		}
+		if (CPT_NOSITE == (ids[iptx] = transsiteid(ts, file.buf.siteid ? file.sites[id]
+		                                                                : (const char *) data))) {
+			ret = CPT_EMEM;
+			break;
+		}
+	}
+	cpt_close(&file);
+	
+	return (CPT_EEND == ret) ? 0 : ret;
+}
+
+/*
+ *  Swap name at the start of Ptx for site ID, or the other way round,
+ *  *data and *len then describe the new one in tr->ptx
+ */
+static int transname(struct trans *tr, const struct cpt_file *file, uint32_t id,
+                     const uint8_t **data, size_t *len)
+{
+	void  *p;
+	size_t namelen, outlen;
+	const char *name = NULL;
+	
+	if (file->buf.siteid) {
+		memcpy(&id, *data, sizeof(id));
+		if (id >= file->nsite)
+			return CPT_ETRUNC;
+		name    = file->sites[id];
+		namelen = sizeof(id);
+		outlen  = strlen(name)+1;
+	} else {
+		namelen = strlen((const char *) *data)+1;
+		outlen  = sizeof(id);
+	}
+	if (*len-namelen+outlen > tr->ptxcap) {
+		tr->ptxcap = 2*(*len-namelen+outlen);
+		if (!(p = realloc(tr->ptx, tr->ptxcap)))
+			return CPT_EMEM;
+		tr->ptx = p;
+	}
+	memcpy(tr->ptx, name ? (const void *) name : (const void *) &id, outlen);
+	memcpy(tr->ptx+outlen, *data+namelen, *len-namelen);
+	*data = tr->ptx;
+	*len += outlen-namelen;
+	
+	return 0;
+}
+
+/*
+ *  nt of unpadded Ptx from bytes of version from to those of tr->ver,
+ *  *data and *len then describe the new one in tr->wide
+ */
+static int transnt(struct trans *tr, uint8_t from, const uint8_t **data, size_t *len)
+{
+	void    *p;
+	uint16_t nt = 0;
+	size_t   namelen, fromlen = CPT_NTLENOF(from), tolen = CPT_NTLENOF(tr->ver);
+	const uint8_t *pend;
+	
+	if (tr->flags & CPT_FSITEID)
+		namelen = sizeof(uint32_t);
+	else if ((pend = memchr(*data, '\0', *len)))
+		namelen = pend+1-*data;
+	else
+		return CPT_ETRUNC;
+	if (*len < namelen+4+4+2+fromlen)
+		return CPT_ETRUNC;
+	memcpy(&nt, *data+namelen+4+4+2, fromlen);
+	if (nt > CPT_NTMAXOF(tr->ver))
+		return CPT_EFORMAT;
+	
+	if (*len-fromlen+tolen > tr->widecap) {
+		tr->widecap = 2*(*len-fromlen+tolen);
+		if (!(p = realloc(tr->wide, tr->widecap)))
+			return CPT_EMEM;
+		tr->wide = p;
+	}
+	memcpy(tr->wide, *data, namelen+4+4+2);
+	memcpy(tr->wide+namelen+4+4+2, &nt, tolen);
+	memcpy(tr->wide+namelen+4+4+2+tolen, *data+namelen+4+4+2+fromlen, *len-namelen-4-4-2-fromlen);
+	*data = tr->wide;
+	*len += tolen-fromlen;
+	
+	return 0;
+}
+
+/*  "0.3" into version byte, 0 if this lib cannot write it  */
+static uint8_t transver(const char *str)
+{
+	unsigned major, minor;
+	uint8_t  ver;
+	
+	if ((2 != sscanf(str, "%u.%u", &major, &minor)) || (major > 15) || (minor > 15))
+		return 0;
+	ver = (major<<4) | minor;
+	
+	return ((CPT_VERSION == ver) || (CPT_VERSION02 == ver) || (CPT_VERSION01 == ver)) ? ver : 0;
+}
+
+/*  Write n bytes out, folded into CRC of checksummed layout  */
+static void transwrite(struct trans *tr, const void *src, size_t n)
+{
+	fwrite(src, 1, n, tr->fp);
+	if (tr->flags & CPT_FCRC)
+		tr->crc = cpt_crc32c(tr->crc, src, n);
+}
+
+/*  CRC of Ptx or chunk just written is taken, the next one starts  */
+static void transcrc(struct trans *tr)
+{
+	if (tr->flags & CPT_FCRC)
+		tr->crcs[tr->ncrc++] = tr->crc;
+	tr->crc = 0;
+}
+
+/*  Record a chunk starting here and at inflated offset off, closing one included  */
+static int transmark(struct trans *tr, uint64_t off)
+{
+	void *p;
+	
+	if (tr->nchunk >= tr->chunkcap) {
+		tr->chunkcap = tr->chunkcap ? 2*tr->chunkcap : 64;
+		if (!(p = realloc(tr->chunks, sizeof(uint64_t[tr->chunkcap][2]))))
+			return CPT_EMEM;
+		tr->chunks = p;
+		if (!(p = realloc(tr->crcs, sizeof(uint32_t[tr->chunkcap]))))
+			return CPT_EMEM;
+		tr->crcs = p;
+		if (!(p = realloc(tr->zones, sizeof(struct cpt_zone[tr->chunkcap]))))
+			return CPT_EMEM;
+		tr->zones = p;
+	}
+	tr->chunks[2*tr->nchunk]   = tr->foff;
+	tr->chunks[2*tr->nchunk+1] = off;
+	++tr->nchunk;
+	
+	return 0;
+}
+
+/*  Zone that holds nothing yet  */
+static void zoneinit(struct cpt_zone *zone)
+{
+	zone->lonmin  = zone->latmin = INFINITY;
+	zone->lonmax  = zone->latmax = -INFINITY;
+	zone->tmin    = UINT64_MAX;
+	zone->tmax    = 0;
+	zone->sitemin = CPT_NOSITE;
+	zone->sitemax = 0;
+}
+
+static void zonejoin(struct cpt_zone *dst, const struct cpt_zone *src)
+{
+	dst->lonmin  = (src->lonmin < dst->lonmin) ? src->lonmin : dst->lonmin;
+	dst->lonmax  = (src->lonmax > dst->lonmax) ? src->lonmax : dst->lonmax;
+	dst->latmin  = (src->latmin < dst->latmin) ? src->latmin : dst->latmin;
+	dst->latmax  = (src->latmax > dst->latmax) ? src->latmax : dst->latmax;
+	dst->tmin    = (src->tmin < dst->tmin) ? src->tmin : dst->tmin;
+	dst->tmax    = (src->tmax > dst->tmax) ? src->tmax : dst->tmax;
+	dst->sitemin = (src->sitemin < dst->sitemin) ? src->sitemin : dst->sitemin;
+	dst->sitemax = (src->sitemax > dst->sitemax) ? src->sitemax : dst->sitemax;
+}
+
+/*  Ptx as written out into zone of current chunk, NaN lon or lat is left out  */
+static int transzone(struct trans *tr, const uint8_t *data, size_t len)
+{
+	const uint8_t *p = data, *end = data+len, *pend;
+	struct cpt_zone z;
+	uint16_t nt = 0;
+	size_t   ntlen = CPT_NTLENOF(tr->ver);
+	
+	zoneinit(&z);
+	if (tr->flags & CPT_FSITEID) {
+		if (len < sizeof(uint32_t))
+			return CPT_ETRUNC;
+		memcpy(&z.sitemin, p, sizeof(uint32_t));
+		z.sitemax = z.sitemin;
+		p += sizeof(uint32_t);
+	} else if ((pend = memchr(p, '\0', len))) {
+		p = pend+1;
+	} else {
+		return CPT_ETRUNC;
+	}
+	if ((size_t) (end-p) < 4+4+2+ntlen)
+		return CPT_ETRUNC;
+	memcpy(&z.lonmin, p, 4);
+	memcpy(&z.latmin, p+4, 4);
+	memcpy(&nt, p+10, ntlen);
+	p += 4+4+2+ntlen;
+	if ((size_t) (end-p) < nt*sizeof(double[tr->nparam+1])+8)
+		return CPT_ETRUNC;
+	memcpy(&z.tmin, p+nt*sizeof(double[tr->nparam+1]), 8);
+	z.tmax = z.tmin;
+	if (isnan(z.lonmin) || isnan(z.latmin)) {
+		z.lonmin = z.latmin = INFINITY;
+	} else {
+		z.lonmax = z.lonmin;
+		z.latmax = z.latmin;
+	}
+	zonejoin(&tr->job->zone, &z);
+	
+	return 0;
+}
+
+/*
+ *  Shuffle or split into columns and deflate Ptx of a chunk, then take
+ *  CRC of what is to be written, on any thread of pool
+ */
+static int transencode(void *arg)
+{
+	void    *p;
+	uint8_t *src;
+	size_t   len;
+	uLongf   zlen;
+	struct transjob *job = arg;
+	const struct trans *tr = job->tr;
+	
+	src = job->raw;
+	len = job->nraw;
+	if (tr->flags & CPT_FSHUFFLE) {
+		if (cpt_chunkshuffle(job->raw, job->nraw, tr->ver, tr->nparam, tr->flags, job->sdata))
+			return CPT_EFORMAT;
+		src = job->sdata;
+		len = CPT_SHUFHDRLEN+job->nraw;
+	} else if (tr->flags & CPT_FCOLUMN) {
+		if (cpt_chunkcolumn(job->raw, job->nraw, tr->ver, tr->nparam, tr->flags, job->sdata, &len))
+			return CPT_EFORMAT;
+		src = job->sdata;
+	}
+	
+	/*  Stored as is unless deflate makes it smaller  */
+	job->out = src;
+	zlen = len;
+	if (Z_NO_COMPRESSION != tr->level) {
+		zlen = compressBound(len);
+		if (zlen > job->zcap) {
+			if (!(p = realloc(job->zdata, zlen)))
+				return CPT_EMEM;
+			job->zdata = p;
+			job->zcap  = zlen;
+		}
+		if (Z_OK != compress2(job->zdata, &zlen, src, len, tr->level))
+			return CPT_EMEM;
+		if (zlen < len)
+			job->out = job->zdata;
+		else
+			zlen = len;
+	}
+	if (len > UINT32_MAX)
+		return CPT_EMEM;
+	
+	job->hdr[0] = len;
+	job->hdr[1] = zlen;
+	if (tr->flags & CPT_FCRC)
+		job->crc = cpt_crc32c(cpt_crc32c(0, job->hdr, CPT_CHUNKHDRLEN), job->out, zlen);
+	
+	return 0;
+}
+
+/*  Write the oldest chunk in pool once encoded, chunks go out in order they were gathered  */
+static int transtake(struct trans *tr)
+{
+	int ret;
+	struct transjob *job;
+	
+	if (!(job = cpt_wrpool_take(&tr->pool, &ret)))
+		return 0;
+	if (ret || (ret = transmark(tr, job->off)))
+		return ret;
+	fwrite(job->hdr, 1, CPT_CHUNKHDRLEN, tr->fp);
+	fwrite(job->out, 1, job->hdr[1], tr->fp);
+	if (tr->flags & CPT_FCRC)
+		tr->crcs[tr->ncrc++] = job->crc;
+	tr->zones[tr->nchunk-1] = job->zone;
+	zonejoin(&tr->all, &job->zone);
+	tr->foff += CPT_CHUNKHDRLEN+job->hdr[1];
+	
+	return 0;
+}
+
+/*
+ *  Put Ptx gathered so far to pool as one chunk, the next is gathered
+ *  into a free slot, so one chunk is written first if pool is full
+ */
+static int transflush(struct trans *tr)
+{
+	int ret;
+	
+	if (!tr->job->nraw)
+		return 0;
+	tr->job->off = tr->off-tr->job->nraw;
+	cpt_wrpool_put(&tr->pool, tr->job);
+	if ((tr->pool.nput-tr->pool.ntaken >= tr->pool.window) && (ret = transtake(tr)))
+		return ret;
+	tr->job = tr->jobs+tr->pool.nput%tr->pool.window;
+	tr->job->nraw = 0;
+	zoneinit(&tr->job->zone);
+	
+	return 0;
+}
+
+/*  Every chunk put is written  */
+static int transdrain(struct trans *tr)
+{
+	int ret = 0;
+	
+	while (!ret && (tr->pool.ntaken < tr->pool.nput))
+		ret = transtake(tr);
+	
+	return ret;
+}
+
+/*
+ *  Pool of a thread per core with two chunks each, chunked output is
+ *  byte for byte the same whatever the count of threads
+ */
+static int transpool(struct trans *tr)
+{
+	long ncore = sysconf(_SC_NPROCESSORS_ONLN);
+	
+	ncore = (ncore < 1) ? 1 : (ncore > UINT8_MAX) ? UINT8_MAX : ncore;
+	if (!(tr->jobs = calloc(2*ncore, sizeof(struct transjob))))
+		return CPT_EMEM;
+	if (cpt_wrpool_init(&tr->pool, (ncore > 1) ? ncore : 0, 2*ncore, transencode)) {
+		CPT_FREE(tr->jobs);
+		return CPT_EMEM;
+	}
+	for (long ijob = 0; ijob < 2*ncore; ++ijob)
+		tr->jobs[ijob].tr = tr;
+	tr->job = tr->jobs;
+	zoneinit(&tr->job->zone);
+	
+	return 0;
+}
+
+/*  Chunks not written yet are dropped  */
+static void transpoolfree(struct trans *tr)
+{
+	if (!tr->jobs)
+		return;
+	cpt_wrpool_free(&tr->pool);
+	for (uint64_t ijob = 0; ijob < tr->pool.window; ++ijob) {
+		CPT_FREE(tr->jobs[ijob].raw);
+		CPT_FREE(tr->jobs[ijob].sdata);
+		CPT_FREE(tr->jobs[ijob].zdata);
+	}
+	CPT_FREE(tr->jobs);
+}
+
+/*  Ptx goes whole into current chunk, which is flushed once large enough  */
+static int transchunk(struct trans *tr, const uint8_t *data, size_t len)
+{
+	void *p;
+	struct transjob *job = tr->job;
+	
+	if (CPT_COLBOUND(job->nraw+len) > UINT32_MAX)
+		return CPT_EFORMAT;
+	if (job->nraw+len > job->rawcap) {
+		job->rawcap = (job->nraw+len > CPT_CHUNKSIZE) ? job->nraw+len : CPT_CHUNKSIZE;
+		if (!(p = realloc(job->raw, job->rawcap)))
+			return CPT_EMEM;
+		job->raw = p;
+		if (tr->flags & (CPT_FSHUFFLE|CPT_FCOLUMN)) {
+			if (!(p = realloc(job->sdata, (tr->flags & CPT_FCOLUMN) ?
+			                              CPT_COLBOUND(job->rawcap) : CPT_SHUFHDRLEN+job->rawcap)))
+				return CPT_EMEM;
+			job->sdata = p;
+		}
+	}
+	memcpy(job->raw+job->nraw, data, len);
+	job->nraw += len;
+	
+	return (job->nraw >= CPT_CHUNKSIZE) ? transflush(tr) : 0;
+}
+
+/*  Ptx of version ver padded as layout to wants, *data and *len then describe it in tr->pad  */
+static int transpad(struct trans *tr, uint8_t ver, uint8_t from, uint8_t to,
+                    const uint8_t **data, size_t *len)
+{
+	void *p;
+	
+	if (CPT_PADBOUND(*len) > tr->padcap) {
+		tr->padcap = CPT_PADBOUND(*len);
+		if (!(p = realloc(tr->pad, tr->padcap)))
+			return CPT_EMEM;
+		tr->pad = p;
+	}
+	if (cpt_ptxalign(*data, *len, ver, tr->nparam, from, to, tr->pad, len))
+		return CPT_ETRUNC;
+	*data = tr->pad;
+	
+	return 0;
+}
+
+/*
+ *  Ptx are copied as encoded, only header, footer and width of nt
+ *  differ between versions, so nothing is decoded, chunks are inflated
+ *  or deflated on the way when layout changes, so are names
+ *  and padding of Ptx.
+ */
+static int trans(uint8_t ver, uint8_t flags, int level, const char *input, const char *output)
+{
+	int ret;
+	size_t   len;
+	uint8_t  swap, widen, unpad, pad;
+	uint32_t head, hdr[2] = {0, 0}, *ids = NULL;
+	uint64_t iptx, *offs;
+	const uint8_t *data;
+	struct cpt_file    file;
+	struct cpt_trailer trailer;
+	struct trans tr = {0};
+	struct transsite ts = {0};
+	
+	if ((ret = cpt_open(input, &file)))
+		return ret;
+	if (file.nptx > CPT_NPTXMAXOF(ver)) {
+		CPT_ERRECHOWITHTIME("%s has more Ptx than version %d.%d holds", input, ver>>4, ver&0b00001111);
+		cpt_close(&file);
+		return CPT_EFORMAT;
+	}
+	
+	/*  Dictionary of input is kept as it is, otherwise one is made of names met  */
+	if ((flags & CPT_FSITEID) && !file.buf.siteid) {
+		if (!(ids = malloc(sizeof(uint32_t[file.nptx+1])))
+		    || (ret = transsites(input, &ts, ids))) {
+			CPT_ERRECHOWITHTIME("site dictionary of %s can NOT be made", input);
+			cpt_close(&file);
+			CPT_FREE(ids);
+			CPT_FREE(ts.pool);
+			CPT_FREE(ts.offs);
+			CPT_FREE(ts.slots);
+			return ret ? ret : CPT_EMEM;
+		}
+	}
+	
+	/*  Scaled Ptx are copied as they are, so is the layout  */
+	flags |= file.flags & CPT_FSCALED;
+	if ((flags & CPT_FSCALED) && (CPT_VERSION01 == ver)) {
+		CPT_ERRECHOWITHTIME("%s is scaled and needs version 0.2 or later", input);
+		cpt_close(&file);
+		return CPT_EFORMAT;
+	}
+	if (!(offs = malloc(sizeof(uint64_t[file.nptx+1])))
+	    || (!(flags & CPT_FCHUNK) && !(tr.crcs = malloc(sizeof(uint32_t[file.nptx+1]))))
+	    || ((flags & CPT_FCHUNK) && transpool(&tr))) {
+		cpt_close(&file);
+		CPT_FREE(offs);
+		CPT_ERRMEM(tr.crcs);
+		return CPT_EMEM;
+	}
+	if (!(tr.fp = output ? fopen(output, "wb") : stdout)) {
+		CPT_ERROPEN(output);
+		cpt_close(&file);
+		free(offs);
+		CPT_FREE(tr.crcs);
+		transpoolfree(&tr);
+		return CPT_EOPEN;
+	}
+	setvbuf(tr.fp, NULL, _IOFBF, CPT_BUFSIZE);
+	tr.ver     = ver;
+	tr.flags   = flags;
+	tr.level   = level;
+	tr.nparam  = file.nparam;
+	zoneinit(&tr.all);
+	
+	/*  Header  */
+	transwrite(&tr, CPT_MAGIC, CPT_MAGICLEN);
+	transwrite(&tr, &ver, 1);
+	transwrite(&tr, &file.nptx, CPT_NPTXLENOF(ver));
+	transwrite(&tr, &file.nparam, 1);
+	if (CPT_VERSION01 != ver)
+		transwrite(&tr, &flags, 1);
+	tr.off = tr.foff = CPT_HDRLENOF(ver);
+	
+	/*  Site dictionary  */
+	if (flags & CPT_FSITEID) {
+		hdr[0] = ids ? ts.nsite : file.nsite;
+		hdr[1] = ids ? ts.npool : file.nsitebyte;
+		transwrite(&tr, hdr, CPT_SITEHDRLEN);
+		transwrite(&tr, ids ? ts.pool : file.sitepool, hdr[1]);
+		tr.off = tr.foff += CPT_SITEHDRLEN+hdr[1];
+		hdr[0] = hdr[1] = 0;
+	}
+	
+	/*  Padding is taken off before name is swapped or nt resized and put back after  */
+	swap  = !!(flags & CPT_FSITEID) != file.buf.siteid;
+	widen = CPT_NTLENOF(file.ver) != CPT_NTLENOF(ver);
+	unpad = (file.flags & CPT_FALIGNED) && (swap || widen || !(flags & CPT_FALIGNED));
+	pad   = (flags & CPT_FALIGNED) && (swap || widen || !(file.flags & CPT_FALIGNED));
+	if (flags & CPT_FALIGNED) {
+		transwrite(&tr, hdr, CPT_PADLEN(tr.foff));
+		tr.off = tr.foff += CPT_PADLEN(tr.foff);
+	}
+	head   = tr.crc;
+	tr.crc = 0;
+	
+	/*  Data  */
+	for (iptx = 0; !(ret = cpt_next_raw(&file, &data, &len)); ++iptx) {
+		if ((unpad && (ret = transpad(&tr, file.ver, file.flags, file.flags & ~CPT_FALIGNED,
+		                              &data, &len)))
+		    || (swap && (ret = transname(&tr, &file, ids ? ids[iptx] : 0, &data, &len)))
+		    || (widen && (ret = transnt(&tr, file.ver, &data, &len)))
+		    || (pad && (ret = transpad(&tr, ver, flags & ~CPT_FALIGNED, flags, &data, &len)))) {
+			if (CPT_EMEM == ret)
+				CPT_ERRMEM(tr.pad);
+			else if (CPT_EFORMAT == ret)
+				CPT_ERRECHOWITHTIME("%s has Ptx No.%lu of more Points than version %d.%d holds",
+				                    input, (unsigned long) iptx+1, ver>>4, ver&0b00001111);
+			else
+				CPT_ERRECHOWITHTIME("%s has broken Ptx No.%lu", input, (unsigned long) iptx+1);
+			break;
+		}
+		offs[iptx] = tr.off;
+		tr.off += len;
+		if (!(flags & CPT_FCHUNK)) {
+			transwrite(&tr, data, len);
+			transcrc(&tr);
+			tr.foff += len;
+		} else if (((flags & CPT_FZONE) && (ret = transzone(&tr, data, len)))
+		           || (ret = transchunk(&tr, data, len))) {
+			CPT_ERRECHOWITHTIME("%s can NOT be chunked at Ptx No.%lu", input, (unsigned long) iptx+1);
+			break;
+		}
+	}
+	
+	/*  Missing Ending of input is already reported, Data is complete  */
+	if ((CPT_EEND == ret) || ((CPT_EFORMAT == ret) && file.ended)) {
+		ret = (CPT_EEND == ret) ? 0 : ret;
+		if ((flags & CPT_FCHUNK) && (transflush(&tr) || transdrain(&tr) || transmark(&tr, tr.off)))
+			ret = CPT_EMEM;
+		else if (flags & CPT_FCHUNK)
+			tr.zones[tr.nchunk-1] = tr.all;
+		
+		/*  Closing chunk and tables go into CRC of head  */
+		tr.crc = head;
+		if (flags & CPT_FCHUNK) {
+			transwrite(&tr, hdr, CPT_CHUNKHDRLEN);
+			tr.foff += CPT_CHUNKHDRLEN;
+		}
+		if (CPT_VERSION01 != ver) {
+			trailer.table  = tr.foff;
+			trailer.ntable = file.nptx;
+			memcpy(trailer.magic, CPT_TRAILERMAGIC, sizeof(trailer.magic));
+			transwrite(&tr, offs, sizeof(uint64_t[file.nptx]));
+			if (flags & CPT_FCHUNK)
+				transwrite(&tr, tr.chunks, sizeof(uint64_t[tr.nchunk][2]));
+			if (flags & CPT_FZONE)
+				transwrite(&tr, tr.zones, sizeof(struct cpt_zone[tr.nchunk]));
+			if (flags & CPT_FCRC) {
+				fwrite(tr.crcs, 4, tr.ncrc, tr.fp);
+				fwrite(&tr.crc, 4, 1, tr.fp);
+			}
+			fwrite(&trailer, CPT_TRAILERLEN, 1, tr.fp);
+		}
+		fwrite(CPT_ENDING, 1, CPT_ENDINGLEN, tr.fp);
+	}
+	if (fflush(tr.fp) || ferror(tr.fp)) {
+		CPT_ERRECHOWITHTIME("ERROR %d %s: %s", errno, strerror(errno), output ? output : "stdout");
+		ret = CPT_EOPEN;
+	}
+	
+	if (output) {
+		fclose(tr.fp);
+		if (ret && !((CPT_EFORMAT == ret) && file.ended))
+			unlink(output);
+	}
+	cpt_close(&file);
+	free(offs);
+	transpoolfree(&tr);
+	CPT_FREE(tr.chunks);
+	CPT_FREE(tr.ptx);
+	CPT_FREE(tr.wide);
+	CPT_FREE(tr.pad);
+	CPT_FREE(tr.crcs);
+	CPT_FREE(tr.zones);
+	CPT_FREE(ids);
+	CPT_FREE(ts.pool);
+	CPT_FREE(ts.offs);
+	CPT_FREE(ts.slots);
+	
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	int     iarg, level = Z_DEFAULT_COMPRESSION;
+	uint8_t ver, flags = 0;
+	
+	for (iarg = 3; iarg < argc; ++iarg) {
+		if (!strcmp(argv[iarg], "-z")) {
+			flags |= CPT_FCHUNK;
+		} else if (!strcmp(argv[iarg], "-s")) {
+			flags |= CPT_FCHUNK|CPT_FSHUFFLE;
+		} else if (!strcmp(argv[iarg], "-c")) {
+			flags |= CPT_FCHUNK|CPT_FCOLUMN;
+		} else if (!strcmp(argv[iarg], "-0")) {
+			flags |= CPT_FCHUNK;
+			level  = Z_NO_COMPRESSION;
+		} else if (!strcmp(argv[iarg], "-d")) {
+			flags |= CPT_FSITEID;
+		} else if (!strcmp(argv[iarg], "-a")) {
+			flags |= CPT_FALIGNED;
+		} else {
+			break;
+		}
+	}
+	if ((argc < 3) || ((iarg+1 != argc) && (iarg+2 != argc)) || strcmp(argv[1], "-to")) {
+		CPT_ERRECHOWITHTIME("Usage: %s -to version [-z] [-s] [-c] [-0] [-d] [-a] input [output]", argv[0]);
+		return 1;
+	}
+	if ((flags & CPT_FSHUFFLE) && (flags & CPT_FCOLUMN)) {
+		CPT_ERRECHOWITHTIME("-s and -c do NOT go together");
+		return 1;
+	}
+	if ((flags & CPT_FALIGNED) && (flags & CPT_FCHUNK)) {
+		CPT_ERRECHOWITHTIME("-a does NOT go along with chunks");
+		return 1;
+	}
+	if (!(ver = transver(argv[2]))) {
+		CPT_ERRECHOWITHTIME("version %s is NOT supported, try %d.%d, 0.2 or 0.1",
+		                    argv[2], CPT_VER_MAJOR, CPT_VER_MINOR);
+		return 1;
+	}
+	if (flags && (CPT_VERSION01 == ver)) {
+		CPT_ERRECHOWITHTIME("chunks, site dictionary and padding need version 0.2 or later");
+		return 1;
+	}
+	if (CPT_VERSION01 != ver)
+		flags |= CPT_FCRC;
+	if (flags & CPT_FCHUNK)
+		flags |= CPT_FZONE;
+	
+	return trans(ver, flags, level, argv[iarg], (iarg+2 == argc) ? argv[iarg+1] : NULL);
+}
@@ -0,0 +1,912 @@
+/*
+ *file: write/writecpt.c
+ *descreption:
+ *  write cpt format file, one Ptx at a time
+ *init date: Oct/17/2026
+ *last modify: Oct/17/2026
+ *
+ */
+
+#include "writecpt.h"
+#include <sys/uio.h>
+#include <sys/file.h>
+
+const static size_t _cpt_1byte = sizeof(int8_t );
+const static size_t _cpt_2byte = sizeof(int16_t);
+const static size_t _cpt_4byte = sizeof(int32_t);
+const static size_t _cpt_8byte = sizeof(int64_t);
+
+/*  Write iov out in full, going on after short writes  */
+static int wrv(struct cpt_writer *wr, struct iovec *iov, int niov)
+{
+	ssize_t ret;
+	
+	while (niov && !wr->err) {
+		if ((ret = writev(wr->fd, iov, niov)) <= 0) {
+			if ((ret < 0) && (EINTR == errno))
+				continue;
+			wr->err = ret ? errno : EIO;
+			break;
+		}
+		for (; niov && ((size_t) ret >= iov->iov_len); --niov, ++iov)
+			ret -= iov->iov_len;
+		if (niov) {
+			iov->iov_base = (uint8_t *) iov->iov_base+ret;
+			iov->iov_len -= ret;
+		}
+	}
+	
+	return wr->err;
+}
+
+static int wrflush(struct cpt_writer *wr)
+{
+	struct iovec iov = {wr->buf, wr->len};
+	
+	wr->len = 0;
+	return iov.iov_len ? wrv(wr, &iov, 1) : wr->err;
+}
+
+/*
+ *  Fields are copied into buf, one that does not fit goes out in place
+ *  together with buf by a single writev, so src is free once this returns.
+ *  Without a file buf grows instead.
+ */
+static void wrput(struct cpt_writer *wr, const void *src, size_t n)
+{
+	size_t   cap;
+	uint8_t *buf;
+	struct iovec iov[2] = {{wr->buf, wr->len}, {(void *) src, n}};
+	
+	wr->off += n;
+	if (wr->sum)
+		wr->crc = cpt_crc32c(wr->crc, src, n);
+	if ((wr->fd < 0) && !wr->err && (wr->len+n > wr->cap)) {
+		for (cap = wr->cap ? wr->cap : CPT_WRBUFLEN; cap < wr->len+n; cap *= 2) ;
+		if (!(buf = realloc(wr->buf, cap))) {
+			wr->err = ENOMEM;
+			return;
+		}
+		wr->buf = buf;
+		wr->cap = cap;
+	}
+	if (wr->len+n <= wr->cap) {
+		memcpy(wr->buf+wr->len, src, n);
+		wr->len += n;
+		return;
+	}
+	wrv(wr, iov+!wr->len, 1+!!wr->len);
+	wr->len = 0;
+}
+
+/*
+ *  Scaled obs and ang of pixel round to int16 and uint16, those just
+ *  past the ends would otherwise wrap, NaN is out of range as well
+ */
+static int wrfits(const struct cpt_writer *wr, const struct cpt_pixel *pixel)
+{
+	double v;
+	size_t nobs, nang = 4*(size_t) pixel->nlayer;
+	const double *scale = wr->scale;
+	const struct cpt_channel *pchannel;
+	
+	for (uint8_t ichannel = 0; ichannel < pixel->nchannel; ++ichannel) {
+		pchannel = pixel->channels+ichannel;
+		nobs = pixel->nlayer*((pchannel->centrewv < 0) ? 3 : 1);
+		for (size_t i = 0; i < nobs; ++i) {
+			v = (pchannel->obs[i]-scale[1])/scale[0];
+			if (!((v > INT16_MIN-0.5) && (v < INT16_MAX+0.5)))
+				return 0;
+		}
+		for (size_t i = 0; i < nang; ++i) {
+			v = (pchannel->ang[i]-scale[3])/scale[2];
+			if (!((v > -0.5) && (v < UINT16_MAX+0.5)))
+				return 0;
+		}
+	}
+	
+	return 1;
+}
+
+/*  Pixel, with obs and ang rounded to integers by wr->scale if scaled, checked by wrfits  */
+static void wrpixel(struct cpt_writer *wr, const struct cpt_pixel *pixel)
+{
+	size_t   nobs, nang = 4*(size_t) pixel->nlayer;
+	int16_t  rawobs[3*UINT8_MAX];
+	uint16_t rawang[4*UINT8_MAX];
+	const double *scale = wr->scale;
+	const struct cpt_channel *pchannel;
+	
+	/*  Geolocation  */
+	wrput(wr, &pixel->lon, _cpt_4byte);
+	wrput(wr, &pixel->lat, _cpt_4byte);
+	wrput(wr, &pixel->alt, _cpt_2byte);
+	wrput(wr, &pixel->mask, _cpt_1byte);
+	
+	/*  Dimensions  */
+	wrput(wr, &pixel->nchannel, _cpt_1byte);
+	wrput(wr, &pixel->nlayer, _cpt_1byte);
+	if (wr->flags & CPT_FSCALED)
+		wrput(wr, scale, CPT_SCALELEN);
+	
+	/*  Channel  */
+	for (uint8_t ichannel = 0; ichannel < pixel->nchannel; ++ichannel) {
+		pchannel = pixel->channels+ichannel;
+		nobs = pixel->nlayer*((pchannel->centrewv < 0) ? 3 : 1);
+		wrput(wr, &pchannel->centrewv, _cpt_2byte);
+		if (wr->flags & CPT_FSCALED) {
+			for (size_t i = 0; i < nobs; ++i)
+				rawobs[i] = lround((pchannel->obs[i]-scale[1])/scale[0]);
+			for (size_t i = 0; i < nang; ++i)
+				rawang[i] = lround((pchannel->ang[i]-scale[3])/scale[2]);
+			wrput(wr, rawobs, sizeof(int16_t[nobs]));
+			wrput(wr, rawang, sizeof(uint16_t[nang]));
+		} else {
+			wrput(wr, pchannel->obs, sizeof(double[nobs]));
+			wrput(wr, pchannel->ang, sizeof(double[nang]));
+		}
+	}
+	
+	/*  Extra  */
+	wrput(wr, &pixel->nextra, _cpt_1byte);
+	if (pixel->nextra)
+		wrput(wr, pixel->extra, sizeof(double[pixel->nextra]));
+}
+
+/*  Directory of fname, to be freed  */
+static char *wrdir(const char *fname)
+{
+	char *dir, *slash;
+	
+	if (!(dir = malloc(strlen(fname)+2)))
+		return NULL;
+	strcpy(dir, fname);
+	if (!(slash = strrchr(dir, '/')))
+		strcpy(dir, ".");
+	else if (slash == dir)
+		dir[1] = '\0';
+	else
+		*slash = '\0';
+	
+	return dir;
+}
+
+/*
+ *  Open an unnamed file in the directory of wr->fname, or a file named
+ *  fname.XXXXXX next to it where the file system has no O_TMPFILE
+ */
+static int wrtmpopen(struct cpt_writer *wr)
+{
+	char *dir;
+	
+	if (!(dir = wrdir(wr->fname)))
+		return -1;
+	wr->fd = open(dir, O_TMPFILE|O_WRONLY, S_IRUSR|S_IWUSR);
+	CPT_FREE(dir);
+	if ((wr->fd >= 0) || ((EOPNOTSUPP != errno) && (EISDIR != errno) && (EINVAL != errno)))
+		return wr->fd;
+	
+	if (!(wr->tmpname = malloc(strlen(wr->fname)+8)))
+		return -1;
+	sprintf(wr->tmpname, "%s.XXXXXX", wr->fname);
+	if ((wr->fd = mkstemp(wr->tmpname)) < 0)
+		CPT_FREE(wr->tmpname);
+	
+	return wr->fd;
+}
+
+/*
+ *  Give the written file its final name, replacing a file of that name
+ *  in one step. Return 0 or errno.
+ */
+static int wrlink(struct cpt_writer *wr)
+{
+	int  err = 0;
+	char path[32], *tmpname;
+	
+	if (wr->tmpname)
+		return rename(wr->tmpname, wr->fname) ? errno : 0;
+	
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", wr->fd);
+	if (!linkat(AT_FDCWD, path, AT_FDCWD, wr->fname, AT_SYMLINK_FOLLOW))
+		return 0;
+	if (EEXIST != errno)
+		return errno;
+	
+	/*  linkat does not replace, so link under a free name and rename over  */
+	if (!(tmpname = malloc(strlen(wr->fname)+32)))
+		return ENOMEM;
+	for (uint32_t i = 0; ; ++i) {
+		sprintf(tmpname, "%s.%ld.%u", wr->fname, (long) getpid(), i);
+		if (!linkat(AT_FDCWD, path, AT_FDCWD, tmpname, AT_SYMLINK_FOLLOW))
+			break;
+		if (EEXIST != errno) {
+			err = errno;
+			CPT_FREE(tmpname);
+			return err;
+		}
+	}
+	if (rename(tmpname, wr->fname)) {
+		err = errno;
+		unlink(tmpname);
+	}
+	CPT_FREE(tmpname);
+	
+	return err;
+}
+
+/*  Make the new name of the file durable  */
+static int wrdirsync(const char *fname)
+{
+	int  fd, err = 0;
+	char *dir;
+	
+	if (!(dir = wrdir(fname)))
+		return ENOMEM;
+	if (((fd = open(dir, O_RDONLY|O_DIRECTORY)) < 0) || fsync(fd))
+		err = errno;
+	if (fd >= 0)
+		close(fd);
+	CPT_FREE(dir);
+	
+	return err;
+}
+
+/*  Header of wr with count nptx into hdr, return its length  */
+static size_t wrheader(const struct cpt_writer *wr, uint64_t nptx, uint8_t *hdr)
+{
+	memcpy(hdr, CPT_MAGIC, CPT_MAGICLEN);
+	hdr[CPT_MAGICLEN] = wr->ver;
+	memcpy(hdr+CPT_MAGICLEN+1, &nptx, CPT_NPTXLENOF(wr->ver));
+	hdr[CPT_MAGICLEN+1+CPT_NPTXLENOF(wr->ver)] = wr->nparam;
+	if (CPT_VERSION01 != wr->ver)
+		hdr[CPT_MAGICLEN+1+CPT_NPTXLENOF(wr->ver)+1] = wr->flags;
+	
+	return CPT_HDRLENOF(wr->ver);
+}
+
+/*
+ *  Last CRC of a checksummed file of n Ptx, the one of header and
+ *  offset table as nothing else lies out of Data and CRC table
+ */
+static uint32_t wrtailcrc(const struct cpt_writer *wr, uint64_t n)
+{
+	uint8_t hdr[CPT_HDRLEN];
+	
+	return cpt_crc32c(cpt_crc32c(0, hdr, wrheader(wr, n, hdr)), wr->offs, sizeof(uint64_t[n]));
+}
+
+/*
+ *  Start writing fname with a header of count 0, patched by
+ *  cpt_writer_close which also puts fname in place. flags is of
+ *  CPT_WRFLAGS, CPT_FSCALED with scale of CPT_SCALELEN bytes applied to
+ *  obs and ang of every Pixel, CPT_FCRC to checksum each Ptx. estlen,
+ *  if not 0, is the expected size in bytes and is preallocated. opts
+ *  is 0 or CPT_WRSYNC.
+ *  Return CPT_EFORMAT if this writer cannot write ver or flags.
+ */
+int cpt_writer_open(struct cpt_writer *wr, const char *fname, uint8_t ver, uint8_t nparam,
+                    uint8_t flags, const double *scale, uint64_t estlen, uint8_t opts)
+{
+	uint8_t hdr[CPT_HDRLEN];
+	
+	if ((CPT_VERSION01 != ver) && (CPT_VERSION02 != ver) && (CPT_VERSION != ver))
+		return CPT_EFORMAT;
+	if ((flags & ~CPT_WRFLAGS) || ((flags & CPT_FSCALED) && !scale)
+	    || ((CPT_VERSION01 == ver) && flags))
+		return CPT_EFORMAT;
+	
+	memset(wr, 0, sizeof(struct cpt_writer));
+	wr->ver    = ver;
+	wr->nparam = nparam;
+	wr->flags  = flags;
+	wr->opts   = opts;
+	if (scale)
+		memcpy(wr->scale, scale, CPT_SCALELEN);
+	if (!(wr->buf = malloc(wr->cap = CPT_WRBUFLEN))) {
+		CPT_ERRMEM(wr->buf);
+		return CPT_EMEM;
+	}
+	if (!(wr->fname = strdup(fname))) {
+		CPT_ERRMEM(wr->buf);
+		return CPT_EMEM;
+	}
+	if (wrtmpopen(wr) < 0) {
+		CPT_ERROPEN(fname);
+		CPT_FREE(wr->fname);
+		CPT_FREE(wr->buf);
+		return CPT_EOPEN;
+	}
+	
+	/*  Only a hint, blocks past what gets written are freed on close  */
+	if (estlen)
+		fallocate(wr->fd, FALLOC_FL_KEEP_SIZE, 0, estlen);
+	
+	/*  Header  */
+	wrput(wr, hdr, wrheader(wr, 0, hdr));
+	
+	return 0;
+}
+
+/*  Scale of centre Pixel of the Ptx in [off, end), for Ptx appended to a scaled file  */
+static int wrscale(struct cpt_writer *wr, uint64_t off, uint64_t end)
+{
+	int      ret = CPT_EFORMAT;
+	size_t   len = end-off, at;
+	uint8_t *raw, *pend;
+	uint16_t nt = 0;
+	
+	if ((end <= off) || !(raw = malloc(len)))
+		return (end <= off) ? CPT_EFORMAT : CPT_EMEM;
+	if ((pread(wr->fd, raw, len, off) == (ssize_t) len) && (pend = memchr(raw, '\0', len))) {
+		at = pend-raw+1+_cpt_4byte+_cpt_4byte+_cpt_2byte;
+		if (at+CPT_NTLENOF(wr->ver) <= len) {
+			memcpy(&nt, raw+at, CPT_NTLENOF(wr->ver));
+			at += CPT_NTLENOF(wr->ver)+nt*sizeof(double[wr->nparam+1]);
+			
+			/*  seconds, lon, lat, alt, mask, nchannel, nlayer  */
+			at += _cpt_8byte+_cpt_4byte+_cpt_4byte+_cpt_2byte+3*_cpt_1byte;
+			if (at+CPT_SCALELEN <= len) {
+				memcpy(wr->scale, raw+at, CPT_SCALELEN);
+				ret = 0;
+			}
+		}
+	}
+	free(raw);
+	
+	return ret;
+}
+
+/*
+ *  Open fname for Ptx to be appended in place. Its Ending, and footer
+ *  since 0.2, are checked and cut off, then written again by
+ *  cpt_writer_close along with the count, so the cost is that of the
+ *  new Ptx plus the footer. CRC of Ptx kept are read back, the last
+ *  CRC is taken anew as it covers the count and offset table.
+ *  Appenders take turns on an exclusive flock held until close.
+ *  Ptx go to a scaled file by scale, or if NULL by the scale of
+ *  its first Pixel. opts is 0 or CPT_WRSYNC.
+ *  Return CPT_EFORMAT if fname is not a plain, scaled or checksummed
+ *  cpt file with an intact Ending.
+ */
+int cpt_writer_append(struct cpt_writer *wr, const char *fname, const double *scale, uint8_t opts)
+{
+	int      ret = CPT_EFORMAT;
+	off_t    fsize;
+	uint8_t  hdr[CPT_HDRLEN], tail[CPT_TRAILERLEN+CPT_ENDINGLEN];
+	size_t   hdrlen, taillen;
+	struct cpt_trailer trailer;
+	
+	memset(wr, 0, sizeof(struct cpt_writer));
+	wr->opts = opts;
+	if (!(wr->buf = malloc(wr->cap = CPT_WRBUFLEN))) {
+		CPT_ERRMEM(wr->buf);
+		return CPT_EMEM;
+	}
+	if (!(wr->fname = strdup(fname))) {
+		CPT_ERRMEM(wr->buf);
+		return CPT_EMEM;
+	}
+	if ((wr->fd = open(fname, O_RDWR)) < 0) {
+		CPT_ERROPEN(fname);
+		CPT_FREE(wr->fname);
+		CPT_FREE(wr->buf);
+		return CPT_EOPEN;
+	}
+	while (flock(wr->fd, LOCK_EX)) {
+		if (EINTR != errno) {
+			CPT_ERRFIO(wr->fd);
+			CPT_FREE(wr->fname);
+			CPT_FREE(wr->buf);
+			return CPT_EOPEN;
+		}
+	}
+	
+	/*  Header, read once locked as the appender before may have changed it  */
+	fsize = lseek(wr->fd, 0, SEEK_END);
+	if ((pread(wr->fd, hdr, CPT_HDRLEN01, 0) != CPT_HDRLEN01) || memcmp(hdr, CPT_MAGIC, CPT_MAGICLEN))
+		goto fail;
+	wr->ver = hdr[CPT_MAGICLEN];
+	if ((CPT_VERSION01 != wr->ver) && (CPT_VERSION02 != wr->ver) && (CPT_VERSION != wr->ver))
+		goto fail;
+	hdrlen = CPT_HDRLENOF(wr->ver);
+	if (pread(wr->fd, hdr, hdrlen, 0) != (ssize_t) hdrlen)
+		goto fail;
+	memcpy(&wr->nptx, hdr+CPT_MAGICLEN+1, CPT_NPTXLENOF(wr->ver));
+	wr->nparam = hdr[CPT_MAGICLEN+1+CPT_NPTXLENOF(wr->ver)];
+	if (CPT_VERSION01 != wr->ver)
+		wr->flags = hdr[CPT_MAGICLEN+1+CPT_NPTXLENOF(wr->ver)+1];
+	if (wr->flags & ~CPT_WRFLAGS)
+		goto fail;
+	
+	/*  Ending, after the footer since 0.2  */
+	taillen = (CPT_VERSION01 != wr->ver) ? sizeof(tail) : CPT_ENDINGLEN;
+	if ((fsize < (off_t) (hdrlen+taillen))
+	    || (pread(wr->fd, tail+sizeof(tail)-taillen, taillen, fsize-taillen) != (ssize_t) taillen)
+	    || memcmp(tail+CPT_TRAILERLEN, CPT_ENDING, CPT_ENDINGLEN))
+		goto fail;
+	wr->base = fsize-taillen;
+	if (CPT_VERSION01 != wr->ver) {
+		memcpy(&trailer, tail, CPT_TRAILERLEN);
+		if (memcmp(trailer.magic, CPT_TRAILERMAGIC, sizeof(trailer.magic))
+		    || (trailer.ntable != wr->nptx) || (trailer.table < hdrlen) || (trailer.table > wr->base)
+		    || (wr->nptx > (wr->base-trailer.table)/sizeof(uint64_t))
+		    || (wr->base-trailer.table
+		        != sizeof(uint64_t[wr->nptx])+CPT_CRCTABLEN(wr->flags, wr->nptx)))
+			goto fail;
+		wr->base = trailer.table;
+		
+		/*  Offset and CRC tables are read back to be written again with the new Ptx  */
+		wr->offscap = (wr->nptx > 1024) ? wr->nptx : 1024;
+		if (!(wr->offs = malloc(sizeof(uint64_t[wr->offscap])))
+		    || ((wr->flags & CPT_FCRC) && !(wr->crcs = malloc(sizeof(uint32_t[wr->offscap]))))) {
+			ret = CPT_EMEM;
+			goto fail;
+		}
+		if ((pread(wr->fd, wr->offs, sizeof(uint64_t[wr->nptx]), wr->base)
+		     != (ssize_t) sizeof(uint64_t[wr->nptx]))
+		    || (wr->nptx && ((wr->offs[0] < hdrlen) || (wr->offs[wr->nptx-1] >= wr->base))))
+			goto fail;
+		if (wr->crcs && (pread(wr->fd, wr->crcs, sizeof(uint32_t[wr->nptx]),
+		                       wr->base+sizeof(uint64_t[wr->nptx]))
+		                 != (ssize_t) sizeof(uint32_t[wr->nptx])))
+			goto fail;
+	}
+	if (wr->flags & CPT_FSCALED) {
+		if (scale)
+			memcpy(wr->scale, scale, CPT_SCALELEN);
+		else if (!wr->nptx || (ret = wrscale(wr, wr->offs[0], (wr->nptx > 1) ? wr->offs[1] : wr->base)))
+			goto fail;
+	}
+	
+	wr->nbase = wr->nptx;
+	wr->off   = wr->base;
+	if (ftruncate(wr->fd, wr->base) || (lseek(wr->fd, wr->base, SEEK_SET) < 0)) {
+		CPT_ERROPEN(fname);
+		ret = CPT_EWRITE;
+		goto fail;
+	}
+	
+	return 0;
+	
+fail:
+	if (CPT_EFORMAT == ret)
+		CPT_ERRECHOWITHTIME("%s can NOT be appended to, it is not a plain, scaled or checksummed "
+		                    "cpt file with its Ending", fname);
+	else if (CPT_EMEM == ret)
+		CPT_ERRMEM(wr->crcs);
+	close(wr->fd);
+	CPT_FREE(wr->fname);
+	CPT_FREE(wr->offs);
+	CPT_FREE(wr->crcs);
+	CPT_FREE(wr->buf);
+	
+	return ret;
+}
+
+/*
+ *  Append Ptx ptx->pt[0] and ptx->px[0], which the caller may release
+ *  once this returns. Return CPT_EFORMAT if its nt does not fit wr->ver
+ *  or, in scaled layout, any obs or ang is out of int16 or uint16 once
+ *  scaled, nothing of the Ptx is written then.
+ */
+int cpt_writer_append_ptx(struct cpt_writer *wr, const struct cpt_ptx *ptx)
+{
+	uint64_t *offs, cap;
+	uint32_t *crcs;
+	const struct cpt_pt *ppt = ptx->pt;
+	const struct cpt_px *ppx = ptx->px;
+	
+	if (wr->err)
+		return CPT_EWRITE;
+	if ((ppt->nt > CPT_NTMAXOF(wr->ver)) || (wr->nptx >= CPT_NPTXMAXOF(wr->ver)))
+		return CPT_EFORMAT;
+	if (wr->flags & CPT_FSCALED) {
+		if (!wrfits(wr, ppx->centrepixel))
+			return CPT_EFORMAT;
+		for (uint8_t ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity)
+			if (!wrfits(wr, ppx->vicinity+ivicinity))
+				return CPT_EFORMAT;
+	}
+	
+	/*  Offset and CRC tables grow by doubling  */
+	if ((CPT_VERSION01 != wr->ver) && (wr->nptx == wr->offscap)) {
+		cap = wr->offscap ? 2*wr->offscap : 1024;
+		if ((offs = realloc(wr->offs, sizeof(uint64_t[cap]))))
+			wr->offs = offs;
+		if (offs && (wr->flags & CPT_FCRC)) {
+			if ((crcs = realloc(wr->crcs, sizeof(uint32_t[cap]))))
+				wr->crcs = crcs;
+			else
+				offs = NULL;
+		}
+		if (!offs) {
+			CPT_ERRMEM(offs);
+			wr->err = ENOMEM;
+			return CPT_EMEM;
+		}
+		wr->offscap = cap;
+	}
+	if (wr->offs)
+		wr->offs[wr->nptx] = wr->off;
+	wr->sum = !!(wr->flags & CPT_FCRC);
+	wr->crc = 0;
+	
+	/*  Pt  */
+	if (ppt->name)
+		wrput(wr, ppt->name, strlen(ppt->name)+1);
+	else
+		wrput(wr, "", 1);
+	wrput(wr, &ppt->lon, _cpt_4byte);
+	wrput(wr, &ppt->lat, _cpt_4byte);
+	wrput(wr, &ppt->alt, _cpt_2byte);
+	wrput(wr, &ppt->nt , CPT_NTLENOF(wr->ver));
+	for (uint16_t ipoint = 0; ipoint < ppt->nt; ++ipoint) {
+		wrput(wr, &ppt->points[ipoint].seconds, _cpt_8byte);
+		wrput(wr, ppt->points[ipoint].params, sizeof(double[wr->nparam]));
+	}
+	
+	/*  Px  */
+	wrput(wr, &ppx->seconds, _cpt_8byte);
+	wrpixel(wr, ppx->centrepixel);
+	wrput(wr, &ppx->nvicinity, _cpt_1byte);
+	for (uint8_t ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity)
+		wrpixel(wr, ppx->vicinity+ivicinity);
+	if (wr->sum)
+		wr->crcs[wr->nptx] = wr->crc;
+	wr->sum = 0;
+	++wr->nptx;
+	
+	return wr->err ? CPT_EWRITE : 0;
+}
+
+static void *wrpoolworker(void *arg)
+{
+	int      ret;
+	uint64_t slot;
+	struct cpt_wrpool *pool = arg;
+	
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->stop && (pool->next == pool->nput))
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		if (pool->stop)
+			break;
+		slot = pool->next++ % pool->window;
+		pthread_mutex_unlock(&pool->lock);
+		
+		/*  Slot is not put again before it is taken  */
+		ret = pool->encode(pool->jobs[slot]);
+		
+		pthread_mutex_lock(&pool->lock);
+		pool->rets[slot] = ret;
+		pool->done[slot] = 1;
+		pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	
+	return NULL;
+}
+
+/*
+ *  Start nthread threads encoding jobs by encode, which returns 0 or
+ *  one of CPT_ERR, taken back as ret of cpt_wrpool_take. nthread of 0
+ *  or threads that fail to start leave encoding to cpt_wrpool_put.
+ */
+int cpt_wrpool_init(struct cpt_wrpool *pool, uint8_t nthread, uint64_t window,
+                    int (*encode)(void *job))
+{
+	memset(pool, 0, sizeof(struct cpt_wrpool));
+	pool->encode = encode;
+	pool->window = window ? window : 1;
+	pool->jobs = malloc(sizeof(void *[pool->window]));
+	pool->rets = malloc(sizeof(int[pool->window]));
+	pool->done = calloc(pool->window, 1);
+	pool->tids = malloc(sizeof(pthread_t[nthread ? nthread : 1]));
+	if (!pool->jobs || !pool->rets || !pool->done || !pool->tids) {
+		CPT_FREE(pool->jobs);
+		CPT_FREE(pool->rets);
+		CPT_FREE(pool->done);
+		CPT_ERRMEM(pool->tids);
+		return CPT_EMEM;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+	for (pool->nthread = 0; pool->nthread < nthread; ++pool->nthread) {
+		if (pthread_create(pool->tids+pool->nthread, NULL, wrpoolworker, pool))
+			break;
+	}
+	
+	return 0;
+}
+
+/*  Put job after those put before, CPT_EAGAIN if window is full until one is taken  */
+int cpt_wrpool_put(struct cpt_wrpool *pool, void *job)
+{
+	uint64_t slot = pool->nput % pool->window;
+	
+	if (pool->nput-pool->ntaken >= pool->window)
+		return CPT_EAGAIN;
+	if (!pool->nthread) {
+		pool->jobs[slot] = job;
+		pool->rets[slot] = pool->encode(job);
+		pool->done[slot] = 1;
+		++pool->next;
+		++pool->nput;
+		return 0;
+	}
+	
+	pthread_mutex_lock(&pool->lock);
+	pool->jobs[slot] = job;
+	++pool->nput;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+	
+	return 0;
+}
+
+/*  Oldest job not taken yet, once it is encoded, NULL if there is none  */
+void *cpt_wrpool_take(struct cpt_wrpool *pool, int *ret)
+{
+	void    *job;
+	uint64_t slot = pool->ntaken % pool->window;
+	
+	if (pool->ntaken == pool->nput)
+		return NULL;
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->done[slot])
+		pthread_cond_wait(&pool->cond, &pool->lock);
+	pool->done[slot] = 0;
+	job  = pool->jobs[slot];
+	*ret = pool->rets[slot];
+	++pool->ntaken;
+	pthread_mutex_unlock(&pool->lock);
+	
+	return job;
+}
+
+/*  Stop threads once done with jobs they are on, jobs not taken are left to the caller  */
+void cpt_wrpool_free(struct cpt_wrpool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+	for (uint8_t ithread = 0; ithread < pool->nthread; ++ithread)
+		pthread_join(pool->tids[ithread], NULL);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+	CPT_FREE(pool->jobs);
+	CPT_FREE(pool->rets);
+	CPT_FREE(pool->done);
+	CPT_FREE(pool->tids);
+}
+
+static int wrslice(void *job)
+{
+	int ret = 0;
+	struct cpt_wrslice *slice = job;
+	const struct cpt_ptx *ptx = slice->ptx;
+	
+	for (uint64_t iptx = slice->iptx; (iptx < slice->iptx+slice->n) && !ret; ++iptx)
+		ret = cpt_writer_append_ptx(&slice->enc, &(struct cpt_ptx) {ptx->pt+iptx, ptx->px+iptx, NULL});
+	if ((CPT_EWRITE == ret) && (ENOMEM == slice->enc.err))
+		ret = CPT_EMEM;
+	
+	return ret;
+}
+
+/*
+ *  Append n Ptx ptx->pt[i] and ptx->px[i] encoded by nthread threads
+ *  in slices of CPT_WRSLICE, file is byte for byte the one n
+ *  cpt_writer_append_ptx would make. Memory taken on top of the writer
+ *  is about 2*nthread encoded slices.
+ */
+int cpt_writer_append_all(struct cpt_writer *wr, const struct cpt_ptx *ptx, uint64_t n,
+                          uint8_t nthread)
+{
+	int ret = 0, sret;
+	uint64_t *offs, base, iptx;
+	uint32_t *crcs;
+	struct cpt_writer   proto;
+	struct cpt_wrpool   pool;
+	struct cpt_wrslice *slices, *slice;
+	
+	if (wr->err)
+		return CPT_EWRITE;
+	if (n > CPT_NPTXMAXOF(wr->ver)-wr->nptx)
+		return CPT_EFORMAT;
+	if ((nthread < 2) || (n <= CPT_WRSLICE)) {
+		for (iptx = 0; (iptx < n) && !ret; ++iptx)
+			ret = cpt_writer_append_ptx(wr, &(struct cpt_ptx) {ptx->pt+iptx, ptx->px+iptx, NULL});
+		return ret;
+	}
+	
+	/*  Offset and CRC tables to their final size at once  */
+	if ((CPT_VERSION01 != wr->ver) && (wr->nptx+n > wr->offscap)) {
+		if ((offs = realloc(wr->offs, sizeof(uint64_t[wr->nptx+n]))))
+			wr->offs = offs;
+		if (offs && (wr->flags & CPT_FCRC)) {
+			if ((crcs = realloc(wr->crcs, sizeof(uint32_t[wr->nptx+n]))))
+				wr->crcs = crcs;
+			else
+				offs = NULL;
+		}
+		if (!offs) {
+			CPT_ERRMEM(offs);
+			wr->err = ENOMEM;
+			return CPT_EMEM;
+		}
+		wr->offscap = wr->nptx+n;
+	}
+	
+	/*  Slices encode into writers of their own, without file  */
+	proto = *wr;
+	proto.fd    = -1;
+	proto.err   = 0;
+	proto.fname = proto.tmpname = NULL;
+	proto.nptx  = proto.off = proto.offscap = 0;
+	proto.offs  = NULL;
+	proto.crcs  = NULL;
+	proto.len   = proto.cap = 0;
+	proto.buf   = NULL;
+	
+	if (!(slices = calloc(2*(size_t) nthread, sizeof(struct cpt_wrslice)))
+	    || cpt_wrpool_init(&pool, nthread, 2*(uint64_t) nthread, wrslice)) {
+		CPT_ERRMEM(slices);
+		return CPT_EMEM;
+	}
+	
+	/*  Slices are put while window has room, and go to file by order whichever is done first  */
+	for (iptx = 0; !ret && ((iptx < n) || (pool.ntaken < pool.nput)); ) {
+		slice = slices+pool.nput%pool.window;
+		if ((iptx < n) && (pool.nput-pool.ntaken < pool.window)) {
+			slice->enc  = proto;
+			slice->ptx  = ptx;
+			slice->iptx = iptx;
+			slice->n    = (n-iptx > CPT_WRSLICE) ? CPT_WRSLICE : n-iptx;
+			iptx += slice->n;
+			cpt_wrpool_put(&pool, slice);
+			continue;
+		}
+		slice = cpt_wrpool_take(&pool, &sret);
+		
+		/*  Ptx before one refused are kept, as one by one  */
+		if (sret && (CPT_EFORMAT != sret)) {
+			ret = sret;
+			break;
+		}
+		base = wr->off;
+		wrput(wr, slice->enc.buf, slice->enc.len);
+		for (uint64_t islice = 0; wr->offs && (islice < slice->enc.nptx); ++islice)
+			wr->offs[wr->nptx+islice] = base+slice->enc.offs[islice];
+		if (wr->crcs)
+			memcpy(wr->crcs+wr->nptx, slice->enc.crcs, sizeof(uint32_t[slice->enc.nptx]));
+		wr->nptx += slice->enc.nptx;
+		CPT_FREE(slice->enc.buf);
+		CPT_FREE(slice->enc.offs);
+		CPT_FREE(slice->enc.crcs);
+		ret = wr->err ? CPT_EWRITE : sret;
+	}
+	
+	/*  Slices still out on error  */
+	cpt_wrpool_free(&pool);
+	for (uint64_t islice = 0; islice < 2*(uint64_t) nthread; ++islice) {
+		CPT_FREE(slices[islice].enc.buf);
+		CPT_FREE(slices[islice].enc.offs);
+		CPT_FREE(slices[islice].enc.crcs);
+	}
+	free(slices);
+	
+	return ret;
+}
+
+/*  Footer and Ending of a file appended to as they were, Ptx appended are dropped  */
+static int wrrestore(struct cpt_writer *wr)
+{
+	size_t   ntable = sizeof(uint64_t[wr->nbase]);
+	uint32_t last;
+	struct cpt_trailer trailer = {.table = wr->base, .ntable = wr->nbase};
+	
+	memcpy(trailer.magic, CPT_TRAILERMAGIC, sizeof(trailer.magic));
+	if (ftruncate(wr->fd, wr->base)
+	    || (pwrite(wr->fd, &wr->nbase, CPT_NPTXLENOF(wr->ver), CPT_MAGICLEN+1)
+	        != CPT_NPTXLENOF(wr->ver)))
+		return errno;
+	if (wr->flags & CPT_FCRC) {
+		last = wrtailcrc(wr, wr->nbase);
+		if ((pwrite(wr->fd, wr->offs, ntable, wr->base) != (ssize_t) ntable)
+		    || (pwrite(wr->fd, wr->crcs, sizeof(uint32_t[wr->nbase]), wr->base+ntable)
+		        != (ssize_t) sizeof(uint32_t[wr->nbase]))
+		    || (pwrite(wr->fd, &last, sizeof(uint32_t), wr->base+ntable+sizeof(uint32_t[wr->nbase]))
+		        != sizeof(uint32_t)))
+			return errno;
+		ntable += CPT_CRCTABLEN(wr->flags, wr->nbase);
+	} else if ((CPT_VERSION01 != wr->ver)
+	           && (pwrite(wr->fd, wr->offs, ntable, wr->base) != (ssize_t) ntable)) {
+		return errno;
+	}
+	if ((CPT_VERSION01 != wr->ver)
+	    && (pwrite(wr->fd, &trailer, CPT_TRAILERLEN, wr->base+ntable) != CPT_TRAILERLEN))
+		return errno;
+	if (pwrite(wr->fd, CPT_ENDING, CPT_ENDINGLEN, wr->base+((CPT_VERSION01 != wr->ver) ?
+	                                                       ntable+CPT_TRAILERLEN : 0))
+	    != CPT_ENDINGLEN)
+		return errno;
+	
+	return 0;
+}
+
+/*
+ *  Patch count of Ptx in header, write footer and Ending and put file
+ *  in place as fname. Return CPT_EWRITE if any write failed, fname is
+ *  then left as it was before cpt_writer_open or cpt_writer_append.
+ */
+int cpt_writer_close(struct cpt_writer *wr)
+{
+	uint32_t last;
+	struct cpt_trailer trailer;
+	
+	/*
+	 *  Count of Ptx once Data is in file and before footer, so that
+	 *  cpt_follow on a file appended to never takes the new footer
+	 *  for a Ptx under the old count
+	 */
+	wrflush(wr);
+	if (!wr->err && (pwrite(wr->fd, &wr->nptx, CPT_NPTXLENOF(wr->ver), CPT_MAGICLEN+1)
+	                 != CPT_NPTXLENOF(wr->ver)))
+		wr->err = errno ? errno : EIO;
+	
+	/*  Footer  */
+	if ((CPT_VERSION01 != wr->ver) && !wr->err) {
+		trailer.table  = wr->off;
+		trailer.ntable = wr->nptx;
+		memcpy(trailer.magic, CPT_TRAILERMAGIC, sizeof(trailer.magic));
+		wrput(wr, wr->offs, sizeof(uint64_t[wr->nptx]));
+		if (wr->flags & CPT_FCRC) {
+			last = wrtailcrc(wr, wr->nptx);
+			wrput(wr, wr->crcs, sizeof(uint32_t[wr->nptx]));
+			wrput(wr, &last, sizeof(uint32_t));
+		}
+		wrput(wr, &trailer, CPT_TRAILERLEN);
+	}
+	
+	/*  Ending  */
+	wrput(wr, CPT_ENDING, CPT_ENDINGLEN);
+	wrflush(wr);
+	
+	/*  Drop preallocation beyond end, sync, then name  */
+	if (!wr->err && ftruncate(wr->fd, wr->off))
+		wr->err = errno;
+	if (!wr->err && (wr->opts & CPT_WRSYNC) && fdatasync(wr->fd))
+		wr->err = errno;
+	if (!wr->err && !wr->base)
+		wr->err = wrlink(wr);
+	if (!wr->err && !wr->base && (wr->opts & CPT_WRSYNC))
+		wr->err = wrdirsync(wr->fname);
+	if (wr->err && wr->base && wrrestore(wr))
+		CPT_ERRECHOWITHTIME("ERROR %d %s: Ending of %s can NOT be put back", errno, strerror(errno),
+		                    wr->fname);
+	if (close(wr->fd) && !wr->err)
+		wr->err = errno;
+	if (wr->err && wr->tmpname)
+		unlink(wr->tmpname);
+	wr->fd = -1;
+	CPT_FREE(wr->tmpname);
+	CPT_FREE(wr->fname);
+	CPT_FREE(wr->offs);
+	CPT_FREE(wr->crcs);
+	CPT_FREE(wr->buf);
+	
+	return wr->err ? CPT_EWRITE : 0;
+}
+
+/*  Close dropping all Ptx appended, fname is left as it was  */
+int cpt_writer_abort(struct cpt_writer *wr)
+{
+	if (!wr->err)
+		wr->err = ECANCELED;
+	cpt_writer_close(wr);
+	
+	return 0;
+}
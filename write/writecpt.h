@@ -0,0 +1,104 @@
+/*
+ *file: write/writecpt.h
+ *init date: Oct/17/2026
+ *last modify: Oct/17/2026
+ *
+ */
+
+#include "../read/readcpt.h"
+
+
+/*  Bytes encoded before going to file  */
+#define CPT_WRBUFLEN ((size_t) 1<<20)
+
+/*  Options of cpt_writer_open and cpt_writer_append  */
+#define CPT_WRSYNC 0x01  /*  fdatasync file and its directory before close returns  */
+
+/*  Layout flags the writer can write  */
+#define CPT_WRFLAGS (CPT_FSCALED|CPT_FCRC)
+
+
+/*
+ *  Streaming writer, Ptx are appended one at a time and may be freed
+ *  right after, so memory stays at the buffer plus 8 bytes per Ptx of
+ *  offset table, and 4 of CRC table if checksummed, whatever the count
+ *  of Ptx. Header count is patched on close. Layouts are plain, scaled
+ *  or checksummed, others come from cpttrans.
+ *  File is written unnamed, or under a temporary name, and only put in
+ *  place by a successful close, so fname is never seen incomplete.
+ *  An existing file is appended to in place under an exclusive flock,
+ *  its footer and Ending are put back if close fails.
+ */
+struct cpt_writer {
+	int       fd;
+	int       err;       /*  errno of first failed write       */
+	char     *fname;     /*  final name                        */
+	char     *tmpname;   /*  NULL if fd is an O_TMPFILE        */
+	uint8_t   opts;      /*  CPT_WR* options                   */
+	uint8_t   ver;
+	uint8_t   nparam;
+	uint8_t   flags;     /*  CPT_FSCALED and CPT_FCRC          */
+	uint64_t  nptx;      /*  Ptx appended so far               */
+	uint64_t  off;       /*  file offset of next byte          */
+	uint64_t *offs;      /*  offset of each Ptx, none in 0.1   */
+	uint64_t  offscap;
+	uint32_t *crcs;      /*  CRC32C of each Ptx if checksummed  */
+	uint32_t  crc;       /*  of bytes put since sum was set    */
+	uint8_t   sum;       /*  CRC is taken of bytes put         */
+	uint64_t  base;      /*  end of Data kept when appending, 0 if new  */
+	uint64_t  nbase;     /*  Ptx kept when appending           */
+	double    scale[CPT_SCALELEN/sizeof(double)];  /*  of every Pixel if scaled  */
+	size_t    len;       /*  bytes pending in buf              */
+	size_t    cap;       /*  of buf, grown as needed if fd < 0  */
+	uint8_t  *buf;
+};
+
+
+/*
+ *  Ordered pool, jobs are put in order, encoded by whichever of
+ *  nthread threads is free and taken back in the order they were put,
+ *  so what is made of them is what encoding one after another makes.
+ *  At most window jobs are out, put waits for a take beyond that.
+ *  Without threads put encodes the job itself.
+ */
+struct cpt_wrpool {
+	int     (*encode)(void *job);
+	void    **jobs;     /*  ring, job i is at i%window   */
+	int      *rets;
+	uint8_t  *done;
+	uint64_t  window;
+	uint64_t  nput;
+	uint64_t  next;     /*  job to encode next           */
+	uint64_t  ntaken;
+	uint8_t   stop;
+	uint8_t   nthread;
+	pthread_t *tids;
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;  /*  a job put, encoded or taken  */
+};
+
+/*  Job of cpt_writer_append_all, n Ptx encoded into a writer that keeps to memory  */
+#define CPT_WRSLICE 64
+
+struct cpt_wrslice {
+	struct cpt_writer enc;  /*  offsets in it are from start of slice  */
+	const struct cpt_ptx *ptx;
+	uint64_t iptx;
+	uint64_t n;
+};
+
+
+/*  Declaration of functions  */
+int cpt_writer_open(struct cpt_writer *wr, const char *fname, uint8_t ver, uint8_t nparam,
+                    uint8_t flags, const double *scale, uint64_t estlen, uint8_t opts);
+int cpt_writer_append(struct cpt_writer *wr, const char *fname, const double *scale, uint8_t opts);
+int cpt_writer_append_ptx(struct cpt_writer *wr, const struct cpt_ptx *ptx);
+int cpt_writer_append_all(struct cpt_writer *wr, const struct cpt_ptx *ptx, uint64_t n,
+                          uint8_t nthread);
+int cpt_writer_close(struct cpt_writer *wr);
+int cpt_writer_abort(struct cpt_writer *wr);
+int cpt_wrpool_init(struct cpt_wrpool *pool, uint8_t nthread, uint64_t window,
+                    int (*encode)(void *job));
+int cpt_wrpool_put(struct cpt_wrpool *pool, void *job);
+void *cpt_wrpool_take(struct cpt_wrpool *pool, int *ret);
+void cpt_wrpool_free(struct cpt_wrpool *pool);
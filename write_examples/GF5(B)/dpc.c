@@ -5,7 +5,7 @@
  *syntax:
  *  a.out DPC_prefix [ptxt, [cpt]]
  *init date: May/27/2022
- *last modify: JuL/27/2022
+ *last modify: Oct/17/2026
  *
  */
 
@@ -24,7 +24,7 @@
 #include <curl/curl.h>
 
 #include "hdf5.h"
-#include "../../read/readcpt.h"
+#include "../../write/writecpt.h"
 
 
 /*  Site info settings  */
@@ -197,100 +197,6 @@ int main(int argc, char *argv[]) {
 	}
 }
 
-/*TODO move this fn to read/ dir
- *  Free several allocated space
- *  e.g.
- *      void *ptr1 = malloc(size1),
-             *ptr2 = malloc(size2);
- *      cpt_freethemall(2, &ptr1, &ptr2);
- */
-int cpt_freethemall(uint8_t n, ...)
-{
-	va_list ap;
-	void **p;
-	
-	va_start(ap, n);
-	while (n-- > 0) {
-		p = va_arg(ap, void **);
-		CPT_FREE(*p);
-	}
-	va_end(ap);
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_point st pointer
- */
-int cpt_freepointall(struct cpt_point **p, uint16_t n)
-{
-	if (*p) {
-		while (n-- > 0)
-			CPT_FREE((*p+n)->params);
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_pt st pointer
- */
-int cpt_freeptall(struct cpt_pt **p, uint32_t n)
-{
-	if (*p) {
-		while (n-- > 0)
-			cpt_freepointall(&(*p+n)->points, (*p+n)->nt);
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_channel st pointer
- */
-int cpt_freechannelall(struct cpt_channel **p, uint16_t n)
-{
-	if (*p) {
-		while (n-- > 0)
-			cpt_freethemall(2, &(*p+n)->obs, &(*p+n)->ang);
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_pixel st pointer
- */
-int cpt_freepixelall(struct cpt_pixel **p, uint16_t n)
-{
-	if (*p) {
-		while (n-- > 0)
-			cpt_freechannelall(&(*p+n)->channels, (*p+n)->nchannel);
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_px st pointer
- */
-int cpt_freepxall(struct cpt_px **p, uint32_t n)
-{
-	if (*p) {
-		while (n-- > 0) {
-			cpt_freepixelall(&(*p+n)->centrepixel, 1);
-			cpt_freepixelall(&(*p+n)->vicinity, (*p+n)->nvicinity);
-		}
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
 /*  Init essential info from xml  */
 static int initfromxml(const char *fname, struct wr_cpt_dpc *st)
 {
@@ -1172,20 +1078,24 @@ static int loadpxfromst(struct cpt_pixel *pixel, struct wr_cpt_dpc *st, uint16_t
 	return 0;
 }
 
-/*  Pairing Pt and Px  */
+/*
+ *  Pairing Pt and Px, each pair is appended to wr as soon as it is
+ *  found and freed, so memory does not grow with count of pairs
+ */
 static uint32_t pairdpc(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_dpc *dpcst,
-                        struct cpt_px **pairpx, struct cpt_pt **pairpt)
+                        struct cpt_writer *wr)
 {
-	uint8_t  ipoint, npoint, pointsta, ivicinity,
-	         rowntop, rownbottom, colnleft, colnright;
+	int      ret;
+	uint8_t  ivicinity, rowntop, rownbottom, colnleft, colnright;
 	int16_t  rowv, colv;
-	uint16_t row, col;
+	uint16_t row, col, ipoint, npoint, pointsta;
 	uint32_t ipt, idx, ptxcount;
 	uint64_t sec;
 	
-	struct cpt_pt    *ppt,    *ppairpt;
+	struct cpt_pt    *ppt, pairpt;
 	struct cpt_px    *ppx;
-	struct cpt_point *ppoint, *ppairpoint;
+	struct cpt_point *ppoint;
+	struct cpt_ptx    ptx = {&pairpt, NULL, NULL};
 	
 	const uint16_t rowlimit = dpcst->nrow-1,
 	               collimit = dpcst->ncol-1;
@@ -1194,8 +1104,6 @@ static uint32_t pairdpc(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_dp
 	            colcoef = colmid / WR_CPT_LONLIM_MAX;
 	
 	ptxcount = 0;
-	*pairpx  = NULL;
-	*pairpt  = NULL;
 	for (ipt = 0; ipt < ptcount; ++ipt) {
 		ppt = allpt+ipt;
 		row = rowcoef * (WR_CPT_LATLIM_MAX-ppt->lat);
@@ -1218,13 +1126,13 @@ static uint32_t pairdpc(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_dp
 		sec = dpcst->secswhenscan + (rowlimit-row)*dpcst->secsperline;
 		
 		npoint   = 0;
-		pointsta = UINT8_MAX;
+		pointsta = UINT16_MAX;
 		for (ipoint = 0; ipoint < ppt->nt; ++ipoint) {
 			ppoint = ppt->points+ipoint;
 			if (((ppoint->seconds > sec) ?
 			(ppoint->seconds-sec) : (sec-ppoint->seconds)) < WR_CPT_SECDIFFMAX) {
 				++npoint;
-				if (UINT8_MAX == pointsta)
+				if (UINT16_MAX == pointsta)
 					pointsta = ipoint;
 			}
 		}
@@ -1232,30 +1140,16 @@ static uint32_t pairdpc(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_dp
 		if (!npoint)
 			goto next_pt;
 		
-		/*  Pt  */
-		*pairpt = realloc(*pairpt, sizeof(struct cpt_pt[++ptxcount]));
-		ppairpt = *pairpt + ptxcount-1;
-		
-		ppairpt->name = malloc(strlen(ppt->name)+1);
-		memcpy(ppairpt->name, ppt->name, strlen(ppt->name));
-		ppairpt->name[strlen(ppt->name)] = '\0';
-		
-		ppairpt->nt  = npoint;
-		ppairpt->alt = ppt->alt;
-		ppairpt->lon = ppt->lon;
-		ppairpt->lat = ppt->lat;
-		ppairpt->points = malloc(sizeof(struct cpt_point[ppairpt->nt]));
-		for (ipoint = 0; ipoint < npoint; ++ipoint) {
-			ppoint = ppt->points + pointsta + ipoint;
-			ppairpoint = ppairpt->points + ipoint;
-			ppairpoint->seconds = ppoint->seconds;
-			ppairpoint->params  = malloc(_cpt_parsz);
-			memcpy(ppairpoint->params, ppoint->params, _cpt_parsz);
-		}
+		/*  Pt, Points matched are contiguous and written from allpt  */
+		pairpt.name = ppt->name;
+		pairpt.nt   = npoint;
+		pairpt.alt  = ppt->alt;
+		pairpt.lon  = ppt->lon;
+		pairpt.lat  = ppt->lat;
+		pairpt.points = ppt->points + pointsta;
 		
 		/*  Px  */
-		*pairpx = realloc(*pairpx, sizeof(struct cpt_px[ptxcount]));
-		ppx = *pairpx + ptxcount-1;
+		ptx.px = ppx = malloc(sizeof(struct cpt_px));
 		ppx->centrepixel = malloc(CPT_PIXELSIZE);
 		ppx->seconds     = sec;
 		
@@ -1295,136 +1189,29 @@ static uint32_t pairdpc(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_dp
 			}
 		}
 		
-		next_pt:
-		continue;
-	}
-	
-	ppx = NULL;
-	ppt = ppairpt = NULL;
-	ppoint = ppairpoint = NULL;
-	
-	return ptxcount;
-}
-
-/*  Safer implementation of write fn  */
-static ssize_t safewrite(int filedes, const void *buffer, size_t size)
-{
-	ssize_t ret;
-	
-	while ((ret = write(filedes, buffer, size)) > 0) {
-		if (ret >= size) {
-			return ret-size;
-		} else {
-			buffer += ret;
-			size   -= ret;
-		}
-	}
-	
-	return ret;
-}
-
-/*  Write pixel individual  */
-static int writepixel(int filedes, struct cpt_pixel *pixel)
-{
-	struct cpt_channel *pchannel;
-
-	/*  Geolocation  */
-	safewrite(filedes, &pixel->lon, _cpt_4byte);
-	safewrite(filedes, &pixel->lat, _cpt_4byte);
-	safewrite(filedes, &pixel->alt, _cpt_2byte);
-	safewrite(filedes, &pixel->mask, _cpt_1byte);
-	
-	/*  Dimensions  */
-	safewrite(filedes, &pixel->nchannel, _cpt_1byte);
-	safewrite(filedes, &pixel->nlayer, _cpt_1byte);
-	
-	/*  Channel  */
-	for (uint8_t ichannel = 0; ichannel < pixel->nchannel; ++ichannel) {
-		pchannel = pixel->channels+ichannel;
-		safewrite(filedes, &pchannel->centrewv, _cpt_2byte);
-		safewrite(filedes, pchannel->obs,
-		          sizeof(double[pixel->nlayer][(pchannel->centrewv < 0) ? 3 : 1]));
-		safewrite(filedes, pchannel->ang, sizeof(double[pixel->nlayer][4]));
-	}
-	pchannel = NULL;
-	
-	/*  Extra  */
-	safewrite(filedes, &pixel->nextra, _cpt_1byte);
-	if (pixel->nextra)
-		safewrite(filedes, pixel->extra, _cpt_8byte*pixel->nextra);
-
-	return 0;
-}
-
-/*  Export struct to file  */
-static int writecpttofile(const char *fname, struct cpt_ff *st)
-{
-	int fd;
-	uint8_t  ipoint, ivicinity;
-	uint32_t iptx;
-	struct cpt_pt *ppt;
-	struct cpt_px *ppx;
-	struct cpt_point *ppoint;
-	
-	/*  File already exist ?  */
-	fd = open(fname, O_PATH);
-	if (fd > 0) {
-		close(fd);
+		/*  Write and forget  */
 #ifdef CPT_DEBUG
-		fd = open(fname, O_WRONLY|O_CREAT, S_IRUSR|S_IWUSR);
-#else
-		return EEXIST;
+		CPT_ECHOWITHTIME("No.%03d: pixel [%9.4f, %8.4f] (%2.0f) with %2d points at %s",
+		                 ptxcount+1, ppx->centrepixel->lon, ppx->centrepixel->lat,
+		                 ppx->centrepixel->nextra ? *ppx->centrepixel->extra : -1,
+		                 pairpt.nt, pairpt.name);
 #endif
-	} else {
-		fd = open(fname, O_WRONLY|O_CREAT, S_IRUSR|S_IWUSR);
-	}
-	
-	/*  Header  */
-	safewrite(fd, st->hdr->magic_number, CPT_MAGICLEN);
-	safewrite(fd, &st->hdr->ver, _cpt_1byte);
-	safewrite(fd, &st->hdr->nptx, _cpt_4byte);
-	safewrite(fd, &st->hdr->nparam, _cpt_1byte);
-	
-	/*  Data/Ptx  */
-	char strend = '\0';
-	for (iptx = 0; iptx < st->hdr->nptx; ++iptx) {
-		
-		/*  Pt  */
-		ppt = st->data->pt+iptx;
-		
-		safewrite(fd, ppt->name, strlen(ppt->name));
-		safewrite(fd, &strend, _cpt_1byte);
-		
-		safewrite(fd, &ppt->lon, _cpt_4byte);
-		safewrite(fd, &ppt->lat, _cpt_4byte);
-		safewrite(fd, &ppt->alt, _cpt_2byte);
-		safewrite(fd, &ppt->nt , _cpt_1byte);
-		for (ipoint = 0; ipoint < ppt->nt; ++ipoint) {
-			ppoint = ppt->points+ipoint;
-			safewrite(fd, &ppoint->seconds, _cpt_8byte);
-			safewrite(fd, ppoint->params, _cpt_parsz);
-		}
-		
-		/*  Px  */
-		ppx = st->data->px+iptx;
-		safewrite(fd, &ppx->seconds, _cpt_8byte);
-		writepixel(fd, ppx->centrepixel);
-		safewrite(fd, &ppx->nvicinity, _cpt_1byte);
-		for (ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity) {
-			writepixel(fd, ppx->vicinity+ivicinity);
-		}
+		if (!(ret = cpt_writer_append_ptx(wr, &ptx)))
+			++ptxcount;
+		else if (CPT_EFORMAT == ret)
+			CPT_ERRECHOWITHTIME("pixel [%9.4f, %8.4f] has too many Points or obs or ang out of scaled range, skipped",
+			                    ppx->centrepixel->lon, ppx->centrepixel->lat);
+		cpt_freepxall(&ptx.px, 1);
 		
+		next_pt:
+		continue;
 	}
 	
-	/*  Ending  */
-	safewrite(fd, st->ending, CPT_ENDINGLEN);
-	close(fd);
-	
-	ppt = NULL;
 	ppx = NULL;
+	ppt = NULL;
 	ppoint = NULL;
-
-	return 0;
+	
+	return ptxcount;
 }
 
 /*  Definition of main function  */
@@ -1432,12 +1219,8 @@ int wrcpt(const char *prefix, const char *ptxtfname, const char *cptfname)
 {
 	int ret;
 	uint32_t ptcount, ptxcount;
-	struct cpt_pt *allpt  = NULL,
-	              *pairpt = NULL;
-	struct cpt_px *pairpx = NULL;
-	struct cpt_ff  cptout;
-	struct cpt_ptx ptx;
-	struct cpt_header  hdr;
+	struct cpt_pt *allpt = NULL;
+	struct cpt_writer  wr;
 	struct wr_cpt_dpc *dpcst;
 	
 	/*  Px prepare  */
@@ -1473,44 +1256,32 @@ int wrcpt(const char *prefix, const char *ptxtfname, const char *cptfname)
 		return WR_CPT_ENORCD;
 	}
 	
-	/*  Get paired Px and Pt  */
-	ptxcount = pairdpc(allpt, ptcount, dpcst, &pairpx, &pairpt);
-#ifdef CPT_DEBUG
-	for (uint32_t i = 0; i < ptxcount; ++i) {
-		CPT_ECHOWITHTIME("No.%03d: pixel [%9.4f, %8.4f] (%2.0f) with %2d points at %s",
-		                 i+1,
-		                 (pairpx+i)->centrepixel->lon, (pairpx+i)->centrepixel->lat,
-		                 (pairpx+i)->centrepixel->nextra ? *(pairpx+i)->centrepixel->extra : -1,
-		                 (pairpt+i)->nt, (pairpt+i)->name);
-	}
+	/*  File already exist ?  */
+	int fd = open(cptfname, O_PATH);
+	if (fd > 0) {
+		close(fd);
+#ifndef CPT_DEBUG
+		CPT_ERRECHOWITHTIME("%s already exists", cptfname);
+		goto cleanup;
 #endif
+	}
 	
-	/*  Construct cpt  */
-	hdr.ver    = CPT_VERSION;
-	hdr.nptx   = ptxcount;
-	hdr.nparam = WR_CPT_NPARAM;
-	hdr.magic_number = CPT_MAGIC;
-	ptx.pt = pairpt;
-	ptx.px = pairpx;
-	cptout.hdr    = &hdr;
-	cptout.data   = &ptx;
-	cptout.ending = CPT_ENDING;
+	/*  obs and ang are int16 and uint16 in DPC  */
+	if ((ret = cpt_writer_open(&wr, cptfname, CPT_VERSION, WR_CPT_NPARAM, CPT_FSCALED,
+	                           (double[4]) {dpcst->scaleobs, 0, dpcst->scaleang, 0}, 0, 0)))
+		goto cleanup;
 	
-	/*  Write to file  */
-	writecpttofile(cptfname, &cptout);
+	/*  Get paired Px and Pt, written as they come  */
+	ptxcount = pairdpc(allpt, ptcount, dpcst, &wr);
+	if (cpt_writer_close(&wr))
+		CPT_ERRECHOWITHTIME("Failed writing %s", cptfname);
+	else
+		CPT_ECHOWITHTIME("%u Ptx written to %s", ptxcount, cptfname);
 	
 	/*  Cleanup  */
 	cleanup:
 	ret = cpt_freeptall(&allpt, ptcount);
-	ret = cpt_freepxall(&pairpx, ptxcount);
-	ret = cpt_freeptall(&pairpt, ptxcount);
 	ret = cleandpcst(&dpcst);
 	
-	ptx.pt = NULL;
-	ptx.px = NULL;
-	cptout.hdr  = NULL;
-	cptout.data = NULL;
-	
 	return 0;
 }
-
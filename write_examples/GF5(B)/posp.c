@@ -5,7 +5,7 @@
  *syntax:
  *  a.out hdf5 [ptxt, [cpt]]
  *init date: May/10/2022
- *last modify: May/27/2022
+ *last modify: Oct/17/2026
  *
  */
 
@@ -24,7 +24,7 @@
 #include <curl/curl.h>
 
 #include "hdf5.h"
-#include "../../read/readcpt.h"
+#include "../../write/writecpt.h"
 
 
 /*  Site info settings  */
@@ -149,100 +149,6 @@ int main(int argc, char *argv[]) {
 	}
 }
 
-/*TODO move this fn to read/ dir
- *  Free several allocated space
- *  e.g.
- *      void *ptr1 = malloc(size1),
-             *ptr2 = malloc(size2);
- *      cpt_freethemall(2, &ptr1, &ptr2);
- */
-int cpt_freethemall(uint8_t n, ...)
-{
-	va_list ap;
-	void **p;
-	
-	va_start(ap, n);
-	while (n-- > 0) {
-		p = va_arg(ap, void **);
-		CPT_FREE(*p);
-	}
-	va_end(ap);
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_point st pointer
- */
-int cpt_freepointall(struct cpt_point **p, uint16_t n)
-{
-	if (*p) {
-		while (n-- > 0)
-			CPT_FREE((*p+n)->params);
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_pt st pointer
- */
-int cpt_freeptall(struct cpt_pt **p, uint32_t n)
-{
-	if (*p) {
-		while (n-- > 0)
-			cpt_freepointall(&(*p+n)->points, (*p+n)->nt);
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_channel st pointer
- */
-int cpt_freechannelall(struct cpt_channel **p, uint16_t n)
-{
-	if (*p) {
-		while (n-- > 0)
-			cpt_freethemall(2, &(*p+n)->obs, &(*p+n)->ang);
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_pixel st pointer
- */
-int cpt_freepixelall(struct cpt_pixel **p, uint16_t n)
-{
-	if (*p) {
-		while (n-- > 0)
-			cpt_freechannelall(&(*p+n)->channels, (*p+n)->nchannel);
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
-/*TODO move this fn to read/ dir
- *  Free one or more cpt_px st pointer
- */
-int cpt_freepxall(struct cpt_px **p, uint32_t n)
-{
-	if (*p) {
-		while (n-- > 0) {
-			cpt_freepixelall(&(*p+n)->centrepixel, 1);
-			cpt_freepixelall(&(*p+n)->vicinity, (*p+n)->nvicinity);
-		}
-		CPT_FREE(*p);
-	}
-	
-	return 0;
-}
-
 /*
  *  Load site info into cpt_pt st
  */
@@ -349,6 +255,7 @@ static int querypt(const char *fname, struct cpt_pt **allpt, uint32_t *ptcount)
 			
 			*allpt = realloc(*allpt, sizeof(struct cpt_pt[++*ptcount]));
 			ppt = *allpt+*ptcount-1;
+			ppt->name = NULL;
 			ppt->nt  = 1;
 			ppt->lon = lon;
 			ppt->lat = lat;
@@ -510,6 +417,8 @@ static int loadpxfromst(struct cpt_pixel *pixel, struct wr_cpt_posp *st,
 	
 	pixel->nlayer   = 1;
 	pixel->nchannel = WR_CPT_POSPNBANDS;
+	pixel->nextra   = 0;
+	pixel->extra    = NULL;
 	
 	/*  Load channel-unrelated data  */
 	pospsethyper(st, 0, ir, ic);
@@ -588,30 +497,49 @@ static int pospcleanst(struct wr_cpt_posp **st)
 	return 0;
 }
 
-/*  Pairing Pt and Px  */
+/*  Write a pair and free its Px  */
+static int pospappend(struct cpt_writer *wr, struct cpt_ptx *ptx, uint32_t *ptxcount)
+{
+	int ret;
+	
+#ifdef CPT_DEBUG
+	CPT_ECHOWITHTIME("No.%03d: lon %9.4f lat %8.4f with %2d points",
+	                 *ptxcount+1, ptx->px->centrepixel->lon,
+	                 ptx->px->centrepixel->lat, ptx->pt->nt);
+#endif
+	if (!(ret = cpt_writer_append_ptx(wr, ptx)))
+		++*ptxcount;
+	cpt_freepxall(&ptx->px, 1);
+	
+	return ret;
+}
+
+/*
+ *  Pairing Pt and Px. A closer pixel may still replace Px of the latest
+ *  pair, which is thus held back and appended to wr once the next pair
+ *  starts, so only one pair is in memory whatever the count of pairs.
+ */
 static uint32_t posppair(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_posp *pospst,
-                         struct cpt_px **pairpx, struct cpt_pt **pairpt)
+                         struct cpt_writer *wr)
 {
 	float    lonres, latres, diff, diffmin,
 	         ptgeodiff[ptcount], londiff, latdiff;
-	uint8_t  appendpx, ipoint, npoint, npointmax, ivicinity,
+	uint8_t  appendpx, ivicinity,
 	         rownottop, rownotbottom, colnotleft, colnotright;
-	uint8_t *pointloc;
+	uint16_t ipoint, npoint, npointmax, *pointloc;
 	int16_t  rowv, colv;
 	uint16_t row, col, rowlimit, collimit, ipt, iptnear;
 	uint32_t idx, ptxcount;
 	uint64_t linesec;
-	struct cpt_pt *ppt,
-	              *ppairpt;
+	struct cpt_pt *ppt, pairpt;
 	struct cpt_px *ppx;
-	struct cpt_point *ppoint,
-	                 *ppairpoint;
+	struct cpt_point *ppoint;
+	struct cpt_ptx ptx = {&pairpt, NULL, NULL};
 	
 	ptxcount = 0;
 	rowlimit = pospst->nrow-1;
 	collimit = pospst->ncol-1;
-	*pairpx  = NULL;
-	*pairpt  = NULL;
+	ppx = NULL;
 	
 	npointmax = 0;
 	for (ipt = 0; ipt < ptcount; ++ipt) {
@@ -619,7 +547,9 @@ static uint32_t posppair(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_p
 		if (npoint > npointmax)
 			npointmax = npoint;
 	}
-	pointloc = malloc(sizeof(int8_t[npointmax]));
+	pointloc = malloc(sizeof(uint16_t[npointmax]));
+	pairpt.name   = NULL;
+	pairpt.points = malloc(sizeof(struct cpt_point[npointmax]));
 	
 	/*  Init with 0/flase  */
 	for (ipt = 0; ipt < ptcount; ++ipt) {
@@ -703,9 +633,10 @@ static uint32_t posppair(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_p
 		/*
 		 *  The pixel matches this closest site, spatially.
 		 *  We would also check them temporally, based on the datetime of satellite pixel.
+		 *  Version written here holds at most CPT_NTMAXOF Points per Pt.
 		 */
 		npoint  = 0;
-		for (ipoint = 0; ipoint < ppt->nt; ++ipoint) {
+		for (ipoint = 0; (ipoint < ppt->nt) && (npoint < CPT_NTMAXOF(wr->ver)); ++ipoint) {
 			ppoint = ppt->points + ipoint;
 			if (((ppoint->seconds > linesec) ?
 			(ppoint->seconds-linesec) : (linesec-ppoint->seconds)) < WR_CPT_SECDIFFMAX) {
@@ -721,25 +652,20 @@ static uint32_t posppair(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_p
 			 *  Finally, the Points and the Pixels get paired.
 			 *  Points is multiple as its several obs from certian location.
 			 *  Pixels is multiple as its several location from one time.
+			 *  Points share params with allpt, the previous pair is final now.
 			 */
-			*pairpt = realloc(*pairpt, sizeof(struct cpt_pt[++ptxcount]));
-			ppairpt = *pairpt + ptxcount-1;
-			ppairpt->nt  = npoint;
-			ppairpt->alt = ppt->alt;
-			ppairpt->lon = ppt->lon;
-			ppairpt->lat = ppt->lat;
-			ppairpt->points = malloc(sizeof(struct cpt_point[ppairpt->nt]));
-			for (ipoint = 0; ipoint < npoint; ++ipoint) {
-				ppoint = ppt->points + pointloc[ipoint];
-				ppairpoint = ppairpt->points + ipoint;
-				ppairpoint->seconds = ppoint->seconds;
-				ppairpoint->params  = malloc(_cpt_parsz);
-				memcpy(ppairpoint->params, ppoint->params, _cpt_parsz);
-			}
+			if (ppx)
+				pospappend(wr, &ptx, &ptxcount);
+			
+			pairpt.nt  = npoint;
+			pairpt.alt = ppt->alt;
+			pairpt.lon = ppt->lon;
+			pairpt.lat = ppt->lat;
+			for (ipoint = 0; ipoint < npoint; ++ipoint)
+				pairpt.points[ipoint] = ppt->points[pointloc[ipoint]];
 			
 			/*  Px init or reload  */
-			*pairpx = realloc(*pairpx, sizeof(struct cpt_px[ptxcount]));
-			ppx = *pairpx + ptxcount-1;
+			ptx.px = ppx = malloc(sizeof(struct cpt_px));
 			ppx->centrepixel = malloc(CPT_PIXELSIZE);
 			ppx->nvicinity   = 0;
 			ppx->vicinity    = NULL;
@@ -784,125 +710,19 @@ static uint32_t posppair(struct cpt_pt *allpt, uint32_t ptcount, struct wr_cpt_p
 	}
 	}
 	
+	/*  Last pair  */
+	if (ppx)
+		pospappend(wr, &ptx, &ptxcount);
+	
 	ppx = NULL;
-	ppt = ppairpt = NULL;
-	ppoint = ppairpoint = NULL;
+	ppt = NULL;
+	ppoint = NULL;
 	CPT_FREE(pointloc);
+	CPT_FREE(pairpt.points);
 	
 	return ptxcount;
 }
 
-/*  Safer implementation of write fn  */
-static ssize_t safewrite(int filedes, const void *buffer, size_t size)
-{
-	ssize_t ret;
-	
-	while ((ret = write(filedes, buffer, size)) > 0) {
-		if (ret >= size) {
-			return ret-size;
-		} else {
-			buffer += ret;
-			size   -= ret;
-		}
-	}
-	
-	return ret;
-}
-
-/*  Write pixel individual  */
-static int writepixel(int filedes, struct cpt_pixel *pixel)
-{
-	struct cpt_channel *pchannel;
-
-	/*  Geolocation  */
-	safewrite(filedes, &pixel->lon, _cpt_4byte);
-	safewrite(filedes, &pixel->lat, _cpt_4byte);
-	safewrite(filedes, &pixel->alt, _cpt_2byte);
-	safewrite(filedes, &pixel->mask, _cpt_1byte);
-	
-	/*  Dimensions  */
-	safewrite(filedes, &pixel->nchannel, _cpt_1byte);
-	safewrite(filedes, &pixel->nlayer, _cpt_1byte);
-	
-	/*  Channel  */
-	for (uint8_t ichannel = 0; ichannel < pixel->nchannel; ++ichannel) {
-		pchannel = pixel->channels+ichannel;
-		safewrite(filedes, &pchannel->centrewv, _cpt_2byte);
-		safewrite(filedes, pchannel->obs,
-		          sizeof(double[pixel->nlayer][(pchannel->centrewv < 0) ? 3 : 1]));
-		safewrite(filedes, pchannel->ang, sizeof(double[pixel->nlayer][4]));
-	}
-	pchannel = NULL;
-
-	return 0;
-}
-
-/*  Export struct to file  */
-static int writecpttofile(const char *fname, struct cpt_ff *st)
-{
-	int fd;
-	uint8_t  ipoint, ivicinity;
-	uint32_t iptx;
-	struct cpt_pt *ppt;
-	struct cpt_px *ppx;
-	struct cpt_point *ppoint;
-	
-	/*  File already exist ?  */
-	fd = open(fname, O_PATH);
-	if (fd > 0) {
-		close(fd);
-#ifdef CPT_DEBUG
-		fd = open(fname, O_WRONLY|O_CREAT, S_IRUSR|S_IWUSR);
-#else
-		return EEXIST;
-#endif
-	} else {
-		fd = open(fname, O_WRONLY|O_CREAT, S_IRUSR|S_IWUSR);
-	}
-	
-	/*  Header  */
-	safewrite(fd, st->hdr->magic_number, CPT_MAGICLEN);
-	safewrite(fd, &st->hdr->ver, _cpt_1byte);
-	safewrite(fd, &st->hdr->nptx, _cpt_4byte);
-	safewrite(fd, &st->hdr->nparam, _cpt_1byte);
-	
-	/*  Data/Ptx  */
-	for (iptx = 0; iptx < st->hdr->nptx; ++iptx) {
-		
-		/*  Pt  */
-		ppt = st->data->pt+iptx;
-		safewrite(fd, &ppt->lon, _cpt_4byte);
-		safewrite(fd, &ppt->lat, _cpt_4byte);
-		safewrite(fd, &ppt->alt, _cpt_2byte);
-		safewrite(fd, &ppt->nt , _cpt_1byte);
-		for (ipoint = 0; ipoint < ppt->nt; ++ipoint) {
-			ppoint = ppt->points+ipoint;
-			safewrite(fd, &ppoint->seconds, _cpt_8byte);
-			safewrite(fd, ppoint->params, _cpt_parsz);
-		}
-		
-		/*  Px  */
-		ppx = st->data->px+iptx;
-		safewrite(fd, &ppx->seconds, _cpt_8byte);
-		writepixel(fd, ppx->centrepixel);
-		safewrite(fd, &ppx->nvicinity, _cpt_1byte);
-		for (ivicinity = 0; ivicinity < ppx->nvicinity; ++ivicinity) {
-			writepixel(fd, ppx->vicinity+ivicinity);
-		}
-		
-	}
-	
-	/*  Ending  */
-	safewrite(fd, st->ending, CPT_ENDINGLEN);
-	close(fd);
-	
-	ppt = NULL;
-	ppx = NULL;
-	ppoint = NULL;
-
-	return 0;
-}
-
 /*
  *  CURL part aims at downloading aeronet site file automatically.
  *  fn write_data: callback of write fn when there is data received.
@@ -1003,12 +823,8 @@ int wrcpt(const char *pxname, const char *ptxtfname, const char *cptfname)
 {
 	int ret;
 	uint32_t ptcount, ptxcount;
-	struct cpt_pt *allpt  = NULL,
-	              *pairpt = NULL;
-	struct cpt_px *pairpx = NULL;
-	struct cpt_ff  cptout;
-	struct cpt_ptx ptx;
-	struct cpt_header   hdr;
+	struct cpt_pt *allpt = NULL;
+	struct cpt_writer   wr;
 	struct wr_cpt_posp *pospst;
 	
 	/*  Px prepare  */
@@ -1044,42 +860,29 @@ int wrcpt(const char *pxname, const char *ptxtfname, const char *cptfname)
 		return WR_CPT_ENORCD;
 	}
 	
-	/*  Get paired Px and Pt  */
-	ptxcount = posppair(allpt, ptcount, pospst, &pairpx, &pairpt);
-#ifdef CPT_DEBUG
-	for (uint32_t i = 0; i < ptxcount; ++i) {
-		CPT_ECHOWITHTIME("No.%03d: lon %9.4f lat %8.4f with %2d points",
-		                 i+1, (pairpx+i)->centrepixel->lon,
-		                 (pairpx+i)->centrepixel->lat, (pairpt+i)->nt);
-	}
+	/*  File already exist ?  */
+	int fd = open(cptfname, O_PATH);
+	if (fd > 0) {
+		close(fd);
+#ifndef CPT_DEBUG
+		CPT_ERRECHOWITHTIME("%s already exists", cptfname);
+		goto cleanup;
 #endif
+	}
+	if ((ret = cpt_writer_open(&wr, cptfname, CPT_VERSION, WR_CPT_NPARAM, 0, NULL, 0, 0)))
+		goto cleanup;
 	
-	/*  Construct cpt  */
-	hdr.ver    = CPT_VERSION;
-	hdr.nptx   = ptxcount;
-	hdr.nparam = WR_CPT_NPARAM;
-	hdr.magic_number = CPT_MAGIC;
-	ptx.pt = pairpt;
-	ptx.px = pairpx;
-	cptout.hdr    = &hdr;
-	cptout.data   = &ptx;
-	cptout.ending = CPT_ENDING;
-	
-	/*  Write to file  */
-	writecpttofile(cptfname, &cptout);
+	/*  Get paired Px and Pt, written as they come  */
+	ptxcount = posppair(allpt, ptcount, pospst, &wr);
+	if (cpt_writer_close(&wr))
+		CPT_ERRECHOWITHTIME("Failed writing %s", cptfname);
+	else
+		CPT_ECHOWITHTIME("%u Ptx written to %s", ptxcount, cptfname);
 	
 	/*  Cleanup  */
 	cleanup:
 	ret = cpt_freeptall(&allpt, ptcount);
-	ret = cpt_freepxall(&pairpx, ptxcount);
-	ret = cpt_freeptall(&pairpt, ptxcount);
 	ret = pospcleanst(&pospst);
 	
-	ptx.pt = NULL;
-	ptx.px = NULL;
-	cptout.hdr  = NULL;
-	cptout.data = NULL;
-	
 	return 0;
 }
-